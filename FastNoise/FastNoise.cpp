@@ -32,8 +32,18 @@
 #include <assert.h>
 
 #include <algorithm>
+#include <cstdlib>
+#include <cstring>
 #include <random>
 
+#if !defined(FN_USE_DOUBLES) && (defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86))
+#define FN_BATCH_SIMD 1
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#endif
+#endif
+
 const FN_DECIMAL GRAD_X[] =
 {
 	1, -1, 1, -1,
@@ -447,6 +457,8 @@ static int FastFloor(FN_DECIMAL f) { return (f >= 0 ? (int)f : (int)f - 1); }
 static int FastRound(FN_DECIMAL f) { return (f >= 0) ? (int)(f + FN_DECIMAL(0.5)) : (int)(f - FN_DECIMAL(0.5)); }
 static int FastAbs(int i) { return abs(i); }
 static FN_DECIMAL FastAbs(FN_DECIMAL f) { return fabs(f); }
+// Weight of an octave that is only partly below a fractional octave limit
+static FN_DECIMAL OctaveFade(FN_DECIMAL n, FN_DECIMAL fade) { return fade < 1 ? n * fade : n; }
 static FN_DECIMAL Lerp(FN_DECIMAL a, FN_DECIMAL b, FN_DECIMAL t) { return a + t * (b - a); }
 static FN_DECIMAL InterpHermiteFunc(FN_DECIMAL t) { return t*t*(3 - 2 * t); }
 static FN_DECIMAL InterpQuinticFunc(FN_DECIMAL t) { return t*t*t*(t*(t * 6 - 15) + 10); }
@@ -595,6 +607,11 @@ FN_DECIMAL FastNoise::GradCoord4D(unsigned char offset, int x, int y, int z, int
 }
 
 FN_DECIMAL FastNoise::GetNoise(FN_DECIMAL x, FN_DECIMAL y, FN_DECIMAL z, FN_DECIMAL w) const
+{
+	return GetNoise(x, y, z, w, FN_DECIMAL(m_octaves));
+}
+
+FN_DECIMAL FastNoise::GetNoise(FN_DECIMAL x, FN_DECIMAL y, FN_DECIMAL z, FN_DECIMAL w, FN_DECIMAL octaves) const
 {
 	x *= m_frequency;
 	y *= m_frequency;
@@ -608,9 +625,9 @@ FN_DECIMAL FastNoise::GetNoise(FN_DECIMAL x, FN_DECIMAL y, FN_DECIMAL z, FN_DECI
 	case ValueFractal:
 		switch (m_fractalType)
 		{
-		case FBM:        return SingleValueFractalFBM(x, y, z, w);
-		case Billow:     return SingleValueFractalBillow(x, y, z, w);
-		case RigidMulti: return SingleValueFractalRigidMulti(x, y, z, w);
+		case FBM:        return SingleValueFractalFBM(x, y, z, w, octaves);
+		case Billow:     return SingleValueFractalBillow(x, y, z, w, octaves);
+		case RigidMulti: return SingleValueFractalRigidMulti(x, y, z, w, octaves);
 		default: return 0;
 		}
 	case Perlin:
@@ -618,9 +635,9 @@ FN_DECIMAL FastNoise::GetNoise(FN_DECIMAL x, FN_DECIMAL y, FN_DECIMAL z, FN_DECI
 	case PerlinFractal:
 		switch (m_fractalType)
 		{
-		case FBM:        return SinglePerlinFractalFBM(x, y, z, w);
-		case Billow:     return SinglePerlinFractalBillow(x, y, z, w);
-		case RigidMulti: return SinglePerlinFractalRigidMulti(x, y, z, w);
+		case FBM:        return SinglePerlinFractalFBM(x, y, z, w, octaves);
+		case Billow:     return SinglePerlinFractalBillow(x, y, z, w, octaves);
+		case RigidMulti: return SinglePerlinFractalRigidMulti(x, y, z, w, octaves);
 		default: return 0;
 		}
 	case Simplex:
@@ -628,9 +645,9 @@ FN_DECIMAL FastNoise::GetNoise(FN_DECIMAL x, FN_DECIMAL y, FN_DECIMAL z, FN_DECI
 	case SimplexFractal:
 		switch (m_fractalType)
 		{
-		case FBM:        return SingleSimplexFractalFBM(x, y, z, w);
-		case Billow:     return SingleSimplexFractalBillow(x, y, z, w);
-		case RigidMulti: return SingleSimplexFractalRigidMulti(x, y, z, w);
+		case FBM:        return SingleSimplexFractalFBM(x, y, z, w, octaves);
+		case Billow:     return SingleSimplexFractalBillow(x, y, z, w, octaves);
+		case RigidMulti: return SingleSimplexFractalRigidMulti(x, y, z, w, octaves);
 		default: return 0;
 		}
 	case Cellular:
@@ -648,9 +665,9 @@ FN_DECIMAL FastNoise::GetNoise(FN_DECIMAL x, FN_DECIMAL y, FN_DECIMAL z, FN_DECI
 	case CubicFractal:
 		switch (m_fractalType)
 		{
-		case FBM:        return SingleCubicFractalFBM(x, y, z, w);
-		case Billow:     return SingleCubicFractalBillow(x, y, z, w);
-		case RigidMulti: return SingleCubicFractalRigidMulti(x, y, z, w);
+		case FBM:        return SingleCubicFractalFBM(x, y, z, w, octaves);
+		case Billow:     return SingleCubicFractalBillow(x, y, z, w, octaves);
+		case RigidMulti: return SingleCubicFractalRigidMulti(x, y, z, w, octaves);
 		default: return 0;
 		}
 	default:
@@ -1028,7 +1045,7 @@ FN_DECIMAL FastNoise::SingleValue(unsigned char offset, FN_DECIMAL x, FN_DECIMAL
 	return Lerp(zf0, zf1, ws);
 }
 
-FN_DECIMAL FastNoise::SingleValueFractalFBM(FN_DECIMAL x, FN_DECIMAL y, FN_DECIMAL z, FN_DECIMAL w) const
+FN_DECIMAL FastNoise::SingleValueFractalFBM(FN_DECIMAL x, FN_DECIMAL y, FN_DECIMAL z, FN_DECIMAL w, FN_DECIMAL octaves) const
 {
 	FN_DECIMAL sum = SingleValue(m_perm[0], x, y, z, w);
 	FN_DECIMAL amp = 1;
@@ -1036,19 +1053,23 @@ FN_DECIMAL FastNoise::SingleValueFractalFBM(FN_DECIMAL x, FN_DECIMAL y, FN_DECIM
 
 	while (++i < m_octaves)
 	{
+		FN_DECIMAL fade = octaves - i;
+		if (fade <= 0)
+			break;
+
 		x *= m_lacunarity;
 		y *= m_lacunarity;
 		z *= m_lacunarity;
 		w *= m_lacunarity;
 
 		amp *= m_gain;
-		sum += SingleValue(m_perm[i], x, y, z, w) * amp;
+		sum += OctaveFade(SingleValue(m_perm[i], x, y, z, w) * amp, fade);
 	}
 
 	return sum * m_fractalBounding;
 }
 
-FN_DECIMAL FastNoise::SingleValueFractalBillow(FN_DECIMAL x, FN_DECIMAL y, FN_DECIMAL z, FN_DECIMAL w) const
+FN_DECIMAL FastNoise::SingleValueFractalBillow(FN_DECIMAL x, FN_DECIMAL y, FN_DECIMAL z, FN_DECIMAL w, FN_DECIMAL octaves) const
 {
 	FN_DECIMAL sum = FastAbs(SingleValue(m_perm[0], x, y, z, w)) * 2 - 1;
 	FN_DECIMAL amp = 1;
@@ -1056,19 +1077,23 @@ FN_DECIMAL FastNoise::SingleValueFractalBillow(FN_DECIMAL x, FN_DECIMAL y, FN_DE
 
 	while (++i < m_octaves)
 	{
+		FN_DECIMAL fade = octaves - i;
+		if (fade <= 0)
+			break;
+
 		x *= m_lacunarity;
 		y *= m_lacunarity;
 		z *= m_lacunarity;
 		w *= m_lacunarity;
 
 		amp *= m_gain;
-		sum += (FastAbs(SingleValue(m_perm[i], x, y, z, w)) * 2 - 1) * amp;
+		sum += OctaveFade((FastAbs(SingleValue(m_perm[i], x, y, z, w)) * 2 - 1) * amp, fade);
 	}
 
 	return sum * m_fractalBounding;
 }
 
-FN_DECIMAL FastNoise::SingleValueFractalRigidMulti(FN_DECIMAL x, FN_DECIMAL y, FN_DECIMAL z, FN_DECIMAL w) const
+FN_DECIMAL FastNoise::SingleValueFractalRigidMulti(FN_DECIMAL x, FN_DECIMAL y, FN_DECIMAL z, FN_DECIMAL w, FN_DECIMAL octaves) const
 {
 	FN_DECIMAL sum = 1 - FastAbs(SingleValue(m_perm[0], x, y, z, w));
 	FN_DECIMAL amp = 1;
@@ -1076,13 +1101,17 @@ FN_DECIMAL FastNoise::SingleValueFractalRigidMulti(FN_DECIMAL x, FN_DECIMAL y, F
 
 	while (++i < m_octaves)
 	{
+		FN_DECIMAL fade = octaves - i;
+		if (fade <= 0)
+			break;
+
 		x *= m_lacunarity;
 		y *= m_lacunarity;
 		z *= m_lacunarity;
 		w *= m_lacunarity;
 
 		amp *= m_gain;
-		sum -= (1 - FastAbs(SingleValue(m_perm[i], x, y, z, w))) * amp;
+		sum -= OctaveFade((1 - FastAbs(SingleValue(m_perm[i], x, y, z, w))) * amp, fade);
 	}
 
 	return sum;
@@ -1390,7 +1419,7 @@ FN_DECIMAL FastNoise::SinglePerlin(unsigned char offset, FN_DECIMAL x, FN_DECIMA
 	return Lerp(zf0, zf1, ws);
 }
 
-FN_DECIMAL FastNoise::SinglePerlinFractalFBM(FN_DECIMAL x, FN_DECIMAL y, FN_DECIMAL z, FN_DECIMAL w) const
+FN_DECIMAL FastNoise::SinglePerlinFractalFBM(FN_DECIMAL x, FN_DECIMAL y, FN_DECIMAL z, FN_DECIMAL w, FN_DECIMAL octaves) const
 {
 	FN_DECIMAL sum = SinglePerlin(m_perm[0], x, y, z, w);
 	FN_DECIMAL amp = 1;
@@ -1398,19 +1427,23 @@ FN_DECIMAL FastNoise::SinglePerlinFractalFBM(FN_DECIMAL x, FN_DECIMAL y, FN_DECI
 
 	while (++i < m_octaves)
 	{
+		FN_DECIMAL fade = octaves - i;
+		if (fade <= 0)
+			break;
+
 		x *= m_lacunarity;
 		y *= m_lacunarity;
 		z *= m_lacunarity;
 		w *= m_lacunarity;
 
 		amp *= m_gain;
-		sum += SinglePerlin(m_perm[i], x, y, z, w) * amp;
+		sum += OctaveFade(SinglePerlin(m_perm[i], x, y, z, w) * amp, fade);
 	}
 
 	return sum * m_fractalBounding;
 }
 
-FN_DECIMAL FastNoise::SinglePerlinFractalBillow(FN_DECIMAL x, FN_DECIMAL y, FN_DECIMAL z, FN_DECIMAL w) const
+FN_DECIMAL FastNoise::SinglePerlinFractalBillow(FN_DECIMAL x, FN_DECIMAL y, FN_DECIMAL z, FN_DECIMAL w, FN_DECIMAL octaves) const
 {
 	FN_DECIMAL sum = FastAbs(SinglePerlin(m_perm[0], x, y, z, w)) * 2 - 1;
 	FN_DECIMAL amp = 1;
@@ -1418,19 +1451,23 @@ FN_DECIMAL FastNoise::SinglePerlinFractalBillow(FN_DECIMAL x, FN_DECIMAL y, FN_D
 
 	while (++i < m_octaves)
 	{
+		FN_DECIMAL fade = octaves - i;
+		if (fade <= 0)
+			break;
+
 		x *= m_lacunarity;
 		y *= m_lacunarity;
 		z *= m_lacunarity;
 		w *= m_lacunarity;
 
 		amp *= m_gain;
-		sum += (FastAbs(SinglePerlin(m_perm[i], x, y, z, w)) * 2 - 1) * amp;
+		sum += OctaveFade((FastAbs(SinglePerlin(m_perm[i], x, y, z, w)) * 2 - 1) * amp, fade);
 	}
 
 	return sum * m_fractalBounding;
 }
 
-FN_DECIMAL FastNoise::SinglePerlinFractalRigidMulti(FN_DECIMAL x, FN_DECIMAL y, FN_DECIMAL z, FN_DECIMAL w) const
+FN_DECIMAL FastNoise::SinglePerlinFractalRigidMulti(FN_DECIMAL x, FN_DECIMAL y, FN_DECIMAL z, FN_DECIMAL w, FN_DECIMAL octaves) const
 {
 	FN_DECIMAL sum = 1 - FastAbs(SinglePerlin(m_perm[0], x, y, z, w));
 	FN_DECIMAL amp = 1;
@@ -1438,13 +1475,17 @@ FN_DECIMAL FastNoise::SinglePerlinFractalRigidMulti(FN_DECIMAL x, FN_DECIMAL y,
 
 	while (++i < m_octaves)
 	{
+		FN_DECIMAL fade = octaves - i;
+		if (fade <= 0)
+			break;
+
 		x *= m_lacunarity;
 		y *= m_lacunarity;
 		z *= m_lacunarity;
 		w *= m_lacunarity;
 
 		amp *= m_gain;
-		sum -= (1 - FastAbs(SinglePerlin(m_perm[i], x, y, z, w))) * amp;
+		sum -= OctaveFade((1 - FastAbs(SinglePerlin(m_perm[i], x, y, z, w))) * amp, fade);
 	}
 
 	return sum;
@@ -1566,6 +1607,7 @@ FN_DECIMAL FastNoise::SinglePerlin(unsigned char offset, FN_DECIMAL x, FN_DECIMA
 
 FN_DECIMAL FastNoise::GetSimplexFractal(FN_DECIMAL x, FN_DECIMAL y, FN_DECIMAL z, FN_DECIMAL w) const
 {
+	FN_DECIMAL octaves = FN_DECIMAL(m_octaves);
 	x *= m_frequency;
 	y *= m_frequency;
 	z *= m_frequency;
@@ -1574,11 +1616,11 @@ FN_DECIMAL FastNoise::GetSimplexFractal(FN_DECIMAL x, FN_DECIMAL y, FN_DECIMAL z
 	switch (m_fractalType)
 	{
 	case FBM:
-		return SingleSimplexFractalFBM(x, y, z, w);
+		return SingleSimplexFractalFBM(x, y, z, w, octaves);
 	case Billow:
-		return SingleSimplexFractalBillow(x, y, z, w);
+		return SingleSimplexFractalBillow(x, y, z, w, octaves);
 	case RigidMulti:
-		return SingleSimplexFractalRigidMulti(x, y, z, w);
+		return SingleSimplexFractalRigidMulti(x, y, z, w, octaves);
 	default:
 		return 0;
 	}
@@ -1603,7 +1645,7 @@ FN_DECIMAL FastNoise::GetSimplexFractal(FN_DECIMAL x, FN_DECIMAL y, FN_DECIMAL z
 	}
 }
 
-FN_DECIMAL FastNoise::SingleSimplexFractalFBM(FN_DECIMAL x, FN_DECIMAL y, FN_DECIMAL z, FN_DECIMAL w) const
+FN_DECIMAL FastNoise::SingleSimplexFractalFBM(FN_DECIMAL x, FN_DECIMAL y, FN_DECIMAL z, FN_DECIMAL w, FN_DECIMAL octaves) const
 {
 	FN_DECIMAL sum = SingleSimplex(0, x * m_frequency, y * m_frequency, z * m_frequency, w * m_frequency);
 	FN_DECIMAL amp = 1;
@@ -1611,20 +1653,24 @@ FN_DECIMAL FastNoise::SingleSimplexFractalFBM(FN_DECIMAL x, FN_DECIMAL y, FN_DEC
 
 	while (++i < m_octaves)
 	{
+		FN_DECIMAL fade = octaves - i;
+		if (fade <= 0)
+			break;
+
 		x *= m_lacunarity;
 		y *= m_lacunarity;
 		z *= m_lacunarity;
 		w *= m_lacunarity;
 
 		amp *= m_gain;
-		sum += SingleSimplex(m_perm[i], x, y, z, w) * amp;
+		sum += OctaveFade(SingleSimplex(m_perm[i], x, y, z, w) * amp, fade);
 	}
 
 	return sum * m_fractalBounding;
 }
 
 
-FN_DECIMAL FastNoise::SingleSimplexFractalBillow(FN_DECIMAL x, FN_DECIMAL y, FN_DECIMAL z, FN_DECIMAL w) const
+FN_DECIMAL FastNoise::SingleSimplexFractalBillow(FN_DECIMAL x, FN_DECIMAL y, FN_DECIMAL z, FN_DECIMAL w, FN_DECIMAL octaves) const
 {
 	FN_DECIMAL sum = FastAbs(SingleSimplex(0, x * m_frequency, y * m_frequency, z * m_frequency, w * m_frequency)) * 2 - 1;
 	FN_DECIMAL amp = 1;
@@ -1632,19 +1678,23 @@ FN_DECIMAL FastNoise::SingleSimplexFractalBillow(FN_DECIMAL x, FN_DECIMAL y, FN_
 
 	while (++i < m_octaves)
 	{
+		FN_DECIMAL fade = octaves - i;
+		if (fade <= 0)
+			break;
+
 		x *= m_lacunarity;
 		y *= m_lacunarity;
 		z *= m_lacunarity;
 		w *= m_lacunarity;
 
 		amp *= m_gain;
-		sum += (FastAbs(SingleSimplex(m_perm[i], x, y, z, w)) * 2 - 1) * amp;
+		sum += OctaveFade((FastAbs(SingleSimplex(m_perm[i], x, y, z, w)) * 2 - 1) * amp, fade);
 	}
 
 	return sum * m_fractalBounding;
 }
 
-FN_DECIMAL FastNoise::SingleSimplexFractalRigidMulti(FN_DECIMAL x, FN_DECIMAL y, FN_DECIMAL z, FN_DECIMAL w) const
+FN_DECIMAL FastNoise::SingleSimplexFractalRigidMulti(FN_DECIMAL x, FN_DECIMAL y, FN_DECIMAL z, FN_DECIMAL w, FN_DECIMAL octaves) const
 {
 	FN_DECIMAL sum = 1 - FastAbs(SingleSimplex(0, x, y, z, w));
 	FN_DECIMAL amp = 1;
@@ -1652,13 +1702,17 @@ FN_DECIMAL FastNoise::SingleSimplexFractalRigidMulti(FN_DECIMAL x, FN_DECIMAL y,
 
 	while (++i < m_octaves)
 	{
+		FN_DECIMAL fade = octaves - i;
+		if (fade <= 0)
+			break;
+
 		x *= m_lacunarity;
 		y *= m_lacunarity;
 		z *= m_lacunarity;
 		w *= m_lacunarity;
 
 		amp *= m_gain;
-		sum -= (1 - FastAbs(SingleSimplex(m_perm[i], x, y, z, w))) * amp;
+		sum -= OctaveFade((1 - FastAbs(SingleSimplex(m_perm[i], x, y, z, w))) * amp, fade);
 	}
 
 	return sum;
@@ -2353,44 +2407,56 @@ FN_DECIMAL FastNoise::SingleCubic(unsigned char offset, FN_DECIMAL x, FN_DECIMAL
 	return CubicLerp(p0, p1, p2, p3, ws) * CUBIC_4D_BOUNDING;
 }
 
-FN_DECIMAL FastNoise::SingleCubicFractalFBM(FN_DECIMAL x, FN_DECIMAL y, FN_DECIMAL z, FN_DECIMAL w) const
+FN_DECIMAL FastNoise::SingleCubicFractalFBM(FN_DECIMAL x, FN_DECIMAL y, FN_DECIMAL z, FN_DECIMAL w, FN_DECIMAL octaves) const
 {
 	FN_DECIMAL sum = SingleCubic(m_perm[0], x, y, z, w);
 	FN_DECIMAL amp = 1;
 	int i = 0;
 	while (++i < m_octaves)
 	{
+		FN_DECIMAL fade = octaves - i;
+		if (fade <= 0)
+			break;
+
 		x *= m_lacunarity; y *= m_lacunarity; z *= m_lacunarity; w *= m_lacunarity;
 		amp *= m_gain;
-		sum += SingleCubic(m_perm[i], x, y, z, w) * amp;
+		sum += OctaveFade(SingleCubic(m_perm[i], x, y, z, w) * amp, fade);
 	}
 	return sum * m_fractalBounding;
 }
 
-FN_DECIMAL FastNoise::SingleCubicFractalBillow(FN_DECIMAL x, FN_DECIMAL y, FN_DECIMAL z, FN_DECIMAL w) const
+FN_DECIMAL FastNoise::SingleCubicFractalBillow(FN_DECIMAL x, FN_DECIMAL y, FN_DECIMAL z, FN_DECIMAL w, FN_DECIMAL octaves) const
 {
 	FN_DECIMAL sum = FastAbs(SingleCubic(m_perm[0], x, y, z, w)) * 2 - 1;
 	FN_DECIMAL amp = 1;
 	int i = 0;
 	while (++i < m_octaves)
 	{
+		FN_DECIMAL fade = octaves - i;
+		if (fade <= 0)
+			break;
+
 		x *= m_lacunarity; y *= m_lacunarity; z *= m_lacunarity; w *= m_lacunarity;
 		amp *= m_gain;
-		sum += (FastAbs(SingleCubic(m_perm[i], x, y, z, w)) * 2 - 1) * amp;
+		sum += OctaveFade((FastAbs(SingleCubic(m_perm[i], x, y, z, w)) * 2 - 1) * amp, fade);
 	}
 	return sum * m_fractalBounding;
 }
 
-FN_DECIMAL FastNoise::SingleCubicFractalRigidMulti(FN_DECIMAL x, FN_DECIMAL y, FN_DECIMAL z, FN_DECIMAL w) const
+FN_DECIMAL FastNoise::SingleCubicFractalRigidMulti(FN_DECIMAL x, FN_DECIMAL y, FN_DECIMAL z, FN_DECIMAL w, FN_DECIMAL octaves) const
 {
 	FN_DECIMAL sum = 1 - FastAbs(SingleCubic(m_perm[0], x, y, z, w));
 	FN_DECIMAL amp = 1;
 	int i = 0;
 	while (++i < m_octaves)
 	{
+		FN_DECIMAL fade = octaves - i;
+		if (fade <= 0)
+			break;
+
 		x *= m_lacunarity; y *= m_lacunarity; z *= m_lacunarity; w *= m_lacunarity;
 		amp *= m_gain;
-		sum -= (1 - FastAbs(SingleCubic(m_perm[i], x, y, z, w))) * amp;
+		sum -= OctaveFade((1 - FastAbs(SingleCubic(m_perm[i], x, y, z, w))) * amp, fade);
 	}
 	return sum;
 }
@@ -3311,3 +3377,153 @@ void FastNoise::SingleGradientPerturb(unsigned char offset, FN_DECIMAL warpAmp,
 	x += Lerp(lx0x, lx1x, ys) * warpAmp;
 	y += Lerp(ly0x, ly1x, ys) * warpAmp;
 }
+
+// Batched evaluation
+
+#ifdef FN_BATCH_SIMD
+
+// the settings the batch kernels need, copied out of the FastNoise instance
+struct FastNoiseBatchParams
+{
+	int perm[512];
+	// the lookups at the end of each hash chain, folded into perm:
+	// valPerm[i] = VAL_LUT[perm[i]], gradPerm[c][i] = GRAD_4D[(perm[i] & 31) * 4 + c],
+	// cellPerm[c][i] = CELL_4D_{X,Y,Z,W}[perm[i]]
+	float valPerm[512];
+	float gradPerm[4][512];
+	float cellPerm[4][512];
+	int seed;
+	FN_DECIMAL frequency;
+	FastNoise::Interp interp;
+	FastNoise::NoiseType noiseType;
+	int octaves;
+	FN_DECIMAL lacunarity;
+	FN_DECIMAL gain;
+	FastNoise::FractalType fractalType;
+	FN_DECIMAL fractalBounding;
+	FastNoise::CellularDistanceFunction cellularDistanceFunction;
+	FastNoise::CellularReturnType cellularReturnType;
+	int cellularDistanceIndex0;
+	int cellularDistanceIndex1;
+	FN_DECIMAL cellularJitter;
+};
+
+#if defined(__GNUC__) || defined(__clang__)
+#define FN_TARGET(isa) __attribute__((target(isa)))
+#else
+#define FN_TARGET(isa)
+#endif
+
+namespace FastNoiseSse41
+{
+#define FN_BATCH_AVX2 0
+#define FN_BATCH_TARGET FN_TARGET("sse4.1")
+#include "FastNoiseBatch.inl"
+#undef FN_BATCH_TARGET
+#undef FN_BATCH_AVX2
+}
+
+namespace FastNoiseAvx2
+{
+#define FN_BATCH_AVX2 1
+#define FN_BATCH_TARGET FN_TARGET("avx2")
+#include "FastNoiseBatch.inl"
+#undef FN_BATCH_TARGET
+#undef FN_BATCH_AVX2
+}
+
+enum FastNoiseBatchIsa { BatchScalar, BatchSse41, BatchAvx2 };
+
+static FastNoiseBatchIsa DetectBatchIsa()
+{
+#if defined(_MSC_VER) && !defined(__clang__)
+	int info[4];
+	__cpuid(info, 1);
+	const bool sse41 = (info[2] & (1 << 19)) != 0;
+	const bool osxsave = (info[2] & (1 << 27)) != 0;
+	const bool avx = (info[2] & (1 << 28)) != 0;
+	bool avx2 = false;
+	if (osxsave && avx && (_xgetbv(0) & 0x6) == 0x6)
+	{
+		__cpuidex(info, 7, 0);
+		avx2 = (info[1] & (1 << 5)) != 0;
+	}
+#else
+	__builtin_cpu_init();
+	const bool sse41 = __builtin_cpu_supports("sse4.1");
+	const bool avx2 = __builtin_cpu_supports("avx2");
+#endif
+	FastNoiseBatchIsa isa = avx2 ? BatchAvx2 : sse41 ? BatchSse41 : BatchScalar;
+
+	// same switch as the DeepC colour kernels: caps, never raises
+	const char* env = std::getenv("DEEPC_SIMD");
+	if (env)
+	{
+		if (std::strcmp(env, "scalar") == 0)
+			isa = BatchScalar;
+		else if (std::strcmp(env, "sse4") == 0 && isa > BatchSse41)
+			isa = BatchSse41;
+	}
+	return isa;
+}
+
+static FastNoiseBatchIsa BatchIsa()
+{
+	static const FastNoiseBatchIsa isa = DetectBatchIsa();
+	return isa;
+}
+
+#endif // FN_BATCH_SIMD
+
+void FastNoise::GetNoiseBatch(const FN_DECIMAL* x, const FN_DECIMAL* y, const FN_DECIMAL* z, FN_DECIMAL w, FN_DECIMAL* out, size_t n, const FN_DECIMAL* octaves) const
+{
+#ifdef FN_BATCH_SIMD
+	const FastNoiseBatchIsa isa = BatchIsa();
+	// NoiseLookup calls back into another FastNoise per point
+	const bool vectorized = !(m_noiseType == Cellular && m_cellularReturnType == NoiseLookup);
+	if (isa != BatchScalar && vectorized)
+	{
+		FastNoiseBatchParams p;
+		for (int i = 0; i < 512; i++)
+		{
+			const int h = m_perm[i];
+			p.perm[i] = h;
+			p.valPerm[i] = VAL_LUT[h];
+			for (int c = 0; c < 4; c++)
+				p.gradPerm[c][i] = GRAD_4D[((h & 31) << 2) + c];
+			p.cellPerm[0][i] = CELL_4D_X[h];
+			p.cellPerm[1][i] = CELL_4D_Y[h];
+			p.cellPerm[2][i] = CELL_4D_Z[h];
+			p.cellPerm[3][i] = CELL_4D_W[h];
+		}
+		p.seed = m_seed;
+		p.frequency = m_frequency;
+		p.interp = m_interp;
+		p.noiseType = m_noiseType;
+		p.octaves = m_octaves;
+		p.lacunarity = m_lacunarity;
+		p.gain = m_gain;
+		p.fractalType = m_fractalType;
+		p.fractalBounding = m_fractalBounding;
+		p.cellularDistanceFunction = m_cellularDistanceFunction;
+		p.cellularReturnType = m_cellularReturnType;
+		p.cellularDistanceIndex0 = m_cellularDistanceIndex0;
+		p.cellularDistanceIndex1 = m_cellularDistanceIndex1;
+		p.cellularJitter = m_cellularJitter;
+
+		if (isa == BatchAvx2)
+			FastNoiseAvx2::GetNoiseBatch(p, x, y, z, w, out, n, octaves);
+		else
+			FastNoiseSse41::GetNoiseBatch(p, x, y, z, w, out, n, octaves);
+		return;
+	}
+#endif
+	if (octaves)
+	{
+		for (size_t i = 0; i < n; i++)
+			out[i] = GetNoise(x[i], y[i], z[i], w, octaves[i]);
+		return;
+	}
+	for (size_t i = 0; i < n; i++)
+		out[i] = GetNoise(x[i], y[i], z[i], w);
+}
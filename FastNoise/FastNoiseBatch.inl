@@ -0,0 +1,699 @@
+// FastNoiseBatch.inl
+//
+// Vectorized 4D noise for FastNoise::GetNoiseBatch. Included twice from
+// FastNoise.cpp, inside a namespace per instruction set, with FN_BATCH_AVX2
+// set to 0 (SSE4.1, 4 lanes) or 1 (AVX2, 8 lanes) and FN_BATCH_TARGET set to
+// the matching function target attribute.
+//
+// Every kernel repeats the float operations of its scalar counterpart in
+// FastNoise.cpp in the same order, so each lane's result is identical to
+// GetNoise(x, y, z, w), or GetNoise(x, y, z, w, octaves) with octave limits.
+
+// ---------------------------------------------------------------------------
+// Lane primitives
+// ---------------------------------------------------------------------------
+
+#if FN_BATCH_AVX2
+
+typedef __m256 vf;
+typedef __m256i vi;
+static const int kLanes = 8;
+
+FN_BATCH_TARGET static inline vf vSet(float f) { return _mm256_set1_ps(f); }
+FN_BATCH_TARGET static inline vf vLoad(const float* p) { return _mm256_loadu_ps(p); }
+FN_BATCH_TARGET static inline void vStore(float* p, vf a) { _mm256_storeu_ps(p, a); }
+FN_BATCH_TARGET static inline vf vAdd(vf a, vf b) { return _mm256_add_ps(a, b); }
+FN_BATCH_TARGET static inline vf vSub(vf a, vf b) { return _mm256_sub_ps(a, b); }
+FN_BATCH_TARGET static inline vf vMul(vf a, vf b) { return _mm256_mul_ps(a, b); }
+FN_BATCH_TARGET static inline vf vDiv(vf a, vf b) { return _mm256_div_ps(a, b); }
+FN_BATCH_TARGET static inline vf vMin(vf a, vf b) { return _mm256_min_ps(a, b); }
+FN_BATCH_TARGET static inline vf vMax(vf a, vf b) { return _mm256_max_ps(a, b); }
+FN_BATCH_TARGET static inline vf vAbs(vf a) { return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a); }
+FN_BATCH_TARGET static inline vf vLess(vf a, vf b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+FN_BATCH_TARGET static inline vf vGreater(vf a, vf b) { return _mm256_cmp_ps(a, b, _CMP_GT_OQ); }
+FN_BATCH_TARGET static inline vf vGreaterEqual(vf a, vf b) { return _mm256_cmp_ps(a, b, _CMP_GE_OQ); }
+FN_BATCH_TARGET static inline vf vNotGreaterEqual(vf a, vf b) { return _mm256_cmp_ps(a, b, _CMP_NGE_UQ); }
+// mask ? a : b
+FN_BATCH_TARGET static inline vf vSelect(vf mask, vf a, vf b) { return _mm256_blendv_ps(b, a, mask); }
+FN_BATCH_TARGET static inline bool vAny(vf mask) { return _mm256_movemask_ps(mask) != 0; }
+
+FN_BATCH_TARGET static inline vi vSetI(int i) { return _mm256_set1_epi32(i); }
+FN_BATCH_TARGET static inline vi vAddI(vi a, vi b) { return _mm256_add_epi32(a, b); }
+FN_BATCH_TARGET static inline vi vSubI(vi a, vi b) { return _mm256_sub_epi32(a, b); }
+FN_BATCH_TARGET static inline vi vMulI(vi a, vi b) { return _mm256_mullo_epi32(a, b); }
+FN_BATCH_TARGET static inline vi vXorI(vi a, vi b) { return _mm256_xor_si256(a, b); }
+FN_BATCH_TARGET static inline vi vAndI(vi a, vi b) { return _mm256_and_si256(a, b); }
+FN_BATCH_TARGET static inline vi vShiftLeftI(vi a, int bits) { return _mm256_slli_epi32(a, bits); }
+FN_BATCH_TARGET static inline vi vGreaterI(vi a, vi b) { return _mm256_cmpgt_epi32(a, b); }
+FN_BATCH_TARGET static inline vi vSelectI(vf mask, vi a, vi b) { return _mm256_castps_si256(_mm256_blendv_ps(_mm256_castsi256_ps(b), _mm256_castsi256_ps(a), mask)); }
+FN_BATCH_TARGET static inline vi vMaskI(vf mask) { return _mm256_castps_si256(mask); }
+FN_BATCH_TARGET static inline vi vTruncate(vf a) { return _mm256_cvttps_epi32(a); }
+FN_BATCH_TARGET static inline vf vToFloat(vi a) { return _mm256_cvtepi32_ps(a); }
+
+FN_BATCH_TARGET static inline vi vGatherI(const int* table, vi index) { return _mm256_i32gather_epi32(table, index, 4); }
+FN_BATCH_TARGET static inline vf vGather(const float* table, vi index) { return _mm256_i32gather_ps(table, index, 4); }
+
+#else
+
+typedef __m128 vf;
+typedef __m128i vi;
+static const int kLanes = 4;
+
+FN_BATCH_TARGET static inline vf vSet(float f) { return _mm_set1_ps(f); }
+FN_BATCH_TARGET static inline vf vLoad(const float* p) { return _mm_loadu_ps(p); }
+FN_BATCH_TARGET static inline void vStore(float* p, vf a) { _mm_storeu_ps(p, a); }
+FN_BATCH_TARGET static inline vf vAdd(vf a, vf b) { return _mm_add_ps(a, b); }
+FN_BATCH_TARGET static inline vf vSub(vf a, vf b) { return _mm_sub_ps(a, b); }
+FN_BATCH_TARGET static inline vf vMul(vf a, vf b) { return _mm_mul_ps(a, b); }
+FN_BATCH_TARGET static inline vf vDiv(vf a, vf b) { return _mm_div_ps(a, b); }
+FN_BATCH_TARGET static inline vf vMin(vf a, vf b) { return _mm_min_ps(a, b); }
+FN_BATCH_TARGET static inline vf vMax(vf a, vf b) { return _mm_max_ps(a, b); }
+FN_BATCH_TARGET static inline vf vAbs(vf a) { return _mm_andnot_ps(_mm_set1_ps(-0.0f), a); }
+FN_BATCH_TARGET static inline vf vLess(vf a, vf b) { return _mm_cmplt_ps(a, b); }
+FN_BATCH_TARGET static inline vf vGreater(vf a, vf b) { return _mm_cmpgt_ps(a, b); }
+FN_BATCH_TARGET static inline vf vGreaterEqual(vf a, vf b) { return _mm_cmpge_ps(a, b); }
+FN_BATCH_TARGET static inline vf vNotGreaterEqual(vf a, vf b) { return _mm_cmpnge_ps(a, b); }
+// mask ? a : b
+FN_BATCH_TARGET static inline vf vSelect(vf mask, vf a, vf b) { return _mm_blendv_ps(b, a, mask); }
+FN_BATCH_TARGET static inline bool vAny(vf mask) { return _mm_movemask_ps(mask) != 0; }
+
+FN_BATCH_TARGET static inline vi vSetI(int i) { return _mm_set1_epi32(i); }
+FN_BATCH_TARGET static inline vi vAddI(vi a, vi b) { return _mm_add_epi32(a, b); }
+FN_BATCH_TARGET static inline vi vSubI(vi a, vi b) { return _mm_sub_epi32(a, b); }
+FN_BATCH_TARGET static inline vi vMulI(vi a, vi b) { return _mm_mullo_epi32(a, b); }
+FN_BATCH_TARGET static inline vi vXorI(vi a, vi b) { return _mm_xor_si128(a, b); }
+FN_BATCH_TARGET static inline vi vAndI(vi a, vi b) { return _mm_and_si128(a, b); }
+FN_BATCH_TARGET static inline vi vShiftLeftI(vi a, int bits) { return _mm_slli_epi32(a, bits); }
+FN_BATCH_TARGET static inline vi vGreaterI(vi a, vi b) { return _mm_cmpgt_epi32(a, b); }
+FN_BATCH_TARGET static inline vi vSelectI(vf mask, vi a, vi b) { return _mm_castps_si128(_mm_blendv_ps(_mm_castsi128_ps(b), _mm_castsi128_ps(a), mask)); }
+FN_BATCH_TARGET static inline vi vMaskI(vf mask) { return _mm_castps_si128(mask); }
+FN_BATCH_TARGET static inline vi vTruncate(vf a) { return _mm_cvttps_epi32(a); }
+FN_BATCH_TARGET static inline vf vToFloat(vi a) { return _mm_cvtepi32_ps(a); }
+
+// no gather instruction before AVX2
+FN_BATCH_TARGET static inline vi vGatherI(const int* table, vi index)
+{
+	int i[4];
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(i), index);
+	return _mm_setr_epi32(table[i[0]], table[i[1]], table[i[2]], table[i[3]]);
+}
+FN_BATCH_TARGET static inline vf vGather(const float* table, vi index)
+{
+	int i[4];
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(i), index);
+	return _mm_setr_ps(table[i[0]], table[i[1]], table[i[2]], table[i[3]]);
+}
+
+#endif
+
+// ---------------------------------------------------------------------------
+// Helpers - FastFloor, FastRound, Lerp, the interpolants and the hashes
+// ---------------------------------------------------------------------------
+
+// (int)f, minus 1 unless f >= 0
+FN_BATCH_TARGET static inline vi vFastFloor(vf f)
+{
+	return vAddI(vTruncate(f), vMaskI(vNotGreaterEqual(f, vSet(0))));
+}
+
+FN_BATCH_TARGET static inline vi vFastRound(vf f)
+{
+	const vf half = vSet(FN_DECIMAL(0.5));
+	return vTruncate(vSelect(vGreaterEqual(f, vSet(0)), vAdd(f, half), vSub(f, half)));
+}
+
+FN_BATCH_TARGET static inline vf vLerp(vf a, vf b, vf t)
+{
+	return vAdd(a, vMul(t, vSub(b, a)));
+}
+
+FN_BATCH_TARGET static inline vf vCubicLerp(vf a, vf b, vf c, vf d, vf t)
+{
+	const vf p = vSub(vSub(d, c), vSub(a, b));
+	const vf t2 = vMul(t, t);
+	vf r = vMul(vMul(t2, t), p);
+	r = vAdd(r, vMul(t2, vSub(vSub(a, b), p)));
+	r = vAdd(r, vMul(t, vSub(c, a)));
+	return vAdd(r, b);
+}
+
+FN_BATCH_TARGET static inline vf vInterp(FastNoise::Interp interp, vf t)
+{
+	switch (interp)
+	{
+	case FastNoise::Hermite:
+		// t*t*(3 - 2 * t)
+		return vMul(vMul(t, t), vSub(vSet(3), vMul(vSet(2), t)));
+	case FastNoise::Quintic:
+		// t*t*t*(t*(t * 6 - 15) + 10)
+		return vMul(vMul(vMul(t, t), t), vAdd(vMul(t, vSub(vMul(t, vSet(6)), vSet(15))), vSet(10)));
+	default:
+		return t;
+	}
+}
+
+// one level of the Index4D_256 chain: perm[(c & 0xff) + h]
+FN_BATCH_TARGET static inline vi vHash(const int* perm, vi c, vi h)
+{
+	return vGatherI(perm, vAddI(vAndI(c, vSetI(0xff)), h));
+}
+
+// the last level of the chain, looked up straight into one of the
+// FastNoiseBatchParams tables, e.g. valPerm[i] == VAL_LUT[perm[i]]
+FN_BATCH_TARGET static inline vf vHashLookup(const float* table, vi c, vi h)
+{
+	return vGather(table, vAddI(vAndI(c, vSetI(0xff)), h));
+}
+
+// GradCoord4D, from the hash of (y, z, w)
+FN_BATCH_TARGET static inline vf vGradCoord(const FastNoiseBatchParams& p, vi x, vi hyzw, vf xd, vf yd, vf zd, vf wd)
+{
+	const vi i = vAddI(vAndI(x, vSetI(0xff)), hyzw);
+	vf r = vMul(xd, vGather(p.gradPerm[0], i));
+	r = vAdd(r, vMul(yd, vGather(p.gradPerm[1], i)));
+	r = vAdd(r, vMul(zd, vGather(p.gradPerm[2], i)));
+	return vAdd(r, vMul(wd, vGather(p.gradPerm[3], i)));
+}
+
+// ValCoord4D
+FN_BATCH_TARGET static inline vf vValCoordHash(int seed, vi x, vi y, vi z, vi w)
+{
+	vi n = vSetI(seed);
+	n = vXorI(n, vMulI(vSetI(X_PRIME), x));
+	n = vXorI(n, vMulI(vSetI(Y_PRIME), y));
+	n = vXorI(n, vMulI(vSetI(Z_PRIME), z));
+	n = vXorI(n, vMulI(vSetI(W_PRIME), w));
+	n = vMulI(vMulI(vMulI(n, n), n), vSetI(60493));
+	return vDiv(vToFloat(n), vSet(FN_DECIMAL(2147483648)));
+}
+
+// ---------------------------------------------------------------------------
+// Single octave noise
+// ---------------------------------------------------------------------------
+
+// SingleValue and SinglePerlin share their lattice setup; corners are lerped
+// x first, then y, z and w
+FN_BATCH_TARGET static vf vSingleValue(const FastNoiseBatchParams& p, int offset, vf x, vf y, vf z, vf w)
+{
+	const vi one = vSetI(1);
+	const vi x0 = vFastFloor(x), y0 = vFastFloor(y), z0 = vFastFloor(z), w0 = vFastFloor(w);
+	const vi x1 = vAddI(x0, one), y1 = vAddI(y0, one), z1 = vAddI(z0, one), w1 = vAddI(w0, one);
+
+	const vf xs = vInterp(p.interp, vSub(x, vToFloat(x0)));
+	const vf ys = vInterp(p.interp, vSub(y, vToFloat(y0)));
+	const vf zs = vInterp(p.interp, vSub(z, vToFloat(z0)));
+	const vf ws = vInterp(p.interp, vSub(w, vToFloat(w0)));
+
+	const vi yi[2] = { y0, y1 };
+	const vi zi[2] = { z0, z1 };
+	const vi wi[2] = { w0, w1 };
+	vf zf[2];
+	for (int l = 0; l < 2; l++)
+	{
+		const vi hw = vHash(p.perm, wi[l], vSetI(offset));
+		vf yf[2];
+		for (int k = 0; k < 2; k++)
+		{
+			const vi hz = vHash(p.perm, zi[k], hw);
+			vf xf[2];
+			for (int j = 0; j < 2; j++)
+			{
+				const vi hy = vHash(p.perm, yi[j], hz);
+				xf[j] = vLerp(vHashLookup(p.valPerm, x0, hy), vHashLookup(p.valPerm, x1, hy), xs);
+			}
+			yf[k] = vLerp(xf[0], xf[1], ys);
+		}
+		zf[l] = vLerp(yf[0], yf[1], zs);
+	}
+	return vLerp(zf[0], zf[1], ws);
+}
+
+FN_BATCH_TARGET static vf vSinglePerlin(const FastNoiseBatchParams& p, int offset, vf x, vf y, vf z, vf w)
+{
+	const vi one = vSetI(1);
+	const vf fone = vSet(1);
+	const vi x0 = vFastFloor(x), y0 = vFastFloor(y), z0 = vFastFloor(z), w0 = vFastFloor(w);
+	const vi x1 = vAddI(x0, one), y1 = vAddI(y0, one), z1 = vAddI(z0, one), w1 = vAddI(w0, one);
+
+	const vf xd0 = vSub(x, vToFloat(x0));
+	const vf yd0 = vSub(y, vToFloat(y0));
+	const vf zd0 = vSub(z, vToFloat(z0));
+	const vf wd0 = vSub(w, vToFloat(w0));
+	const vf xd1 = vSub(xd0, fone);
+
+	const vf xs = vInterp(p.interp, xd0);
+	const vf ys = vInterp(p.interp, yd0);
+	const vf zs = vInterp(p.interp, zd0);
+	const vf ws = vInterp(p.interp, wd0);
+
+	const vi yi[2] = { y0, y1 };
+	const vi zi[2] = { z0, z1 };
+	const vi wi[2] = { w0, w1 };
+	const vf yd[2] = { yd0, vSub(yd0, fone) };
+	const vf zd[2] = { zd0, vSub(zd0, fone) };
+	const vf wd[2] = { wd0, vSub(wd0, fone) };
+	vf zf[2];
+	for (int l = 0; l < 2; l++)
+	{
+		const vi hw = vHash(p.perm, wi[l], vSetI(offset));
+		vf yf[2];
+		for (int k = 0; k < 2; k++)
+		{
+			const vi hz = vHash(p.perm, zi[k], hw);
+			vf xf[2];
+			for (int j = 0; j < 2; j++)
+			{
+				const vi hy = vHash(p.perm, yi[j], hz);
+				xf[j] = vLerp(
+					vGradCoord(p, x0, hy, xd0, yd[j], zd[k], wd[l]),
+					vGradCoord(p, x1, hy, xd1, yd[j], zd[k], wd[l]),
+					xs);
+			}
+			yf[k] = vLerp(xf[0], xf[1], ys);
+		}
+		zf[l] = vLerp(yf[0], yf[1], zs);
+	}
+	return vLerp(zf[0], zf[1], ws);
+}
+
+// one simplex corner: t < 0 contributes 0, otherwise t^4 * gradient
+FN_BATCH_TARGET static inline vf vSimplexCorner(const FastNoiseBatchParams& p, int offset, vi i, vi j, vi k, vi l, vf x, vf y, vf z, vf w)
+{
+	vf t = vSub(vSub(vSub(vSub(vSet(FN_DECIMAL(0.6)), vMul(x, x)), vMul(y, y)), vMul(z, z)), vMul(w, w));
+	const vf outside = vLess(t, vSet(0));
+	t = vMul(t, t);
+	const vi h = vHash(p.perm, j, vHash(p.perm, k, vHash(p.perm, l, vSetI(offset))));
+	const vf n = vMul(vMul(t, t), vGradCoord(p, i, h, x, y, z, w));
+	return vSelect(outside, vSet(0), n);
+}
+
+FN_BATCH_TARGET static vf vSingleSimplex(const FastNoiseBatchParams& p, int offset, vf x, vf y, vf z, vf w)
+{
+	vf t = vMul(vAdd(vAdd(vAdd(x, y), z), w), vSet(F4));
+	const vi i = vFastFloor(vAdd(x, t));
+	const vi j = vFastFloor(vAdd(y, t));
+	const vi k = vFastFloor(vAdd(z, t));
+	const vi l = vFastFloor(vAdd(w, t));
+	t = vMul(vToFloat(vAddI(vAddI(vAddI(i, j), k), l)), vSet(G4));
+	const vf x0 = vSub(x, vSub(vToFloat(i), t));
+	const vf y0 = vSub(y, vSub(vToFloat(j), t));
+	const vf z0 = vSub(z, vSub(vToFloat(k), t));
+	const vf w0 = vSub(w, vSub(vToFloat(l), t));
+
+	// ranks, counted with the -1 / 0 compare masks
+	const vi xy = vMaskI(vGreater(x0, y0));
+	const vi xz = vMaskI(vGreater(x0, z0));
+	const vi xw = vMaskI(vGreater(x0, w0));
+	const vi yz = vMaskI(vGreater(y0, z0));
+	const vi yw = vMaskI(vGreater(y0, w0));
+	const vi zw = vMaskI(vGreater(z0, w0));
+	const vi none = vSetI(-1);
+	const vi rankx = vSubI(vSetI(0), vAddI(vAddI(xy, xz), xw));
+	const vi ranky = vSubI(vSetI(0), vAddI(vAddI(vXorI(xy, none), yz), yw));
+	const vi rankz = vSubI(vSetI(0), vAddI(vAddI(vXorI(xz, none), vXorI(yz, none)), zw));
+	const vi rankw = vSubI(vSetI(0), vAddI(vAddI(vXorI(xw, none), vXorI(yw, none)), vXorI(zw, none)));
+
+	const vi one = vSetI(1);
+	vf n = vSimplexCorner(p, offset, i, j, k, l, x0, y0, z0, w0);
+	for (int c = 1; c <= 3; c++)
+	{
+		// corner c steps along each axis whose rank is at least 4 - c
+		const vi threshold = vSetI(3 - c);
+		const vi ic = vAndI(vGreaterI(rankx, threshold), one);
+		const vi jc = vAndI(vGreaterI(ranky, threshold), one);
+		const vi kc = vAndI(vGreaterI(rankz, threshold), one);
+		const vi lc = vAndI(vGreaterI(rankw, threshold), one);
+		const vf g = vSet(c * G4);
+		n = vAdd(n, vSimplexCorner(p, offset,
+			vAddI(i, ic), vAddI(j, jc), vAddI(k, kc), vAddI(l, lc),
+			vAdd(vSub(x0, vToFloat(ic)), g),
+			vAdd(vSub(y0, vToFloat(jc)), g),
+			vAdd(vSub(z0, vToFloat(kc)), g),
+			vAdd(vSub(w0, vToFloat(lc)), g)));
+	}
+	const vf g4 = vSet(4 * G4);
+	const vf fone = vSet(1);
+	n = vAdd(n, vSimplexCorner(p, offset,
+		vAddI(i, one), vAddI(j, one), vAddI(k, one), vAddI(l, one),
+		vAdd(vSub(x0, fone), g4),
+		vAdd(vSub(y0, fone), g4),
+		vAdd(vSub(z0, fone), g4),
+		vAdd(vSub(w0, fone), g4)));
+
+	return vMul(vSet(27), n);
+}
+
+FN_BATCH_TARGET static vf vSingleCubic(const FastNoiseBatchParams& p, int offset, vf x, vf y, vf z, vf w)
+{
+	const vi x1 = vFastFloor(x), y1 = vFastFloor(y), z1 = vFastFloor(z), w1 = vFastFloor(w);
+
+	const vf xs = vSub(x, vToFloat(x1));
+	const vf ys = vSub(y, vToFloat(y1));
+	const vf zs = vSub(z, vToFloat(z1));
+	const vf ws = vSub(w, vToFloat(w1));
+
+	vi xi[4], yi[4], zi[4], wi[4];
+	for (int a = 0; a < 4; a++)
+	{
+		const vi d = vSetI(a - 1);
+		xi[a] = vAddI(x1, d);
+		yi[a] = vAddI(y1, d);
+		zi[a] = vAddI(z1, d);
+		wi[a] = vAddI(w1, d);
+	}
+
+	// 4 w-slabs of 4 z-planes of 4 y-rows of 4 lattice values
+	vf pw[4];
+	for (int l = 0; l < 4; l++)
+	{
+		const vi hw = vHash(p.perm, wi[l], vSetI(offset));
+		vf pz[4];
+		for (int k = 0; k < 4; k++)
+		{
+			const vi hz = vHash(p.perm, zi[k], hw);
+			vf py[4];
+			for (int j = 0; j < 4; j++)
+			{
+				const vi hy = vHash(p.perm, yi[j], hz);
+				py[j] = vCubicLerp(
+					vHashLookup(p.valPerm, xi[0], hy),
+					vHashLookup(p.valPerm, xi[1], hy),
+					vHashLookup(p.valPerm, xi[2], hy),
+					vHashLookup(p.valPerm, xi[3], hy),
+					xs);
+			}
+			pz[k] = vCubicLerp(py[0], py[1], py[2], py[3], ys);
+		}
+		pw[l] = vCubicLerp(pz[0], pz[1], pz[2], pz[3], zs);
+	}
+	return vMul(vCubicLerp(pw[0], pw[1], pw[2], pw[3], ws), vSet(CUBIC_4D_BOUNDING));
+}
+
+// ---------------------------------------------------------------------------
+// Cellular
+// ---------------------------------------------------------------------------
+
+// distance to the jittered point of cell (xi, yi, zi, wi), from the hash of
+// (yi, zi, wi)
+FN_BATCH_TARGET static inline vf vCellDistance(const FastNoiseBatchParams& p, vi xi, vi yi, vi zi, vi wi, vi hyzw, vf x, vf y, vf z, vf w)
+{
+	const vi i = vAddI(vAndI(xi, vSetI(0xff)), hyzw);
+	const vf jitter = vSet(p.cellularJitter);
+
+	const vf vecX = vAdd(vSub(vToFloat(xi), x), vMul(vGather(p.cellPerm[0], i), jitter));
+	const vf vecY = vAdd(vSub(vToFloat(yi), y), vMul(vGather(p.cellPerm[1], i), jitter));
+	const vf vecZ = vAdd(vSub(vToFloat(zi), z), vMul(vGather(p.cellPerm[2], i), jitter));
+	const vf vecW = vAdd(vSub(vToFloat(wi), w), vMul(vGather(p.cellPerm[3], i), jitter));
+
+	const vf manhattan = vAdd(vAdd(vAdd(vAbs(vecX), vAbs(vecY)), vAbs(vecZ)), vAbs(vecW));
+	const vf euclidean = vAdd(vAdd(vAdd(vMul(vecX, vecX), vMul(vecY, vecY)), vMul(vecZ, vecZ)), vMul(vecW, vecW));
+
+	switch (p.cellularDistanceFunction)
+	{
+	case FastNoise::Euclidean:
+		return euclidean;
+	case FastNoise::Manhattan:
+		return manhattan;
+	default:
+		return vAdd(manhattan, euclidean);
+	}
+}
+
+FN_BATCH_TARGET static vf vSingleCellular(const FastNoiseBatchParams& p, vf x, vf y, vf z, vf w)
+{
+	const vi xr = vFastRound(x), yr = vFastRound(y), zr = vFastRound(z), wr = vFastRound(w);
+
+	vf distance = vSet(999999);
+	vi xcell = vSetI(0), ycell = vSetI(0), zcell = vSetI(0), wcell = vSetI(0);
+
+	for (int dw = -1; dw <= 1; dw++)
+	{
+		const vi wi = vAddI(wr, vSetI(dw));
+		const vi hw = vHash(p.perm, wi, vSetI(0));
+		for (int dz = -1; dz <= 1; dz++)
+		{
+			const vi zi = vAddI(zr, vSetI(dz));
+			const vi hz = vHash(p.perm, zi, hw);
+			for (int dy = -1; dy <= 1; dy++)
+			{
+				const vi yi = vAddI(yr, vSetI(dy));
+				const vi hy = vHash(p.perm, yi, hz);
+				for (int dx = -1; dx <= 1; dx++)
+				{
+					const vi xi = vAddI(xr, vSetI(dx));
+					const vf newDistance = vCellDistance(p, xi, yi, zi, wi, hy, x, y, z, w);
+					const vf closer = vLess(newDistance, distance);
+					distance = vSelect(closer, newDistance, distance);
+					xcell = vSelectI(closer, xi, xcell);
+					ycell = vSelectI(closer, yi, ycell);
+					zcell = vSelectI(closer, zi, zcell);
+					wcell = vSelectI(closer, wi, wcell);
+				}
+			}
+		}
+	}
+
+	switch (p.cellularReturnType)
+	{
+	case FastNoise::CellValue:
+		return vValCoordHash(p.seed, xcell, ycell, zcell, wcell);
+	case FastNoise::Distance:
+		return distance;
+	default:
+		// NoiseLookup is left to the scalar path
+		return vSet(0);
+	}
+}
+
+FN_BATCH_TARGET static vf vSingleCellular2Edge(const FastNoiseBatchParams& p, vf x, vf y, vf z, vf w)
+{
+	const vi xr = vFastRound(x), yr = vFastRound(y), zr = vFastRound(z), wr = vFastRound(w);
+
+	vf distance[FN_CELLULAR_INDEX_MAX + 1];
+	for (int i = 0; i <= FN_CELLULAR_INDEX_MAX; i++)
+		distance[i] = vSet(999999);
+
+	for (int dw = -1; dw <= 1; dw++)
+	{
+		const vi wi = vAddI(wr, vSetI(dw));
+		const vi hw = vHash(p.perm, wi, vSetI(0));
+		for (int dz = -1; dz <= 1; dz++)
+		{
+			const vi zi = vAddI(zr, vSetI(dz));
+			const vi hz = vHash(p.perm, zi, hw);
+			for (int dy = -1; dy <= 1; dy++)
+			{
+				const vi yi = vAddI(yr, vSetI(dy));
+				const vi hy = vHash(p.perm, yi, hz);
+				for (int dx = -1; dx <= 1; dx++)
+				{
+					const vi xi = vAddI(xr, vSetI(dx));
+					const vf newDistance = vCellDistance(p, xi, yi, zi, wi, hy, x, y, z, w);
+
+					// fmin(a, NaN) == a, as is vMin(NaN, a)
+					for (int i = p.cellularDistanceIndex1; i > 0; i--)
+						distance[i] = vMax(vMin(newDistance, distance[i]), distance[i - 1]);
+					distance[0] = vMin(newDistance, distance[0]);
+				}
+			}
+		}
+	}
+
+	const vf d0 = distance[p.cellularDistanceIndex0];
+	const vf d1 = distance[p.cellularDistanceIndex1];
+	switch (p.cellularReturnType)
+	{
+	case FastNoise::Distance2:
+		return d1;
+	case FastNoise::Distance2Add:
+		return vAdd(d1, d0);
+	case FastNoise::Distance2Sub:
+		return vSub(d1, d0);
+	case FastNoise::Distance2Mul:
+		return vMul(d1, d0);
+	case FastNoise::Distance2Div:
+		return vDiv(d0, d1);
+	default:
+		return vSet(0);
+	}
+}
+
+// ---------------------------------------------------------------------------
+// Fractals
+// ---------------------------------------------------------------------------
+
+FN_BATCH_TARGET static inline vf vSingle(const FastNoiseBatchParams& p, FastNoise::NoiseType base, int offset, vf x, vf y, vf z, vf w)
+{
+	switch (base)
+	{
+	case FastNoise::Value:
+		return vSingleValue(p, offset, x, y, z, w);
+	case FastNoise::Perlin:
+		return vSinglePerlin(p, offset, x, y, z, w);
+	case FastNoise::Simplex:
+		return vSingleSimplex(p, offset, x, y, z, w);
+	default:
+		return vSingleCubic(p, offset, x, y, z, w);
+	}
+}
+
+// Single*FractalFBM / Billow / RigidMulti. The Simplex versions start from
+// offset 0 rather than m_perm[0], and FBM and Billow scale their first
+// octave by the frequency a second time.
+//
+// With lod set, each lane stops at its own fractional octave limit: lanes
+// past their limit keep their sum, the last octave is faded as in
+// OctaveFade, and the loop ends once every lane is done.
+FN_BATCH_TARGET static vf vFractal(const FastNoiseBatchParams& p, FastNoise::NoiseType base, vf x, vf y, vf z, vf w, bool lod, vf limit)
+{
+	const vf one = vSet(1);
+	const vf two = vSet(2);
+
+	int offset = p.perm[0];
+	vf fx = x, fy = y, fz = z, fw = w;
+	if (base == FastNoise::Simplex)
+	{
+		offset = 0;
+		if (p.fractalType != FastNoise::RigidMulti)
+		{
+			const vf frequency = vSet(p.frequency);
+			fx = vMul(x, frequency);
+			fy = vMul(y, frequency);
+			fz = vMul(z, frequency);
+			fw = vMul(w, frequency);
+		}
+	}
+
+	vf sum = vSingle(p, base, offset, fx, fy, fz, fw);
+	switch (p.fractalType)
+	{
+	case FastNoise::Billow:
+		sum = vSub(vMul(vAbs(sum), two), one);
+		break;
+	case FastNoise::RigidMulti:
+		sum = vSub(one, vAbs(sum));
+		break;
+	default:
+		break;
+	}
+
+	const vf lacunarity = vSet(p.lacunarity);
+	FN_DECIMAL amp = 1;
+	int i = 0;
+	while (++i < p.octaves)
+	{
+		vf fade = one, active = one;
+		if (lod)
+		{
+			// !(fade <= 0), so NaN limits keep every octave like the scalar code
+			fade = vSub(limit, vSet(FN_DECIMAL(i)));
+			active = vNotGreaterEqual(vSet(0), fade);
+			if (!vAny(active))
+				break;
+		}
+
+		x = vMul(x, lacunarity);
+		y = vMul(y, lacunarity);
+		z = vMul(z, lacunarity);
+		w = vMul(w, lacunarity);
+
+		amp *= p.gain;
+		const vf n = vSingle(p, base, p.perm[i], x, y, z, w);
+		vf term;
+		switch (p.fractalType)
+		{
+		case FastNoise::Billow:
+			term = vMul(vSub(vMul(vAbs(n), two), one), vSet(amp));
+			break;
+		case FastNoise::RigidMulti:
+			term = vMul(vSub(one, vAbs(n)), vSet(amp));
+			break;
+		default:
+			term = vMul(n, vSet(amp));
+			break;
+		}
+
+		if (lod)
+			term = vSelect(vLess(fade, one), vMul(term, fade), term);
+		const vf next = p.fractalType == FastNoise::RigidMulti ? vSub(sum, term) : vAdd(sum, term);
+		sum = lod ? vSelect(active, next, sum) : next;
+	}
+
+	if (p.fractalType == FastNoise::RigidMulti)
+		return sum;
+	return vMul(sum, vSet(p.fractalBounding));
+}
+
+// ---------------------------------------------------------------------------
+// GetNoise
+// ---------------------------------------------------------------------------
+
+FN_BATCH_TARGET static vf vGetNoise(const FastNoiseBatchParams& p, vf x, vf y, vf z, vf w, bool lod, vf limit)
+{
+	const vf frequency = vSet(p.frequency);
+	x = vMul(x, frequency);
+	y = vMul(y, frequency);
+	z = vMul(z, frequency);
+	w = vMul(w, frequency);
+
+	switch (p.noiseType)
+	{
+	case FastNoise::Value:
+		return vSingleValue(p, 0, x, y, z, w);
+	case FastNoise::ValueFractal:
+		return vFractal(p, FastNoise::Value, x, y, z, w, lod, limit);
+	case FastNoise::Perlin:
+		return vSinglePerlin(p, 0, x, y, z, w);
+	case FastNoise::PerlinFractal:
+		return vFractal(p, FastNoise::Perlin, x, y, z, w, lod, limit);
+	case FastNoise::Simplex:
+		return vSingleSimplex(p, 0, x, y, z, w);
+	case FastNoise::SimplexFractal:
+		return vFractal(p, FastNoise::Simplex, x, y, z, w, lod, limit);
+	case FastNoise::Cellular:
+		switch (p.cellularReturnType)
+		{
+		case FastNoise::CellValue:
+		case FastNoise::NoiseLookup:
+		case FastNoise::Distance:
+			return vSingleCellular(p, x, y, z, w);
+		default:
+			return vSingleCellular2Edge(p, x, y, z, w);
+		}
+	case FastNoise::Cubic:
+		return vSingleCubic(p, 0, x, y, z, w);
+	case FastNoise::CubicFractal:
+		return vFractal(p, FastNoise::Cubic, x, y, z, w, lod, limit);
+	default:
+		return vSet(0);
+	}
+}
+
+// octaves, when given, holds a fractional octave limit per point
+FN_BATCH_TARGET static void GetNoiseBatch(const FastNoiseBatchParams& p, const float* x, const float* y, const float* z, float w, float* out, size_t n, const float* octaves)
+{
+	const vf vw = vSet(w);
+	const bool lod = octaves != nullptr;
+	const vf noLimit = vSet(FN_DECIMAL(p.octaves));
+	size_t i = 0;
+	for (; i + kLanes <= n; i += kLanes)
+		vStore(out + i, vGetNoise(p, vLoad(x + i), vLoad(y + i), vLoad(z + i), vw, lod, lod ? vLoad(octaves + i) : noLimit));
+
+	if (i < n)
+	{
+		// pad the tail out to a full vector
+		float tx[kLanes] = {}, ty[kLanes] = {}, tz[kLanes] = {}, to[kLanes];
+		float tl[kLanes] = {};
+		for (size_t j = 0; j < n - i; j++)
+		{
+			tx[j] = x[i + j];
+			ty[j] = y[i + j];
+			tz[j] = z[i + j];
+			if (lod)
+				tl[j] = octaves[i + j];
+		}
+		vStore(to, vGetNoise(p, vLoad(tx), vLoad(ty), vLoad(tz), vw, lod, vLoad(tl)));
+		for (size_t j = 0; j < n - i; j++)
+			out[i + j] = to[j];
+	}
+}
@@ -0,0 +1,376 @@
+// SPDX-License-Identifier: MIT
+//
+// ============================================================================
+//
+//  DeepGatherTableBench — throughput benchmark for DeepGatherTable.h
+//
+//  Copies synthetic deep pixels (1-64 samples each) of a 68 channel layout —
+//  rgba plus 64 AOV channels — through a GatherTable in three shapes of
+//  routing:
+//
+//    passthrough   every channel copies itself
+//    routed_64     64 channels shuffled at random, two of them set to the
+//                  constants 0 and 1, the way a big DeepCShuffle2 matrix is
+//    layer_swap    the 64 AOV channels swapped around as 16 whole layers of
+//                  four, so most reads are consecutive
+//
+//  and, for comparison, through the route-list search DeepCShuffle2 used to
+//  do for every output channel of every sample.
+//
+//  Reports samples and output bytes per second, either as a table or, with
+//  --json, as a JSON document for tracking regressions across releases.
+//
+//  --verify instead checks that both copies agree bit for bit.
+//
+//  Zero Nuke SDK dependencies.
+//
+// ============================================================================
+
+#include "DeepGatherTable.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <numeric>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+// rgba plus 64 AOV channels
+const int kChannels = 68;
+const int kRouted   = 64;
+
+volatile float g_sink = 0.0f;
+
+struct Options {
+    bool        json     = false;
+    bool        verify   = false;
+    int         pixels   = 20000;
+    double      minTime  = 0.25;
+    unsigned    seed     = 1;
+};
+
+struct Result {
+    std::string scenario;
+    std::string function;
+    size_t      pixels;
+    size_t      samples;     // samples per iteration
+    int         iterations;
+    double      seconds;     // total timed seconds
+    double      samplesPerSec;
+    double      bytesPerSec; // output bytes written
+};
+
+// ---------------------------------------------------------------------------
+// Routing
+// ---------------------------------------------------------------------------
+
+// one routed output channel, as DeepCShuffle2 kept them
+struct Route {
+    int   out;
+    int   in;        // -1 for a constant
+    float value;
+};
+
+typedef std::vector<Route> Routes;
+
+Routes makePassthrough(std::mt19937&)
+{
+    return Routes();
+}
+
+Routes makeRouted(std::mt19937& rng)
+{
+    std::vector<int> sources(kChannels);
+    std::iota(sources.begin(), sources.end(), 0);
+    std::shuffle(sources.begin(), sources.end(), rng);
+
+    std::vector<int> outputs(kChannels);
+    std::iota(outputs.begin(), outputs.end(), 0);
+    std::shuffle(outputs.begin(), outputs.end(), rng);
+
+    Routes routes;
+    for (int i = 0; i < kRouted; ++i) {
+        Route route = { outputs[i], sources[i], 0.0f };
+        if (i < 2) {
+            route.in = -1;
+            route.value = static_cast<float>(i);
+        }
+        routes.push_back(route);
+    }
+    return routes;
+}
+
+Routes makeLayerSwap(std::mt19937& rng)
+{
+    const int layers = kRouted / 4;
+    std::vector<int> order(layers);
+    std::iota(order.begin(), order.end(), 0);
+    std::shuffle(order.begin(), order.end(), rng);
+
+    Routes routes;
+    for (int layer = 0; layer < layers; ++layer)
+        for (int c = 0; c < 4; ++c) {
+            Route route = { 4 + layer * 4 + c, 4 + order[layer] * 4 + c, 0.0f };
+            routes.push_back(route);
+        }
+    return routes;
+}
+
+void compileTable(const Routes& routes, deepc::GatherTable& table)
+{
+    table.reset(kChannels, kChannels);
+    for (int slot = 0; slot < kChannels; ++slot)
+        table.read(slot, slot);
+    for (const Route& route : routes) {
+        if (route.in < 0)
+            table.constant(route.out, route.value);
+        else
+            table.read(route.out, route.in);
+    }
+    table.compile();
+}
+
+// the original engine: search the route list for every output channel of
+// every sample
+void legacyCopy(const Routes& routes, const float* in, float* out, size_t samples)
+{
+    for (size_t sample = 0; sample < samples; ++sample) {
+        const float* inData = in + sample * kChannels;
+        float* outData = out + sample * kChannels;
+        for (int z = 0; z < kChannels; ++z) {
+            float value = inData[z];
+            for (size_t r = 0; r < routes.size(); ++r) {
+                if (routes[r].out == z) {
+                    value = routes[r].in < 0 ? routes[r].value : inData[routes[r].in];
+                    break;
+                }
+            }
+            outData[z] = value;
+        }
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Synthetic pixels
+// ---------------------------------------------------------------------------
+
+struct Plane {
+    std::vector<size_t> start;   // first sample of each pixel
+    std::vector<size_t> count;   // samples in each pixel
+    std::vector<float>  data;    // kChannels floats per sample
+    size_t              samples = 0;
+};
+
+Plane makePlane(int pixels, unsigned seed)
+{
+    std::mt19937 rng(seed);
+    std::uniform_int_distribution<int> count(1, 64);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+    Plane plane;
+    for (int i = 0; i < pixels; ++i) {
+        plane.start.push_back(plane.samples);
+        plane.count.push_back(count(rng));
+        plane.samples += plane.count.back();
+    }
+    plane.data.resize(plane.samples * kChannels);
+    for (float& v : plane.data)
+        v = unit(rng);
+    return plane;
+}
+
+// ---------------------------------------------------------------------------
+// Timing
+// ---------------------------------------------------------------------------
+
+typedef std::chrono::steady_clock Clock;
+
+// Runs fn(in, out, samples) over every pixel of the plane until minTime has
+// been spent.
+template <class Fn>
+Result run(const char* scenario, const char* function, const Plane& plane,
+           std::vector<float>& out, const Options& opts, Fn fn)
+{
+    Result r;
+    r.scenario   = scenario;
+    r.function   = function;
+    r.pixels     = plane.start.size();
+    r.samples    = plane.samples;
+    r.iterations = 0;
+    r.seconds    = 0.0;
+
+    do {
+        const Clock::time_point start = Clock::now();
+        for (size_t px = 0; px < r.pixels; ++px) {
+            const size_t offset = plane.start[px] * kChannels;
+            fn(plane.data.data() + offset, out.data() + offset, plane.count[px]);
+        }
+        const Clock::time_point end = Clock::now();
+        g_sink = g_sink + out[r.iterations % out.size()];
+        r.seconds += std::chrono::duration<double>(end - start).count();
+        ++r.iterations;
+    } while (r.seconds < opts.minTime);
+
+    const double samples = static_cast<double>(r.samples) * r.iterations;
+    r.samplesPerSec = r.seconds > 0.0 ? samples / r.seconds : 0.0;
+    r.bytesPerSec   = r.samplesPerSec * kChannels * sizeof(float);
+    return r;
+}
+
+struct Scenario {
+    const char* name;
+    Routes (*generate)(std::mt19937&);
+};
+
+const Scenario kScenarios[] = {
+    { "passthrough", makePassthrough },
+    { "routed_64",   makeRouted },
+    { "layer_swap",  makeLayerSwap },
+};
+
+void benchScenario(const Scenario& sc, const Plane& plane, const Options& opts,
+                   std::vector<Result>& results)
+{
+    std::mt19937 rng(opts.seed);
+    const Routes routes = sc.generate(rng);
+    deepc::GatherTable table;
+    compileTable(routes, table);
+    std::vector<float> out(plane.data.size());
+
+    results.push_back(run(sc.name, "route_search", plane, out, opts,
+        [&routes](const float* in, float* o, size_t samples) {
+            legacyCopy(routes, in, o, samples);
+        }));
+
+    results.push_back(run(sc.name, "GatherTable", plane, out, opts,
+        [&table](const float* in, float* o, size_t samples) {
+            table.copySamples(in, o, samples);
+        }));
+}
+
+// ---------------------------------------------------------------------------
+// Verification
+// ---------------------------------------------------------------------------
+
+// GatherTable against the route search over every scenario; returns the
+// number of failing scenarios
+int verify(const Options& opts)
+{
+    const Plane plane = makePlane(opts.pixels, opts.seed);
+    int failures = 0;
+    for (const Scenario& sc : kScenarios) {
+        std::mt19937 rng(opts.seed);
+        const Routes routes = sc.generate(rng);
+        deepc::GatherTable table;
+        compileTable(routes, table);
+
+        std::vector<float> expected(plane.data.size());
+        std::vector<float> actual(plane.data.size());
+        for (size_t px = 0; px < plane.start.size(); ++px) {
+            const size_t offset = plane.start[px] * kChannels;
+            legacyCopy(routes, plane.data.data() + offset, expected.data() + offset, plane.count[px]);
+            table.copySamples(plane.data.data() + offset, actual.data() + offset, plane.count[px]);
+        }
+        const bool same = std::memcmp(expected.data(), actual.data(),
+                                      expected.size() * sizeof(float)) == 0;
+        std::printf("%-12s %6d pixels  %s%s\n", sc.name, opts.pixels,
+                    same ? "ok" : "FAIL",
+                    table.identity() ? " (identity)" : "");
+        failures += same ? 0 : 1;
+    }
+    return failures;
+}
+
+// ---------------------------------------------------------------------------
+// Output
+// ---------------------------------------------------------------------------
+
+void printTable(const std::vector<Result>& results)
+{
+    std::printf("%-12s %-14s %8s %10s %8s %14s %10s\n",
+                "scenario", "function", "pixels", "samples/px", "iters",
+                "Msamples/sec", "GB/sec");
+    for (const auto& r : results) {
+        std::printf("%-12s %-14s %8zu %10.1f %8d %14.2f %10.2f\n",
+                    r.scenario.c_str(), r.function.c_str(), r.pixels,
+                    static_cast<double>(r.samples) / r.pixels, r.iterations,
+                    r.samplesPerSec / 1e6, r.bytesPerSec / 1e9);
+    }
+}
+
+void printJson(const std::vector<Result>& results, const Options& opts)
+{
+    std::printf("{\n");
+    std::printf("  \"benchmark\": \"DeepGatherTable\",\n");
+    std::printf("  \"schema\": 1,\n");
+    std::printf("  \"options\": {\"pixels\": %d, \"min_time\": %g, \"seed\": %u, \"channels\": %d},\n",
+                opts.pixels, opts.minTime, opts.seed, kChannels);
+    std::printf("  \"results\": [\n");
+    for (size_t i = 0; i < results.size(); ++i) {
+        const Result& r = results[i];
+        std::printf("    {\"scenario\": \"%s\", \"function\": \"%s\", "
+                    "\"pixels\": %zu, \"samples\": %zu, \"iterations\": %d, "
+                    "\"seconds\": %.6f, \"samples_per_sec\": %.1f, "
+                    "\"bytes_per_sec\": %.1f}%s\n",
+                    r.scenario.c_str(), r.function.c_str(), r.pixels,
+                    r.samples, r.iterations, r.seconds, r.samplesPerSec,
+                    r.bytesPerSec, i + 1 < results.size() ? "," : "");
+    }
+    std::printf("  ]\n");
+    std::printf("}\n");
+}
+
+void usage(const char* argv0)
+{
+    std::fprintf(stderr,
+        "usage: %s [--json | --verify] [--pixels N] [--min-time SECONDS] [--seed N]\n",
+        argv0);
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    Options opts;
+    for (int i = 1; i < argc; ++i) {
+        const char* arg = argv[i];
+        const bool hasValue = i + 1 < argc;
+        if (std::strcmp(arg, "--json") == 0) {
+            opts.json = true;
+        } else if (std::strcmp(arg, "--verify") == 0) {
+            opts.verify = true;
+        } else if (std::strcmp(arg, "--pixels") == 0 && hasValue) {
+            opts.pixels = std::atoi(argv[++i]);
+        } else if (std::strcmp(arg, "--min-time") == 0 && hasValue) {
+            opts.minTime = std::atof(argv[++i]);
+        } else if (std::strcmp(arg, "--seed") == 0 && hasValue) {
+            opts.seed = static_cast<unsigned>(std::strtoul(argv[++i], nullptr, 10));
+        } else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    if (opts.pixels < 1) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    if (opts.verify)
+        return verify(opts) == 0 ? 0 : 1;
+
+    const Plane plane = makePlane(opts.pixels, opts.seed);
+    std::vector<Result> results;
+    for (const Scenario& sc : kScenarios)
+        benchScenario(sc, plane, opts, results);
+
+    if (opts.json)
+        printJson(results, opts);
+    else
+        printTable(results);
+    return 0;
+}
@@ -0,0 +1,488 @@
+// SPDX-License-Identifier: MIT
+//
+// ============================================================================
+//
+//  DeepSampleOptimizerBench — throughput benchmark for DeepSampleOptimizer.h
+//
+//  Generates synthetic deep pixels of four kinds and times optimizeSamples,
+//  tidyOverlapping (through both the vector API and SamplePool) and
+//  colorDistance over them:
+//
+//    hard_surface  1-4 thin, mostly opaque samples per pixel, no overlap
+//    volumetric    32-128 abutting low-alpha slabs per pixel
+//    overlap       2-4 thick volume samples with 16-64 point samples
+//                  scattered through them, so most samples need splitting
+//    volume_overlap  16-64 thick samples per pixel, heavily overlapping each
+//                  other (the shape of a blurred volume)
+//
+//  Reports input samples per second and heap allocations per pixel, either
+//  as a table or, with --json, as a JSON document for tracking regressions
+//  across releases.
+//
+//  --verify instead checks tidyOverlapping against the original restart-scan
+//  implementation (LegacyDeepSampleOptimizer.h) for bit-identical output,
+//  and that no overlaps survive in pixels the original could not handle.
+//
+//  Zero Nuke SDK dependencies.
+//
+// ============================================================================
+
+#include "DeepSampleOptimizer.h"
+#include "LegacyDeepSampleOptimizer.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <random>
+#include <string>
+#include <vector>
+
+// ---------------------------------------------------------------------------
+// Allocation counting — every global operator new goes through here
+// ---------------------------------------------------------------------------
+static size_t g_allocations = 0;
+
+void* operator new(std::size_t size)
+{
+    ++g_allocations;
+    void* p = std::malloc(size ? size : 1);
+    if (!p)
+        throw std::bad_alloc();
+    return p;
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+
+namespace {
+
+typedef std::vector<deepc::SampleRecord> Pixel;
+
+// DeepCBlur2 defaults
+const float kMergeTolerance = 0.001f;
+const float kColorTolerance = 0.01f;
+const int   kMaxSamples     = 100;
+
+// r, g, b, a, deep.front, deep.back — the usual channel set of a deep plate
+const int kChannels = 6;
+
+volatile float g_sink = 0.0f;
+
+struct Options {
+    bool        json     = false;
+    bool        verify   = false;
+    int         pixels   = 2000;
+    double      minTime  = 0.25;
+    unsigned    seed     = 1;
+};
+
+struct Result {
+    std::string scenario;
+    std::string function;
+    size_t      pixels;
+    size_t      samples;     // input samples per iteration
+    int         iterations;
+    double      seconds;     // total timed seconds
+    double      samplesPerSec;
+    double      allocsPerPixel;
+};
+
+// ---------------------------------------------------------------------------
+// Synthetic pixels
+// ---------------------------------------------------------------------------
+
+deepc::SampleRecord makeSample(float zFront, float zBack, float alpha,
+                               float r, float g, float b)
+{
+    deepc::SampleRecord s;
+    s.zFront = zFront;
+    s.zBack  = zBack;
+    s.alpha  = alpha;
+    s.channels.resize(kChannels);
+    s.channels[0] = r * alpha;
+    s.channels[1] = g * alpha;
+    s.channels[2] = b * alpha;
+    s.channels[3] = alpha;
+    s.channels[4] = zFront;
+    s.channels[5] = zBack;
+    return s;
+}
+
+void makeHardSurface(std::mt19937& rng, Pixel& px)
+{
+    std::uniform_int_distribution<int> count(1, 4);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    float z = 1.0f + 10.0f * unit(rng);
+    const int n = count(rng);
+    for (int i = 0; i < n; ++i) {
+        // the first hit is opaque, anything behind it an antialiased edge
+        const float alpha = i == 0 ? 1.0f : 0.2f + 0.8f * unit(rng);
+        const float thickness = unit(rng) < 0.5f ? 0.0f : 0.001f;
+        px.push_back(makeSample(z, z + thickness, alpha,
+                                unit(rng), unit(rng), unit(rng)));
+        z += 0.5f + 5.0f * unit(rng);
+    }
+}
+
+void makeVolumetric(std::mt19937& rng, Pixel& px)
+{
+    std::uniform_int_distribution<int> count(32, 128);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    const int n = count(rng);
+    const float dz = 0.0005f + 0.002f * unit(rng);
+    float z = 5.0f + 5.0f * unit(rng);
+    float r = unit(rng), g = unit(rng), b = unit(rng);
+    for (int i = 0; i < n; ++i) {
+        // slowly drifting colour, so some neighbours merge and some don't
+        r += 0.01f * (unit(rng) - 0.5f);
+        g += 0.01f * (unit(rng) - 0.5f);
+        b += 0.01f * (unit(rng) - 0.5f);
+        px.push_back(makeSample(z, z + dz, 0.02f + 0.06f * unit(rng), r, g, b));
+        z += dz;
+    }
+}
+
+void makeOverlap(std::mt19937& rng, Pixel& px)
+{
+    std::uniform_int_distribution<int> volumes(2, 4);
+    std::uniform_int_distribution<int> points(16, 64);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+    // a few thick, abutting volume samples...
+    const float zStart = 5.0f + 5.0f * unit(rng);
+    float z = zStart;
+    const int nVolumes = volumes(rng);
+    for (int i = 0; i < nVolumes; ++i) {
+        const float depth = 0.5f + 1.5f * unit(rng);
+        px.push_back(makeSample(z, z + depth, 0.1f + 0.4f * unit(rng),
+                                unit(rng), unit(rng), unit(rng)));
+        z += depth;
+    }
+
+    // ...with many point samples scattered through them
+    const int nPoints = points(rng);
+    for (int i = 0; i < nPoints; ++i) {
+        const float zp = zStart + (z - zStart) * unit(rng);
+        px.push_back(makeSample(zp, zp, 0.05f + 0.3f * unit(rng),
+                                unit(rng), unit(rng), unit(rng)));
+    }
+}
+
+void makeVolumeOverlap(std::mt19937& rng, Pixel& px)
+{
+    std::uniform_int_distribution<int> count(16, 64);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    const int n = count(rng);
+    const float z0 = 5.0f + 5.0f * unit(rng);
+    for (int i = 0; i < n; ++i) {
+        const float zFront = z0 + 2.0f * unit(rng);
+        const float zBack  = zFront + 0.2f + 0.8f * unit(rng);
+        px.push_back(makeSample(zFront, zBack, 0.05f + 0.3f * unit(rng),
+                                unit(rng), unit(rng), unit(rng)));
+    }
+}
+
+std::vector<Pixel> makePixels(void (*generate)(std::mt19937&, Pixel&),
+                              int count, unsigned seed)
+{
+    std::mt19937 rng(seed);
+    std::vector<Pixel> pixels(count);
+    for (auto& px : pixels)
+        generate(rng, px);
+    return pixels;
+}
+
+size_t countSamples(const std::vector<Pixel>& pixels)
+{
+    size_t n = 0;
+    for (const auto& px : pixels)
+        n += px.size();
+    return n;
+}
+
+// ---------------------------------------------------------------------------
+// Timing
+// ---------------------------------------------------------------------------
+
+typedef std::chrono::steady_clock Clock;
+
+// Runs fn over fresh copies of the source pixels until minTime has been
+// spent inside fn. Copying the pixels is neither timed nor counted.
+template <class Fn>
+Result run(const char* scenario, const char* function,
+           const std::vector<Pixel>& source, size_t samples,
+           const Options& opts, Fn fn)
+{
+    Result r;
+    r.scenario   = scenario;
+    r.function   = function;
+    r.pixels     = source.size();
+    r.samples    = samples;
+    r.iterations = 0;
+    r.seconds    = 0.0;
+
+    size_t allocations = 0;
+    std::vector<Pixel> work;
+    do {
+        work = source;
+        const size_t allocBefore = g_allocations;
+        const Clock::time_point start = Clock::now();
+        for (auto& px : work)
+            fn(px);
+        const Clock::time_point end = Clock::now();
+        allocations += g_allocations - allocBefore;
+        r.seconds += std::chrono::duration<double>(end - start).count();
+        ++r.iterations;
+    } while (r.seconds < opts.minTime);
+
+    r.samplesPerSec  = r.seconds > 0.0
+                     ? static_cast<double>(samples) * r.iterations / r.seconds
+                     : 0.0;
+    r.allocsPerPixel = static_cast<double>(allocations)
+                     / (static_cast<double>(r.pixels) * r.iterations);
+    return r;
+}
+
+void benchScenario(const char* scenario,
+                   void (*generate)(std::mt19937&, Pixel&),
+                   const Options& opts, std::vector<Result>& results)
+{
+    const std::vector<Pixel> pixels = makePixels(generate, opts.pixels, opts.seed);
+    const size_t samples = countSamples(pixels);
+
+    results.push_back(run(scenario, "optimizeSamples", pixels, samples, opts,
+        [](Pixel& px) {
+            deepc::optimizeSamples(px, kMergeTolerance, kColorTolerance, kMaxSamples);
+        }));
+
+    results.push_back(run(scenario, "tidyOverlapping", pixels, samples, opts,
+        [](Pixel& px) {
+            deepc::tidyOverlapping(px);
+        }));
+
+    // the pooled layout the blur nodes gather into directly
+    results.push_back(run(scenario, "optimizeSamples/pool", pixels, samples, opts,
+        [](Pixel& px) {
+            static deepc::SamplePool pool;
+            deepc::toPool(px, pool);
+            deepc::optimizeSamples(pool, kMergeTolerance, kColorTolerance, kMaxSamples);
+        }));
+
+    results.push_back(run(scenario, "tidyOverlapping/pool", pixels, samples, opts,
+        [](Pixel& px) {
+            static deepc::SamplePool pool;
+            deepc::toPool(px, pool);
+            deepc::tidyOverlapping(pool);
+        }));
+
+    // colorDistance between every pair of neighbouring samples
+    results.push_back(run(scenario, "colorDistance", pixels, samples, opts,
+        [](Pixel& px) {
+            float sum = 0.0f;
+            for (size_t i = 1; i < px.size(); ++i)
+                sum += deepc::colorDistance(px[i - 1].channels, px[i - 1].alpha,
+                                            px[i].channels, px[i].alpha);
+            g_sink = g_sink + sum;
+        }));
+}
+
+// ---------------------------------------------------------------------------
+// Verification
+// ---------------------------------------------------------------------------
+
+bool sameBits(float a, float b)
+{
+    return std::memcmp(&a, &b, sizeof(float)) == 0;
+}
+
+bool samePixel(const Pixel& a, const Pixel& b)
+{
+    if (a.size() != b.size())
+        return false;
+    for (size_t i = 0; i < a.size(); ++i) {
+        if (!sameBits(a[i].zFront, b[i].zFront) ||
+            !sameBits(a[i].zBack, b[i].zBack) ||
+            !sameBits(a[i].alpha, b[i].alpha) ||
+            a[i].channels.size() != b[i].channels.size())
+            return false;
+        for (size_t c = 0; c < a[i].channels.size(); ++c)
+            if (!sameBits(a[i].channels[c], b[i].channels[c]))
+                return false;
+    }
+    return true;
+}
+
+// true if two input samples share an identical [zFront, zBack]. The
+// original composites those in whatever order std::sort leaves them, so
+// there is no single right answer to compare against.
+bool hasCoincident(const Pixel& px)
+{
+    for (size_t i = 0; i < px.size(); ++i)
+        for (size_t j = i + 1; j < px.size(); ++j)
+            if (px[i].zFront == px[j].zFront && px[i].zBack == px[j].zBack)
+                return true;
+    return false;
+}
+
+// true if no sample's open interval (zFront, zBack) contains any depth
+// another sample starts or ends at, i.e. nothing is left to split
+bool fullyTidy(const Pixel& px)
+{
+    for (size_t i = 0; i < px.size(); ++i)
+        for (size_t j = 0; j < px.size(); ++j) {
+            if (i == j)
+                continue;
+            const float zf = px[j].zFront, zb = px[j].zBack;
+            if ((zf > px[i].zFront && zf < px[i].zBack) ||
+                (zb > px[i].zFront && zb < px[i].zBack))
+                return false;
+        }
+    return true;
+}
+
+// tidyOverlapping against the original over every scenario it terminates
+// on; returns the number of failing pixels
+int verify(const Options& opts)
+{
+    struct Scenario {
+        const char* name;
+        void (*generate)(std::mt19937&, Pixel&);
+    };
+    const Scenario legacyScenarios[] = {
+        { "hard_surface", makeHardSurface },
+        { "volumetric",   makeVolumetric },
+        { "overlap",      makeOverlap },
+    };
+
+    int failures = 0;
+    for (const Scenario& sc : legacyScenarios) {
+        const std::vector<Pixel> pixels = makePixels(sc.generate, opts.pixels, opts.seed);
+        int mismatches = 0;
+        int skipped = 0;
+        for (const Pixel& px : pixels) {
+            if (hasCoincident(px)) {
+                ++skipped;
+                continue;
+            }
+            Pixel expected = px;
+            Pixel actual   = px;
+            deepc_legacy::tidyOverlapping(expected);
+            deepc::tidyOverlapping(actual);
+            if (!samePixel(expected, actual))
+                ++mismatches;
+        }
+        std::printf("%-14s %6d pixels  %s (%d mismatches against legacy, "
+                    "%d with coincident samples skipped)\n",
+                    sc.name, opts.pixels, mismatches ? "FAIL" : "ok",
+                    mismatches, skipped);
+        failures += mismatches;
+    }
+
+    // the original never terminates on these, so check the result instead
+    {
+        const std::vector<Pixel> pixels = makePixels(makeVolumeOverlap, opts.pixels, opts.seed);
+        int untidy = 0;
+        for (const Pixel& px : pixels) {
+            Pixel actual = px;
+            deepc::tidyOverlapping(actual);
+            if (!fullyTidy(actual))
+                ++untidy;
+        }
+        std::printf("%-14s %6d pixels  %s (%d with overlaps left)\n",
+                    "volume_overlap", opts.pixels, untidy ? "FAIL" : "ok", untidy);
+        failures += untidy;
+    }
+    return failures;
+}
+
+// ---------------------------------------------------------------------------
+// Output
+// ---------------------------------------------------------------------------
+
+void printTable(const std::vector<Result>& results)
+{
+    std::printf("%-16s %-22s %8s %10s %8s %14s %10s\n",
+                "scenario", "function", "pixels", "samples/px", "iters",
+                "Msamples/sec", "allocs/px");
+    for (const auto& r : results) {
+        std::printf("%-16s %-22s %8zu %10.1f %8d %14.2f %10.2f\n",
+                    r.scenario.c_str(), r.function.c_str(), r.pixels,
+                    static_cast<double>(r.samples) / r.pixels, r.iterations,
+                    r.samplesPerSec / 1e6, r.allocsPerPixel);
+    }
+}
+
+void printJson(const std::vector<Result>& results, const Options& opts)
+{
+    std::printf("{\n");
+    std::printf("  \"benchmark\": \"DeepSampleOptimizer\",\n");
+    std::printf("  \"schema\": 1,\n");
+    std::printf("  \"options\": {\"pixels\": %d, \"min_time\": %g, \"seed\": %u},\n",
+                opts.pixels, opts.minTime, opts.seed);
+    std::printf("  \"results\": [\n");
+    for (size_t i = 0; i < results.size(); ++i) {
+        const Result& r = results[i];
+        std::printf("    {\"scenario\": \"%s\", \"function\": \"%s\", "
+                    "\"pixels\": %zu, \"samples\": %zu, \"iterations\": %d, "
+                    "\"seconds\": %.6f, \"samples_per_sec\": %.1f, "
+                    "\"allocs_per_pixel\": %.3f}%s\n",
+                    r.scenario.c_str(), r.function.c_str(), r.pixels,
+                    r.samples, r.iterations, r.seconds, r.samplesPerSec,
+                    r.allocsPerPixel, i + 1 < results.size() ? "," : "");
+    }
+    std::printf("  ]\n");
+    std::printf("}\n");
+}
+
+void usage(const char* argv0)
+{
+    std::fprintf(stderr,
+        "usage: %s [--json | --verify] [--pixels N] [--min-time SECONDS] [--seed N]\n",
+        argv0);
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    Options opts;
+    for (int i = 1; i < argc; ++i) {
+        const char* arg = argv[i];
+        const bool hasValue = i + 1 < argc;
+        if (std::strcmp(arg, "--json") == 0) {
+            opts.json = true;
+        } else if (std::strcmp(arg, "--verify") == 0) {
+            opts.verify = true;
+        } else if (std::strcmp(arg, "--pixels") == 0 && hasValue) {
+            opts.pixels = std::atoi(argv[++i]);
+        } else if (std::strcmp(arg, "--min-time") == 0 && hasValue) {
+            opts.minTime = std::atof(argv[++i]);
+        } else if (std::strcmp(arg, "--seed") == 0 && hasValue) {
+            opts.seed = static_cast<unsigned>(std::strtoul(argv[++i], nullptr, 10));
+        } else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    if (opts.pixels < 1) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    if (opts.verify)
+        return verify(opts) == 0 ? 0 : 1;
+
+    std::vector<Result> results;
+    benchScenario("hard_surface",   makeHardSurface,   opts, results);
+    benchScenario("volumetric",     makeVolumetric,    opts, results);
+    benchScenario("overlap",        makeOverlap,       opts, results);
+    benchScenario("volume_overlap", makeVolumeOverlap, opts, results);
+
+    if (opts.json)
+        printJson(results, opts);
+    else
+        printTable(results);
+    return 0;
+}
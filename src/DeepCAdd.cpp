@@ -1,4 +1,5 @@
 #include "DeepCWrapper.h"
+#include "DeepCSimd.h"
 
 using namespace DD::Image;
 
@@ -25,6 +26,8 @@ class DeepCAdd : public DeepCWrapper
             Vector3& sampleColor
             );
 
+        virtual void wrappedPerBatch(DeepCSampleBatch& batch);
+
         virtual void custom_knobs(Knob_Callback f);
 
         static const Iop::Description d;
@@ -52,6 +55,20 @@ void DeepCAdd::wrappedPerChannel(
 }
 
 
+/*
+Batched version of wrappedPerChannel, working on a whole row of samples at
+once.
+*/
+void DeepCAdd::wrappedPerBatch(DeepCSampleBatch& batch)
+{
+    for (int lane = 0; lane < batch.lanes(); lane++)
+    {
+        const float v = value[batch.colourIndex(lane)];
+        deepc::simd::affine(batch.in(lane), batch.out(lane), batch.size(), 1.0f, v);
+    }
+}
+
+
 void DeepCAdd::custom_knobs(Knob_Callback f)
 {
     Color_knob(f, value, IRange(0, 5), "value", "value");
@@ -7,6 +7,8 @@ Falk Hofmann, 11/2021
 #include "DDImage/DeepFilterOp.h"
 #include "DDImage/Knobs.h"
 
+#include "DeepCCropPlane.h"
+
 static const char* CLASS = "DeepCAdjustBBox";
 
 using namespace DD::Image;
@@ -63,66 +65,10 @@ public:
     DeepOp* in = input0();
     DeepPlane inPlane;
 
-    ChannelSet needed = channels;
-    needed += Mask_DeepFront;
-
-    if (!in->deepEngine(box, needed, inPlane))
+    if (!in->deepEngine(box, channels, inPlane))
       return false;
 
-    DeepInPlaceOutputPlane outPlane(channels, box);
-    outPlane.reserveSamples(inPlane.getTotalSampleCount());
-
-    //samples per pixel after croping
-    std::vector<int> validSamples;
-
-    for (DD::Image::Box::iterator it = box.begin(), itEnd = box.end(); it != itEnd; ++it) {
-
-      const int x = it.x;
-      const int y = it.y;
-
-      bool inXY = (x >= _bbox[0] && x < _bbox[2] && y >= _bbox[1] && y < _bbox[3]);
-
-      if (!inXY) {
-        // pixel out of crop bounds
-        outPlane.setSampleCount(y, x, 0);
-        continue;
-      }
-
-      DeepPixel inPixel = inPlane.getPixel(it);
-      size_t inPixelSamples = inPixel.getSampleCount();
-
-      validSamples.clear();
-      validSamples.reserve(inPixelSamples);
-
-      // find valid samples
-      for (size_t iSample = 0; iSample < inPixelSamples; ++iSample) {
-
-        validSamples.push_back(iSample);
-      }
-
-      outPlane.setSampleCount(it, validSamples.size());
-
-      DeepOutputPixel outPixel = outPlane.getPixel(it);
-
-      // copy valid samples to DeepOutputPlane
-      size_t outSample = 0;
-      for (size_t inSample : validSamples)
-      {
-        const float* inData = inPixel.getUnorderedSample(inSample);
-        float* outData = outPixel.getWritableUnorderedSample(outSample);
-        for ( int iChannel = 0, nChannels = channels.size();
-              iChannel < nChannels;
-              ++iChannel, ++outData, ++inData
-              ) {
-          *outData = *inData;
-        }
-        ++outSample;
-      }
-    }
-
-    outPlane.reviseSamples();
-    mFnAssert(outPlane.isComplete());
-    plane = outPlane;
+    deepc::cropPlane(inPlane, box, channels, _bbox, plane);
 
     return true;
   }
@@ -16,10 +16,16 @@
 #include "DDImage/DeepPlane.h"
 #include "DDImage/Knobs.h"
 
+#include "DeepCWorkerPool.h"
+#include "DeepLayerBlur.h"
 #include "DeepSampleOptimizer.h"
 
 #include <algorithm>
+#include <atomic>
 #include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <functional>
 #include <vector>
 
 using namespace DD::Image;
@@ -35,33 +41,93 @@ static const char* const HELP =
     "blur_width / blur_height control the pixel radius of the kernel in each "
     "direction (sigma = radius / 3). Values above 10 will be slow due to "
     "large kernel footprints.\n\n"
+    "mode — Propagate samples (default) carries every source sample into each "
+    "neighbour. Depth sliced flattens each tile into a few depth layers "
+    "placed from a depth histogram, blurs them as flat images and emits at "
+    "most one sample per layer per pixel: bounded output and predictable "
+    "memory for large blurs, at the cost of depth detail.\n\n"
+    "threads — Very large tiles are split by rows between the engine thread "
+    "and helpers from a pool shared by all nodes (0 = one helper). Nuke "
+    "already renders a tile per core, so more only pays off when a few "
+    "tiles dominate a render. The DEEPC_BLUR_THREADS environment variable "
+    "caps the count for every DeepCBlur, e.g. on shared render nodes.\n\n"
     "Part of the DeepC plugin collection.";
 
+// ---------------------------------------------------------------------------
+// Blur mode names for Enumeration_knob
+// ---------------------------------------------------------------------------
+static const char* const modeNames[] = { "Propagate samples", "Depth sliced", nullptr };
+
+enum BlurMode {
+    MODE_PROPAGATE = 0,
+    MODE_DEPTH_SLICED
+};
+
 // ---------------------------------------------------------------------------
 class DeepCBlur : public DeepFilterOp
 {
     float _blurWidth;       // pixel radius in X
     float _blurHeight;      // pixel radius in Y
+    int   _mode;            // BlurMode
+    int   _depthLayers;     // depth layers of the depth-sliced mode
+    int   _threads;         // threads per tile, engine thread included (0 = 2)
     int   _maxSamples;      // per-pixel sample cap (0 = unlimited)
     float _mergeTolerance;  // Z-front distance for sample merge
     float _colorTolerance;  // channel-value distance for sample merge
 
     // Thread-local scratch buffers for zero-allocation hot path
     struct ScratchBuf {
-        std::vector<deepc::SampleRecord> samples;
+        deepc::SamplePool                 samples;
         DeepOutPixel                      outPixel;
         std::vector<float>                kernel;
     };
 
+    // Finished output rows of one tile, kept until they are stitched into
+    // the output plane in order. A pixel with 0 samples is a hole.
+    struct RowOutput {
+        std::vector<float> data;
+        std::vector<int>   sampleCounts;
+    };
+
     // Compute kernel radius from blur parameter (blur = 3-sigma radius)
     static int kernelRadius(float blur) {
         return std::max(0, static_cast<int>(std::ceil(blur)));
     }
 
+    static ScratchBuf& threadScratch()
+    {
+        static thread_local ScratchBuf scratch;
+        return scratch;
+    }
+
+    // Tiles with fewer kernel taps than this are not worth sharing: the
+    // other cores are normally busy with tiles of their own
+    static constexpr int64_t kMinParallelWork = int64_t(1) << 22;
+
+    // Threads for a tile of `rows` rows costing `work` kernel taps, this
+    // one included: the threads knob (0 = this thread and one helper),
+    // capped by DEEPC_BLUR_THREADS
+    int workerCount(int rows, int64_t work) const
+    {
+        if (rows < 2 || work < kMinParallelWork)
+            return 1;
+
+        int count = _threads > 0 ? _threads : 2;
+        if (const char* env = std::getenv("DEEPC_BLUR_THREADS")) {
+            const int cap = std::atoi(env);
+            if (cap > 0)
+                count = std::min(count, cap);
+        }
+        return std::max(1, std::min(count, rows));
+    }
+
 public:
     DeepCBlur(Node* node) : DeepFilterOp(node),
         _blurWidth(1.0f),
         _blurHeight(1.0f),
+        _mode(MODE_PROPAGATE),
+        _depthLayers(16),
+        _threads(0),
         _maxSamples(100),
         _mergeTolerance(0.001f),
         _colorTolerance(0.01f)
@@ -86,6 +152,26 @@ public:
         Tooltip(f, "Vertical blur radius in pixels (sigma = radius / 3). "
                     "Values above 10 will be slow.");
 
+        Enumeration_knob(f, &_mode, modeNames, "mode", "mode");
+        Tooltip(f, "Propagate samples carries every source sample into each "
+                    "neighbour. Depth sliced blurs a few flattened depth layers "
+                    "instead, emitting at most one sample per layer per pixel.");
+
+        Int_knob(f, &_depthLayers, "depth_layers", "depth layers");
+        SetRange(f, 1, 64);
+        Tooltip(f, "Depth sliced only: number of depth layers the samples of each "
+                    "tile are flattened into, placed so each holds a similar "
+                    "share of the samples.");
+
+        Int_knob(f, &_threads, "threads", "threads");
+        SetRange(f, 0, 64);
+        Tooltip(f, "Threads per tile for sample propagation, the engine thread "
+                    "included; helpers come from a pool shared by all nodes and "
+                    "rows are handed out dynamically so fast rows don't wait on "
+                    "slow ones. 0 = the engine thread plus one helper. Only very "
+                    "large tiles are split. The DEEPC_BLUR_THREADS environment "
+                    "variable caps this value.");
+
         Int_knob(f, &_maxSamples, "max_samples", "max samples");
         SetRange(f, 0, 500);
         Tooltip(f, "Maximum samples per output pixel after optimization. "
@@ -102,6 +188,19 @@ public:
                     "0 = merge by Z only.");
     }
 
+    // depth layers only apply to the depth-sliced mode, threads only to
+    // sample propagation
+    int knob_changed(Knob* k) override
+    {
+        if (k->is("mode") || k == &Knob::showPanel) {
+            knob("depth_layers")->enable(_mode == MODE_DEPTH_SLICED);
+            knob("threads")->enable(_mode == MODE_PROPAGATE);
+            if (k->is("mode"))
+                return 1;
+        }
+        return DeepFilterOp::knob_changed(k);
+    }
+
     // ------------------------------------------------------------------
     // _validate — expand bounding box by kernel radius
     // ------------------------------------------------------------------
@@ -200,7 +299,7 @@ public:
         const int kernelW = 2 * radX + 1;
         const int kernelH = 2 * radY + 1;
 
-        static thread_local ScratchBuf scratch;
+        ScratchBuf& scratch = threadScratch();
         scratch.kernel.resize(kernelW * kernelH);
 
         float kernelSum = 0.0f;
@@ -238,96 +337,273 @@ public:
         // Output plane
         plane = DeepOutputPlane(channels, box, DeepPixel::eUnordered);
 
-        const Box& inBox = inPlane.box();
+        if (_mode == MODE_DEPTH_SLICED)
+            return depthSliced(box, inputBox, inPlane, channels, sigmaX, sigmaY,
+                               radX, radY, plane);
+
+        const int rows = box.t() - box.y();
+        const int64_t work = static_cast<int64_t>(rows) * (box.r() - box.x())
+                           * kernelW * kernelH;
+        const int workers = workerCount(rows, work);
+        if (workers > 1)
+            return propagateParallel(box, inPlane, channels, isDepthChan,
+                                     scratch.kernel, radX, radY, workers, plane);
 
         for (Box::iterator it = box.begin(); it != box.end(); ++it) {
             if (Op::aborted())
                 return false;
 
-            const int outX = it.x;
-            const int outY = it.y;
+            gatherPixel(scratch, inPlane, channels, isDepthChan, scratch.kernel,
+                        radX, radY, it.x, it.y);
+            emitPixel(scratch, channels, plane);
+        }
 
-            scratch.samples.clear();
+        return true;
+    }
 
-            // Accumulate weighted samples from kernel neighbourhood
-            for (int dy = -radY; dy <= radY; ++dy) {
-                const int srcY = outY + dy;
-                if (srcY < inBox.y() || srcY >= inBox.t())
+private:
+    // ------------------------------------------------------------------
+    // gatherPixel — accumulate the weighted kernel neighbourhood of one
+    // output pixel into scratch.samples
+    // ------------------------------------------------------------------
+    static void gatherPixel(ScratchBuf& scratch, const DeepPlane& inPlane,
+                            const ChannelSet& channels,
+                            const std::vector<bool>& isDepthChan,
+                            const std::vector<float>& kernel,
+                            int radX, int radY, int outX, int outY)
+    {
+        const int nChans = channels.size();
+        const int kernelW = 2 * radX + 1;
+        const Box& inBox = inPlane.box();
+
+        scratch.samples.reset(nChans);
+
+        // Accumulate weighted samples from kernel neighbourhood
+        for (int dy = -radY; dy <= radY; ++dy) {
+            const int srcY = outY + dy;
+            if (srcY < inBox.y() || srcY >= inBox.t())
+                continue;
+
+            for (int dx = -radX; dx <= radX; ++dx) {
+                const int srcX = outX + dx;
+                if (srcX < inBox.x() || srcX >= inBox.r())
                     continue;
 
-                for (int dx = -radX; dx <= radX; ++dx) {
-                    const int srcX = outX + dx;
-                    if (srcX < inBox.x() || srcX >= inBox.r())
-                        continue;
-
-                    DeepPixel srcPixel = inPlane.getPixel(srcY, srcX);
-                    const int srcSamples = static_cast<int>(srcPixel.getSampleCount());
-                    if (srcSamples == 0)
-                        continue;
-
-                    const float weight = scratch.kernel[(dy + radY) * kernelW + (dx + radX)];
-                    if (weight <= 0.0f)
-                        continue;
-
-                    for (int s = 0; s < srcSamples; ++s) {
-                        deepc::SampleRecord rec;
-                        rec.zFront = srcPixel.getUnorderedSample(s, Chan_DeepFront);
-                        rec.zBack  = srcPixel.getUnorderedSample(s, Chan_DeepBack);
-                        rec.alpha  = srcPixel.getUnorderedSample(s, Chan_Alpha) * weight;
-
-                        // Collect data channels (non-depth) weighted, depth raw
-                        rec.channels.resize(nChans);
-                        int ci = 0;
-                        foreach(z, channels) {
-                            if (isDepthChan[ci]) {
-                                // Depth propagated from source — NOT weighted
-                                rec.channels[ci] = srcPixel.getUnorderedSample(s, z);
-                            } else {
-                                rec.channels[ci] = srcPixel.getUnorderedSample(s, z) * weight;
-                            }
-                            ci++;
-                        }
+                DeepPixel srcPixel = inPlane.getPixel(srcY, srcX);
+                const int srcSamples = static_cast<int>(srcPixel.getSampleCount());
+                if (srcSamples == 0)
+                    continue;
 
-                        scratch.samples.push_back(std::move(rec));
+                const float weight = kernel[(dy + radY) * kernelW + (dx + radX)];
+                if (weight <= 0.0f)
+                    continue;
+
+                for (int s = 0; s < srcSamples; ++s) {
+                    float* rec = scratch.samples.add(
+                        srcPixel.getUnorderedSample(s, Chan_DeepFront),
+                        srcPixel.getUnorderedSample(s, Chan_DeepBack),
+                        srcPixel.getUnorderedSample(s, Chan_Alpha) * weight);
+
+                    // Collect data channels (non-depth) weighted, depth raw
+                    int ci = 0;
+                    foreach(z, channels) {
+                        if (isDepthChan[ci]) {
+                            // Depth propagated from source — NOT weighted
+                            rec[ci] = srcPixel.getUnorderedSample(s, z);
+                        } else {
+                            rec[ci] = srcPixel.getUnorderedSample(s, z) * weight;
+                        }
+                        ci++;
                     }
                 }
             }
+        }
+    }
 
-            // Empty pixel → hole
-            if (scratch.samples.empty()) {
-                plane.addHole();
-                continue;
-            }
+    // ------------------------------------------------------------------
+    // propagateParallel — sample propagation split by rows across threads
+    //
+    // Workers (this thread and helpers from the shared pool) take the next
+    // unclaimed output row from a shared counter, so expensive rows don't
+    // hold up the rest, and write it to their own RowOutput with their own
+    // thread-local scratch. The rows are then stitched into the plane in
+    // order.
+    // ------------------------------------------------------------------
+    bool propagateParallel(const Box& box, const DeepPlane& inPlane,
+                           const ChannelSet& channels,
+                           const std::vector<bool>& isDepthChan,
+                           const std::vector<float>& kernel,
+                           int radX, int radY, int workers,
+                           DeepOutputPlane& plane)
+    {
+        const int rows = box.t() - box.y();
+        std::vector<RowOutput> rowOutputs(rows);
+        std::atomic<int>  nextRow(0);
+        std::atomic<bool> aborted(false);
+
+        const std::function<void()> work = [&]() {
+            ScratchBuf& scratch = threadScratch();
+            for (;;) {
+                const int r = nextRow.fetch_add(1, std::memory_order_relaxed);
+                if (r >= rows)
+                    return;
+                if (Op::aborted()) {
+                    aborted.store(true, std::memory_order_relaxed);
+                    return;
+                }
 
-            // Per-pixel sample optimization
-            deepc::optimizeSamples(scratch.samples,
-                                   _mergeTolerance,
-                                   _colorTolerance,
-                                   _maxSamples);
-
-            // Emit output samples
-            scratch.outPixel.clear();
-            scratch.outPixel.reserve(static_cast<int>(scratch.samples.size()) * nChans);
-
-            for (const auto& sr : scratch.samples) {
-                int ci = 0;
-                foreach(z, channels) {
-                    if (z == Chan_DeepFront)
-                        scratch.outPixel.push_back(sr.zFront);
-                    else if (z == Chan_DeepBack)
-                        scratch.outPixel.push_back(sr.zBack);
+                RowOutput& out = rowOutputs[r];
+                out.sampleCounts.reserve(box.r() - box.x());
+                for (int x = box.x(); x < box.r(); ++x) {
+                    gatherPixel(scratch, inPlane, channels, isDepthChan, kernel,
+                                radX, radY, x, box.y() + r);
+                    if (finishPixel(scratch, channels, out.data))
+                        out.sampleCounts.push_back(static_cast<int>(scratch.samples.size()));
                     else
-                        scratch.outPixel.push_back(sr.channels[ci]);
-                    ci++;
+                        out.sampleCounts.push_back(0);
+                }
+            }
+        };
+
+        deepc::WorkerPool::shared().run(workers - 1, work);
+
+        if (aborted.load(std::memory_order_relaxed))
+            return false;
+
+        // Stitch rows in Box::iterator order
+        const int nChans = channels.size();
+        DeepOutPixel& outPixel = threadScratch().outPixel;
+        for (const RowOutput& out : rowOutputs) {
+            const float* data = out.data.data();
+            for (int count : out.sampleCounts) {
+                if (count == 0) {
+                    plane.addHole();
+                    continue;
                 }
+                outPixel.clear();
+                for (int i = 0; i < count * nChans; ++i)
+                    outPixel.push_back(data[i]);
+                data += count * nChans;
+                plane.addPixel(outPixel);
             }
+        }
+
+        return true;
+    }
+
+    // ------------------------------------------------------------------
+    // depthSliced — blur flattened depth layers instead of samples
+    //
+    // The padded input is flattened by deepc::LayeredBlur into up to
+    // _depthLayers dense layers placed from a depth histogram of the tile;
+    // each layer is blurred as a flat image with the separable Gaussian
+    // (the 2D kernel above is its outer product) and read back as at most
+    // one sample per layer.
+    // ------------------------------------------------------------------
+    bool depthSliced(const Box& box, const Box& inputBox, const DeepPlane& inPlane,
+                     const ChannelSet& channels, float sigmaX, float sigmaY,
+                     int radX, int radY, DeepOutputPlane& plane)
+    {
+        const int nChans = channels.size();
+        ScratchBuf& scratch = threadScratch();
+        static thread_local deepc::LayeredBlur layered;
+        static thread_local std::vector<Channel> channelList;
+
+        channelList.clear();
+        foreach(z, channels) {
+            channelList.push_back(z);
+        }
+
+        if (!layered.flatten(inPlane, inputBox.x(), inputBox.y(), inputBox.r(), inputBox.t(),
+                             Chan_DeepFront, Chan_DeepBack, Chan_Alpha, channelList,
+                             _depthLayers, [this] { return aborted(); }))
+            return false;
+
+        if (!layered.empty()) {
+            const std::vector<float> kernelX = halfKernel(sigmaX, radX);
+            const std::vector<float> kernelY = halfKernel(sigmaY, radY);
+            layered.blur(radX > 0 ? &kernelX : nullptr, radY > 0 ? &kernelY : nullptr);
+        }
+
+        for (Box::iterator it = box.begin(); it != box.end(); ++it) {
+            if (Op::aborted())
+                return false;
 
+            scratch.samples.reset(nChans);
+            layered.readPixel(it.x, it.y, scratch.samples);
+            emitPixel(scratch, channels, plane);
+        }
+
+        return true;
+    }
+
+    // Normalized 1D Gaussian, centre at index 0
+    static std::vector<float> halfKernel(float sigma, int radius)
+    {
+        std::vector<float> kernel(radius + 1);
+        float sum = 0.0f;
+        for (int i = 0; i <= radius; ++i) {
+            kernel[i] = std::exp(-0.5f * (i * i) / (sigma * sigma));
+            sum += i == 0 ? kernel[i] : 2.0f * kernel[i];
+        }
+        if (sum > 0.0f) {
+            const float invSum = 1.0f / sum;
+            for (auto& v : kernel)
+                v *= invSum;
+        }
+        return kernel;
+    }
+
+    // ------------------------------------------------------------------
+    // emitPixel — optimize and write one output pixel
+    // ------------------------------------------------------------------
+    void emitPixel(ScratchBuf& scratch, const ChannelSet& channels,
+                   DeepOutputPlane& plane) const
+    {
+        scratch.outPixel.clear();
+        if (finishPixel(scratch, channels, scratch.outPixel))
             plane.addPixel(scratch.outPixel);
+        else
+            plane.addHole();
+    }
+
+    // ------------------------------------------------------------------
+    // finishPixel — optimize scratch.samples and append them in channel
+    // order to out (a DeepOutPixel or a row buffer); false for an empty
+    // pixel (a hole)
+    // ------------------------------------------------------------------
+    template <class Out>
+    bool finishPixel(ScratchBuf& scratch, const ChannelSet& channels, Out& out) const
+    {
+        if (scratch.samples.empty())
+            return false;
+
+        // Per-pixel sample optimization
+        deepc::optimizeSamples(scratch.samples,
+                               _mergeTolerance,
+                               _colorTolerance,
+                               _maxSamples);
+
+        // Emit output samples
+        for (size_t i = 0; i < scratch.samples.size(); ++i) {
+            const deepc::SampleHeader& sr = scratch.samples.header(i);
+            const float* srChannels = scratch.samples.channels(i);
+            int ci = 0;
+            foreach(z, channels) {
+                if (z == Chan_DeepFront)
+                    out.push_back(sr.zFront);
+                else if (z == Chan_DeepBack)
+                    out.push_back(sr.zBack);
+                else
+                    out.push_back(srChannels[ci]);
+                ci++;
+            }
         }
 
         return true;
     }
 
+public:
     static const Op::Description d;
 };
 
@@ -16,10 +16,14 @@
 #include "DDImage/DeepPlane.h"
 #include "DDImage/Knobs.h"
 
+#include "DeepLayerBlur.h"
 #include "DeepSampleOptimizer.h"
 
 #include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <cmath>
+#include <cstdio>
 #include <vector>
 
 using namespace DD::Image;
@@ -34,18 +38,48 @@ static const char* const HELP =
     "Blur Size — Width and height can be set independently via the lock toggle. "
     "Sigma = radius / 3. Large values will be slow.\n\n"
     "Kernel Quality — Low (fast/approximate), Medium (normalized, default), "
-    "High (CDF sub-pixel integration).\n\n"
+    "High (CDF sub-pixel integration), Fast (recursive): samples are "
+    "flattened into depth layers and each layer is blurred with a recursive "
+    "Gaussian whose cost does not depend on the blur size — use it for very "
+    "large blurs.\n\n"
+    "Engine — Sliding window (default) transposes each input row once into a "
+    "compact sample table that all neighbouring outputs read from; Direct "
+    "copies every source sample into each horizontal neighbour first. Both "
+    "produce identical results; Direct uses (2 × radius + 1) times more "
+    "intermediate memory. Depth sliced flattens each tile into a few depth "
+    "slices placed from a depth histogram, blurs them as flat images and "
+    "emits at most one sample per slice per pixel: bounded output and "
+    "predictable memory, at the cost of depth detail.\n\n"
     "Alpha Correction — Corrects alpha darkening caused by over-compositing "
     "blurred deep samples. Enable when the blur result appears too dark after "
     "compositing.\n\n"
     "Sample Optimization (twirldown) — Max samples cap, merge Z tolerance, "
-    "and colour tolerance control per-pixel sample merging after blur.\n\n"
+    "and colour tolerance control per-pixel sample merging after blur. "
+    "Merge after H pass additionally merges between the two passes: much "
+    "less memory and time on dense inputs, but approximate.\n\n"
+    "Statistics — peak intermediate memory, pass timings and intermediate "
+    "sample counts of the last render.\n\n"
     "Part of the DeepC plugin collection.";
 
 // ---------------------------------------------------------------------------
 // Kernel quality tier names for Enumeration_knob
 // ---------------------------------------------------------------------------
-static const char* const kernelQualityNames[] = { "Low", "Medium", "High", nullptr };
+static const char* const kernelQualityNames[] = { "Low", "Medium", "High",
+                                                   "Fast (recursive)", nullptr };
+
+// Kernel quality entry that switches to the depth-layered recursive engine
+static const int kQualityRecursive = 3;
+
+// ---------------------------------------------------------------------------
+// Blur engine names for Enumeration_knob
+// ---------------------------------------------------------------------------
+static const char* const engineNames[] = { "Sliding window", "Direct", "Depth sliced", nullptr };
+
+enum BlurEngine {
+    ENGINE_SLIDING_WINDOW = 0,
+    ENGINE_DIRECT,
+    ENGINE_DEPTH_SLICED
+};
 
 // ---------------------------------------------------------------------------
 // Gaussian kernel generation — three accuracy tiers
@@ -135,31 +169,130 @@ class DeepCBlur2 : public DeepFilterOp
 {
     double _blurSize[2];    // width/height pixel radius pair
     bool   _alphaCorrection; // post-blur alpha darkening correction
-    int   _kernelQuality;   // kernel accuracy tier: 0=Low, 1=Medium, 2=High
+    int   _kernelQuality;   // kernel accuracy tier: 0=Low, 1=Medium, 2=High, 3=Fast
+    int   _depthLayers;     // depth layers of the Fast (recursive) tier
+    int   _engine;          // BlurEngine: how the horizontal pass is stored
     int   _maxSamples;      // per-pixel sample cap (0 = unlimited)
     float _mergeTolerance;  // Z-front distance for sample merge
     float _colorTolerance;  // channel-value distance for sample merge
+    bool  _intermediateMerge; // also merge after the H pass (approximate)
+
+    // --- Statistics ---
+    std::atomic<int64_t> _statSamplesIn;   // intermediate samples before merge
+    std::atomic<int64_t> _statSamplesOut;  // intermediate samples kept
+    std::atomic<int64_t> _statHPassNs;     // summed over threads
+    std::atomic<int64_t> _statVPassNs;
+    std::atomic<int64_t> _liveBytes;       // intermediate memory alive right now
+    std::atomic<int64_t> _peakBytes;
+    const char* _statText;
+    char _statBuf[512];
 
     // Thread-local scratch buffers for zero-allocation hot path
     struct ScratchBuf {
-        std::vector<deepc::SampleRecord> samples;
+        deepc::SamplePool                 samples;
+        deepc::SamplePool                 gather;   // H pass, before merge
         DeepOutPixel                      outPixel;
     };
 
+    // Sliding-window engine: every sample of one input row, transposed once
+    // into a flat pool. Column c of the table owns samples
+    // [colStart[c], colStart[c + 1]).
+    struct RowTable {
+        deepc::SamplePool   samples;
+        std::vector<size_t> colStart;
+    };
+
     // Compute kernel radius from blur parameter (blur = 3-sigma radius)
     static int kernelRadius(float blur) {
         return std::max(0, static_cast<int>(std::ceil(blur)));
     }
 
+    // Fast (recursive) quality and the depth-sliced engine blur flattened
+    // depth layers instead of propagating samples
+    bool layered() const
+    {
+        return _kernelQuality == kQualityRecursive || _engine == ENGINE_DEPTH_SLICED;
+    }
+
+    static int64_t nowNs()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    // Counts an engine's intermediate buffers towards the peak while alive
+    class IntermediateMemory {
+    public:
+        IntermediateMemory(DeepCBlur2& op, int64_t bytes) : _op(op), _bytes(bytes)
+        {
+            const int64_t live = _op._liveBytes.fetch_add(_bytes, std::memory_order_relaxed) + _bytes;
+            int64_t peak = _op._peakBytes.load(std::memory_order_relaxed);
+            while (live > peak &&
+                   !_op._peakBytes.compare_exchange_weak(peak, live, std::memory_order_relaxed)) {}
+        }
+        ~IntermediateMemory()
+        {
+            _op._liveBytes.fetch_sub(_bytes, std::memory_order_relaxed);
+        }
+    private:
+        DeepCBlur2& _op;
+        int64_t     _bytes;
+    };
+
+    void updateStatKnob()
+    {
+        const int64_t si = _statSamplesIn.load(std::memory_order_relaxed);
+        const int64_t so = _statSamplesOut.load(std::memory_order_relaxed);
+        const double peakMB = _peakBytes.load(std::memory_order_relaxed) / (1024.0 * 1024.0);
+        const double hSec = _statHPassNs.load(std::memory_order_relaxed) * 1e-9;
+        const double vSec = _statVPassNs.load(std::memory_order_relaxed) * 1e-9;
+
+        if (si <= 0) {
+            snprintf(_statBuf, sizeof(_statBuf),
+                     "No samples processed yet — render to see statistics.");
+        } else if (so < si && so > 0) {
+            // V-pass cost is proportional to the intermediate samples it
+            // gathers, so without the merge it would have taken si / so longer
+            const double savedSec = vSec * (double)(si - so) / (double)so;
+            snprintf(_statBuf, sizeof(_statBuf),
+                     "Peak intermediate: %.1f MB   H pass: %.2f s   V pass: %.2f s\n"
+                     "Intermediate samples: %lld -> %lld (%.1f%% merged)   "
+                     "Est. V pass time saved: %.2f s",
+                     peakMB, hSec, vSec, (long long)si, (long long)so,
+                     100.0 * (1.0 - (double)so / (double)si), savedSec);
+        } else {
+            snprintf(_statBuf, sizeof(_statBuf),
+                     "Peak intermediate: %.1f MB   H pass: %.2f s   V pass: %.2f s\n"
+                     "Intermediate samples: %lld",
+                     peakMB, hSec, vSec, (long long)si);
+        }
+
+        Knob* k = knob("stat_display");
+        if (k) k->set_text(_statBuf);
+    }
+
 public:
     DeepCBlur2(Node* node) : DeepFilterOp(node),
         _blurSize{1.0, 1.0},
         _alphaCorrection(false),
         _kernelQuality(1),
+        _depthLayers(16),
+        _engine(ENGINE_SLIDING_WINDOW),
         _maxSamples(100),
         _mergeTolerance(0.001f),
-        _colorTolerance(0.01f)
-    {}
+        _colorTolerance(0.01f),
+        _intermediateMerge(false),
+        _statSamplesIn(0),
+        _statSamplesOut(0),
+        _statHPassNs(0),
+        _statVPassNs(0),
+        _liveBytes(0),
+        _peakBytes(0),
+        _statText(_statBuf)
+    {
+        snprintf(_statBuf, sizeof(_statBuf),
+                 "No samples processed yet — render to see statistics.");
+    }
 
     const char* Class() const override { return CLASS; }
     const char* node_help() const override { return HELP; }
@@ -177,7 +310,25 @@ public:
 
         Enumeration_knob(f, &_kernelQuality, kernelQualityNames, "kernel_quality", "kernel quality");
         Tooltip(f, "Gaussian kernel accuracy tier. Low = fast/approximate, "
-                    "Medium = normalized (default), High = CDF sub-pixel integration.");
+                    "Medium = normalized (default), High = CDF sub-pixel integration, "
+                    "Fast (recursive) = depth-layered recursive Gaussian whose cost "
+                    "does not grow with blur size.");
+
+        Int_knob(f, &_depthLayers, "depth_layers", "depth layers");
+        SetRange(f, 1, 64);
+        Tooltip(f, "Fast (recursive) and Depth sliced only: number of depth "
+                    "layers the samples of each tile are flattened into before "
+                    "blurring, placed so each holds a similar share of the "
+                    "samples. Each layer becomes at most one output sample per "
+                    "pixel; more layers keep more depth separation but cost "
+                    "proportionally more.");
+
+        Enumeration_knob(f, &_engine, engineNames, "engine", "engine");
+        Tooltip(f, "How samples are propagated. Sliding window reads each source "
+                    "sample once into a per-row table shared by all neighbouring "
+                    "outputs; Direct copies it into every horizontal neighbour "
+                    "(identical results). Depth sliced blurs a few flattened "
+                    "depth layers instead of individual samples.");
 
         Bool_knob(f, &_alphaCorrection, "alpha_correction", "alpha correction");
         Tooltip(f, "Correct alpha darkening caused by over-compositing blurred deep samples. "
@@ -200,9 +351,40 @@ public:
         Tooltip(f, "Maximum per-channel colour difference for sample merge. "
                     "0 = merge by Z only.");
 
+        Bool_knob(f, &_intermediateMerge, "intermediate_merge", "merge after H pass");
+        Tooltip(f, "Also merge samples between the horizontal and vertical passes, "
+                    "using the tolerances above, so the vertical pass gathers far "
+                    "fewer samples. Cuts memory and time drastically on dense "
+                    "inputs, but samples are merged before they receive their "
+                    "vertical weights, so the result is approximate. Uses the "
+                    "Direct engine layout.");
+
+        EndGroup(f);
+
+        BeginClosedGroup(f, "Statistics");
+        String_knob(f, &_statText, "stat_display", "");
+        SetFlags(f, Knob::DISABLED | Knob::OUTPUT_ONLY);
+        Tooltip(f, "Peak intermediate memory, pass timings (summed over threads) "
+                    "and intermediate sample counts of the last render.");
+        Button(f, "update_stats", "Update Statistics");
+        Tooltip(f, "Force a refresh of the statistics display.");
         EndGroup(f);
     }
 
+    int knob_changed(Knob* k) override
+    {
+        if (k->is("kernel_quality") || k->is("engine") || k == &Knob::showPanel) {
+            knob("depth_layers")->enable(layered());
+            if (k != &Knob::showPanel)
+                return 1;
+        }
+        if (k->is("update_stats")) {
+            updateStatKnob();
+            return 1;
+        }
+        return DeepFilterOp::knob_changed(k);
+    }
+
     // ------------------------------------------------------------------
     // _validate — expand bounding box by kernel radius
     // ------------------------------------------------------------------
@@ -210,6 +392,12 @@ public:
     {
         DeepFilterOp::_validate(for_real);
 
+        _statSamplesIn.store(0,  std::memory_order_relaxed);
+        _statSamplesOut.store(0, std::memory_order_relaxed);
+        _statHPassNs.store(0,    std::memory_order_relaxed);
+        _statVPassNs.store(0,    std::memory_order_relaxed);
+        _peakBytes.store(0,      std::memory_order_relaxed);
+
         const int radX = kernelRadius(static_cast<float>(_blurSize[0]));
         const int radY = kernelRadius(static_cast<float>(_blurSize[1]));
 
@@ -297,10 +485,6 @@ public:
         if (!in->deepEngine(inputBox, channels, inPlane))
             return false;
 
-        // Compute 1D half-kernels for separable passes
-        const auto kernelH = computeKernel(blurW, _kernelQuality);
-        const auto kernelV = computeKernel(blurH, _kernelQuality);
-
         // Determine channel layout — identify which channels are depth vs data
         const int nChans = channels.size();
 
@@ -314,13 +498,59 @@ public:
             }
         }
 
+        plane = DeepOutputPlane(channels, box, DeepPixel::eUnordered);
+
+        if (layered())
+            return layeredEngine(box, inputBox, inPlane, channels, isDepthChan,
+                                 blurW, blurH, plane);
+
+        // Compute 1D half-kernels for separable passes
+        const auto kernelH = computeKernel(blurW, _kernelQuality);
+        const auto kernelV = computeKernel(blurH, _kernelQuality);
+
+        if (_engine == ENGINE_DIRECT || _intermediateMerge)
+            return directEngine(box, inputBox, inPlane, channels, isDepthChan,
+                                kernelH, kernelV, plane);
+        return slidingWindowEngine(box, inputBox, inPlane, channels, isDepthChan,
+                                   kernelH, kernelV, plane);
+    }
+
+    void _close() override
+    {
+        updateStatKnob();
+        DeepFilterOp::_close();
+    }
+
+private:
+    // ------------------------------------------------------------------
+    // directEngine — materialise the horizontal pass per output column
+    // ------------------------------------------------------------------
+    bool directEngine(const Box& box, const Box& inputBox, const DeepPlane& inPlane,
+                      const ChannelSet& channels, const std::vector<bool>& isDepthChan,
+                      const std::vector<float>& kernelH,
+                      const std::vector<float>& kernelV,
+                      DeepOutputPlane& plane)
+    {
+        const int radX = static_cast<int>(kernelH.size()) - 1;
+        const int radY = static_cast<int>(kernelV.size()) - 1;
+        const int nChans = channels.size();
+
+        static thread_local ScratchBuf scratch;
+
         // ---------------------------------------------------------------
         // HORIZONTAL PASS: gather along X into intermediate buffer
         //
         // Intermediate buffer dimensions:
         //   height = inputBox height (padded Y range, needed for V pass)
         //   width  = output box width (only output columns are needed)
+        //
+        // With intermediate merge on, each pixel is gathered into scratch,
+        // merged, and only the survivors are copied into the buffer.
         // ---------------------------------------------------------------
+        const int64_t hStart = nowNs();
+        int64_t samplesIn = 0;
+        int64_t samplesOut = 0;
+
         const int intW = box.r() - box.x();
         const int intH = inputBox.t() - inputBox.y();
 
@@ -328,8 +558,8 @@ public:
         auto intX = [&](int worldX) { return worldX - box.x(); };
         auto intY = [&](int worldY) { return worldY - inputBox.y(); };
 
-        std::vector<std::vector<std::vector<deepc::SampleRecord>>> intermediateBuffer(
-            intH, std::vector<std::vector<deepc::SampleRecord>>(intW));
+        std::vector<std::vector<deepc::SamplePool>> intermediateBuffer(
+            intH, std::vector<deepc::SamplePool>(intW));
 
         const Box& inBox = inPlane.box();
 
@@ -342,6 +572,8 @@ public:
                     return false;
 
                 auto& destSamples = intermediateBuffer[intY(srcY)][intX(outX)];
+                deepc::SamplePool& gather = _intermediateMerge ? scratch.gather : destSamples;
+                gather.reset(nChans);
 
                 // Gather from horizontal neighbourhood
                 for (int dx = -radX; dx <= radX; ++dx) {
@@ -359,39 +591,54 @@ public:
                         continue;
 
                     for (int s = 0; s < srcSamples; ++s) {
-                        deepc::SampleRecord rec;
-                        rec.zFront = srcPixel.getUnorderedSample(s, Chan_DeepFront);
-                        rec.zBack  = srcPixel.getUnorderedSample(s, Chan_DeepBack);
-                        rec.alpha  = srcPixel.getUnorderedSample(s, Chan_Alpha) * weight;
+                        float* rec = gather.add(
+                            srcPixel.getUnorderedSample(s, Chan_DeepFront),
+                            srcPixel.getUnorderedSample(s, Chan_DeepBack),
+                            srcPixel.getUnorderedSample(s, Chan_Alpha) * weight);
 
-                        rec.channels.resize(nChans);
                         int ci = 0;
                         foreach(z, channels) {
                             if (isDepthChan[ci]) {
-                                rec.channels[ci] = srcPixel.getUnorderedSample(s, z);
+                                rec[ci] = srcPixel.getUnorderedSample(s, z);
                             } else {
-                                rec.channels[ci] = srcPixel.getUnorderedSample(s, z) * weight;
+                                rec[ci] = srcPixel.getUnorderedSample(s, z) * weight;
                             }
                             ci++;
                         }
-
-                        destSamples.push_back(std::move(rec));
                     }
                 }
+
+                samplesIn += gather.size();
+                if (_intermediateMerge) {
+                    // No sample cap here: dropping samples before the V pass
+                    // would lose coverage rather than just detail
+                    deepc::optimizeSamples(gather, _mergeTolerance, _colorTolerance, 0);
+                    destSamples.compactFrom(gather);
+                }
+                samplesOut += destSamples.size();
             }
         }
 
+        int64_t intermediateBytes = 0;
+        for (const auto& row : intermediateBuffer)
+            for (const auto& pool : row)
+                intermediateBytes += pool.memoryBytes();
+        IntermediateMemory memory(*this, intermediateBytes);
+
+        _statSamplesIn.fetch_add(samplesIn,   std::memory_order_relaxed);
+        _statSamplesOut.fetch_add(samplesOut, std::memory_order_relaxed);
+        _statHPassNs.fetch_add(nowNs() - hStart, std::memory_order_relaxed);
+
         // ---------------------------------------------------------------
         // VERTICAL PASS: gather along Y from intermediate → output
         //
         // For each output pixel (outX, outY), gather from intermediate
         // rows outY-radY..outY+radY, weighting by kernelV. The total
         // weight per sample is H_weight × V_weight (separable property).
-        // optimizeSamples runs only after this final pass.
+        // The full optimization, with the sample cap, runs only after this
+        // final pass.
         // ---------------------------------------------------------------
-        static thread_local ScratchBuf scratch;
-
-        plane = DeepOutputPlane(channels, box, DeepPixel::eUnordered);
+        const int64_t vStart = nowNs();
 
         for (Box::iterator it = box.begin(); it != box.end(); ++it) {
             if (Op::aborted())
@@ -400,7 +647,7 @@ public:
             const int outX = it.x;
             const int outY = it.y;
 
-            scratch.samples.clear();
+            scratch.samples.reset(nChans);
 
             for (int dy = -radY; dy <= radY; ++dy) {
                 const int srcY = outY + dy;
@@ -420,76 +667,309 @@ public:
                 if (weight <= 0.0f)
                     continue;
 
-                for (const auto& hRec : hSamples) {
-                    deepc::SampleRecord rec;
-                    rec.zFront = hRec.zFront;
-                    rec.zBack  = hRec.zBack;
-                    rec.alpha  = hRec.alpha * weight;
+                for (size_t h = 0; h < hSamples.size(); ++h) {
+                    const deepc::SampleHeader& hRec = hSamples.header(h);
+                    const float* hChannels = hSamples.channels(h);
+                    float* rec = scratch.samples.add(hRec.zFront, hRec.zBack,
+                                                     hRec.alpha * weight);
 
-                    rec.channels.resize(nChans);
                     for (int ci = 0; ci < nChans; ++ci) {
                         if (isDepthChan[ci]) {
-                            rec.channels[ci] = hRec.channels[ci];
+                            rec[ci] = hChannels[ci];
                         } else {
-                            rec.channels[ci] = hRec.channels[ci] * weight;
+                            rec[ci] = hChannels[ci] * weight;
                         }
                     }
-
-                    scratch.samples.push_back(std::move(rec));
                 }
             }
 
-            // Empty pixel → hole
-            if (scratch.samples.empty()) {
-                plane.addHole();
+            emitPixel(scratch, channels, isDepthChan, plane);
+        }
+
+        _statVPassNs.fetch_add(nowNs() - vStart, std::memory_order_relaxed);
+        return true;
+    }
+
+    // ------------------------------------------------------------------
+    // slidingWindowEngine — per-row sample tables shared by all outputs
+    //
+    // Each input row is transposed once into a RowTable. The horizontal
+    // pass is never materialised: an output pixel reads its 2D
+    // neighbourhood straight from the tables via the column offsets, so
+    // intermediate memory is one copy of the input rows regardless of
+    // radius. Samples are gathered in the same order and with the same
+    // float operations as directEngine, so the output is identical.
+    // ------------------------------------------------------------------
+    bool slidingWindowEngine(const Box& box, const Box& inputBox,
+                             const DeepPlane& inPlane, const ChannelSet& channels,
+                             const std::vector<bool>& isDepthChan,
+                             const std::vector<float>& kernelH,
+                             const std::vector<float>& kernelV,
+                             DeepOutputPlane& plane)
+    {
+        const int radX = static_cast<int>(kernelH.size()) - 1;
+        const int radY = static_cast<int>(kernelV.size()) - 1;
+        const int nChans = channels.size();
+
+        // Columns any output pixel can reach, clipped to the fetched data
+        const Box& inBox = inPlane.box();
+        const int x0 = std::max(box.x() - radX, inBox.x());
+        const int x1 = std::min(box.r() + radX, inBox.r());
+        const int tableW = std::max(0, x1 - x0);
+        const int intH = inputBox.t() - inputBox.y();
+
+        static thread_local std::vector<RowTable> rowTables;
+        if (static_cast<int>(rowTables.size()) < intH)
+            rowTables.resize(intH);
+
+        // ---------------------------------------------------------------
+        // HORIZONTAL PASS: transpose each input row into its table
+        // ---------------------------------------------------------------
+        const int64_t hStart = nowNs();
+        int64_t tableSamples = 0;
+        for (int srcY = inputBox.y(); srcY < inputBox.t(); ++srcY) {
+            if (Op::aborted())
+                return false;
+
+            RowTable& table = rowTables[srcY - inputBox.y()];
+            table.samples.reset(nChans);
+            table.colStart.assign(tableW + 1, 0);
+
+            if (srcY < inBox.y() || srcY >= inBox.t())
                 continue;
+
+            for (int srcX = x0; srcX < x1; ++srcX) {
+                table.colStart[srcX - x0] = table.samples.size();
+
+                DeepPixel srcPixel = inPlane.getPixel(srcY, srcX);
+                const int srcSamples = static_cast<int>(srcPixel.getSampleCount());
+                for (int s = 0; s < srcSamples; ++s) {
+                    float* rec = table.samples.add(
+                        srcPixel.getUnorderedSample(s, Chan_DeepFront),
+                        srcPixel.getUnorderedSample(s, Chan_DeepBack),
+                        srcPixel.getUnorderedSample(s, Chan_Alpha));
+
+                    int ci = 0;
+                    foreach(z, channels) {
+                        rec[ci++] = srcPixel.getUnorderedSample(s, z);
+                    }
+                }
             }
+            table.colStart[tableW] = table.samples.size();
+            tableSamples += table.samples.size();
+        }
+
+        int64_t intermediateBytes = 0;
+        for (int r = 0; r < intH; ++r)
+            intermediateBytes += rowTables[r].samples.memoryBytes()
+                               + rowTables[r].colStart.capacity() * sizeof(size_t);
+        IntermediateMemory memory(*this, intermediateBytes);
+
+        _statSamplesIn.fetch_add(tableSamples,  std::memory_order_relaxed);
+        _statSamplesOut.fetch_add(tableSamples, std::memory_order_relaxed);
+        _statHPassNs.fetch_add(nowNs() - hStart, std::memory_order_relaxed);
+
+        // ---------------------------------------------------------------
+        // VERTICAL PASS: gather the 2D neighbourhood from the row tables
+        //
+        // Weights are applied H first, then V, exactly as the separable
+        // direct engine does. optimizeSamples runs only after this pass.
+        // ---------------------------------------------------------------
+        static thread_local ScratchBuf scratch;
+        const int64_t vStart = nowNs();
+
+        for (Box::iterator it = box.begin(); it != box.end(); ++it) {
+            if (Op::aborted())
+                return false;
+
+            const int outX = it.x;
+            const int outY = it.y;
+
+            scratch.samples.reset(nChans);
+
+            for (int dy = -radY; dy <= radY; ++dy) {
+                const int srcY = outY + dy;
+                if (srcY < inputBox.y() || srcY >= inputBox.t())
+                    continue;
+
+                const RowTable& table = rowTables[srcY - inputBox.y()];
+                if (table.samples.empty())
+                    continue;
+
+                const float weightV = kernelV[std::abs(dy)];
+                if (weightV <= 0.0f)
+                    continue;
+
+                const int cLo = std::max(outX - radX, x0) - x0;
+                const int cHi = std::min(outX + radX + 1, x1) - x0;
+                for (int c = cLo; c < cHi; ++c) {
+                    const size_t first = table.colStart[c];
+                    const size_t last  = table.colStart[c + 1];
+                    if (first == last)
+                        continue;
+
+                    const float weightH = kernelH[std::abs(c + x0 - outX)];
+                    if (weightH <= 0.0f)
+                        continue;
+
+                    for (size_t i = first; i < last; ++i) {
+                        const deepc::SampleHeader& src = table.samples.header(i);
+                        const float* srcChannels = table.samples.channels(i);
+                        float* rec = scratch.samples.add(src.zFront, src.zBack,
+                                                         src.alpha * weightH * weightV);
 
-            // Per-pixel sample optimization (only after V pass)
-            deepc::optimizeSamples(scratch.samples,
-                                   _mergeTolerance,
-                                   _colorTolerance,
-                                   _maxSamples);
-
-            // Alpha darkening correction — undo over-composite darkening
-            if (_alphaCorrection && scratch.samples.size() > 1) {
-                float cumTransp = 1.0f;
-                for (auto& sr : scratch.samples) {
-                    if (cumTransp > 1e-6f) {
-                        const float inv = 1.0f / cumTransp;
                         for (int ci = 0; ci < nChans; ++ci) {
-                            if (!isDepthChan[ci])
-                                sr.channels[ci] *= inv;
+                            if (isDepthChan[ci]) {
+                                rec[ci] = srcChannels[ci];
+                            } else {
+                                rec[ci] = srcChannels[ci] * weightH * weightV;
+                            }
                         }
-                        sr.alpha *= inv;
                     }
-                    cumTransp *= std::max(0.0f, 1.0f - sr.alpha);
                 }
             }
 
-            // Emit output samples
-            scratch.outPixel.clear();
-            scratch.outPixel.reserve(static_cast<int>(scratch.samples.size()) * nChans);
-
-            for (const auto& sr : scratch.samples) {
-                int ci = 0;
-                foreach(z, channels) {
-                    if (z == Chan_DeepFront)
-                        scratch.outPixel.push_back(sr.zFront);
-                    else if (z == Chan_DeepBack)
-                        scratch.outPixel.push_back(sr.zBack);
-                    else
-                        scratch.outPixel.push_back(sr.channels[ci]);
-                    ci++;
-                }
+            emitPixel(scratch, channels, isDepthChan, plane);
+        }
+
+        _statVPassNs.fetch_add(nowNs() - vStart, std::memory_order_relaxed);
+        return true;
+    }
+
+    // ------------------------------------------------------------------
+    // layeredEngine — blur flattened depth layers (Fast tier, Depth sliced)
+    //
+    // The padded input is flattened by deepc::LayeredBlur into up to
+    // _depthLayers dense layers, placed from a depth histogram of the tile
+    // so each holds a similar share of the samples (samples sharing a pixel
+    // and layer are composited with "over"). Each layer is blurred as a flat image —
+    // with a recursive Gaussian for the Fast tier, so the cost does not
+    // depend on the blur size, otherwise with the tier's separable kernel —
+    // and read back as at most one sample per layer per output pixel.
+    // ------------------------------------------------------------------
+    bool layeredEngine(const Box& box, const Box& inputBox, const DeepPlane& inPlane,
+                       const ChannelSet& channels, const std::vector<bool>& isDepthChan,
+                       float blurW, float blurH, DeepOutputPlane& plane)
+    {
+        const int nChans = channels.size();
+        static thread_local ScratchBuf scratch;
+        static thread_local deepc::LayeredBlur layered;
+        static thread_local std::vector<Channel> channelList;
+
+        channelList.clear();
+        foreach(z, channels) {
+            channelList.push_back(z);
+        }
+
+        // ---------------------------------------------------------------
+        // Flatten the input into layers and blur them; an axis with no
+        // blur is left alone
+        // ---------------------------------------------------------------
+        const int64_t hStart = nowNs();
+        if (!layered.flatten(inPlane, inputBox.x(), inputBox.y(), inputBox.r(), inputBox.t(),
+                             Chan_DeepFront, Chan_DeepBack, Chan_Alpha, channelList,
+                             _depthLayers, [this] { return aborted(); }))
+            return false;
+
+        if (!layered.empty()) {
+            const bool blurX = kernelRadius(blurW) > 0;
+            const bool blurY = kernelRadius(blurH) > 0;
+            if (_kernelQuality == kQualityRecursive) {
+                const deepc::RecursiveGaussian gx(blurW / 3.0f);
+                const deepc::RecursiveGaussian gy(blurH / 3.0f);
+                layered.blur(blurX ? &gx : nullptr, blurY ? &gy : nullptr);
+            } else {
+                const auto kernelH = computeKernel(blurW, _kernelQuality);
+                const auto kernelV = computeKernel(blurH, _kernelQuality);
+                layered.blur(blurX ? &kernelH : nullptr, blurY ? &kernelV : nullptr);
             }
+        }
+
+        IntermediateMemory memory(*this, static_cast<int64_t>(layered.memoryBytes()));
+        const int64_t sampleCount = static_cast<int64_t>(layered.sampleCount());
+        _statSamplesIn.fetch_add(sampleCount,  std::memory_order_relaxed);
+        _statSamplesOut.fetch_add(sampleCount, std::memory_order_relaxed);
+        _statHPassNs.fetch_add(nowNs() - hStart, std::memory_order_relaxed);
+
+        // ---------------------------------------------------------------
+        // Read one sample per non-empty layer back out
+        // ---------------------------------------------------------------
+        const int64_t vStart = nowNs();
 
-            plane.addPixel(scratch.outPixel);
+        for (Box::iterator it = box.begin(); it != box.end(); ++it) {
+            if (Op::aborted())
+                return false;
+
+            scratch.samples.reset(nChans);
+            layered.readPixel(it.x, it.y, scratch.samples);
+            emitPixel(scratch, channels, isDepthChan, plane);
         }
 
+        _statVPassNs.fetch_add(nowNs() - vStart, std::memory_order_relaxed);
         return true;
     }
 
+    // ------------------------------------------------------------------
+    // emitPixel — optimize, alpha-correct and write one output pixel
+    // ------------------------------------------------------------------
+    void emitPixel(ScratchBuf& scratch, const ChannelSet& channels,
+                   const std::vector<bool>& isDepthChan, DeepOutputPlane& plane) const
+    {
+        const int nChans = channels.size();
+
+        // Empty pixel → hole
+        if (scratch.samples.empty()) {
+            plane.addHole();
+            return;
+        }
+
+        // Per-pixel sample optimization (only after V pass)
+        deepc::optimizeSamples(scratch.samples,
+                               _mergeTolerance,
+                               _colorTolerance,
+                               _maxSamples);
+
+        // Alpha darkening correction — undo over-composite darkening
+        if (_alphaCorrection && scratch.samples.size() > 1) {
+            float cumTransp = 1.0f;
+            for (size_t i = 0; i < scratch.samples.size(); ++i) {
+                deepc::SampleHeader& sr = scratch.samples.header(i);
+                float* srChannels = scratch.samples.channels(i);
+                if (cumTransp > 1e-6f) {
+                    const float inv = 1.0f / cumTransp;
+                    for (int ci = 0; ci < nChans; ++ci) {
+                        if (!isDepthChan[ci])
+                            srChannels[ci] *= inv;
+                    }
+                    sr.alpha *= inv;
+                }
+                cumTransp *= std::max(0.0f, 1.0f - sr.alpha);
+            }
+        }
+
+        // Emit output samples
+        scratch.outPixel.clear();
+        scratch.outPixel.reserve(static_cast<int>(scratch.samples.size()) * nChans);
+
+        for (size_t i = 0; i < scratch.samples.size(); ++i) {
+            const deepc::SampleHeader& sr = scratch.samples.header(i);
+            const float* srChannels = scratch.samples.channels(i);
+            int ci = 0;
+            foreach(z, channels) {
+                if (z == Chan_DeepFront)
+                    scratch.outPixel.push_back(sr.zFront);
+                else if (z == Chan_DeepBack)
+                    scratch.outPixel.push_back(sr.zBack);
+                else
+                    scratch.outPixel.push_back(srChannels[ci]);
+                ci++;
+            }
+        }
+
+        plane.addPixel(scratch.outPixel);
+    }
+
+public:
     static const Op::Description d;
 };
 
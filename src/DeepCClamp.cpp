@@ -42,6 +42,8 @@ class DeepCClamp : public DeepCWrapper
             Vector3& sampleColor
             );
 
+        virtual void wrappedPerBatch(DeepCSampleBatch& batch);
+
         virtual void custom_knobs(Knob_Callback f);
 
         static const Iop::Description d;
@@ -85,6 +87,35 @@ void DeepCClamp::wrappedPerChannel(
 }
 
 
+/*
+Batched version of wrappedPerChannel, working on a whole row of samples at
+once.
+*/
+void DeepCClamp::wrappedPerBatch(DeepCSampleBatch& batch)
+{
+    const size_t n = batch.size();
+    for (int lane = 0; lane < batch.lanes(); lane++)
+    {
+        const float* in = batch.in(lane);
+        float* out = batch.out(lane);
+        const int cIndex = batch.colourIndex(lane);
+        const float lo = minValue[cIndex];
+        const float hi = maxValue[cIndex];
+        const float loTo = _minClampTo ? minClampToValue[cIndex] : lo;
+        const float hiTo = _maxClampTo ? maxClampToValue[cIndex] : hi;
+        for (size_t i = 0; i < n; i++)
+        {
+            float v = in[i];
+            if (_minClamp && in[i] < lo)
+                v = loTo;
+            if (_maxClamp && in[i] > hi)
+                v = hiTo;
+            out[i] = v;
+        }
+    }
+}
+
+
 void DeepCClamp::custom_knobs(Knob_Callback f)
 {
     
@@ -1,4 +1,5 @@
 #include "DeepCWrapper.h"
+#include "DeepCSimd.h"
 #include "DDImage/ColorLookup.h"
 #include "DDImage/LookupCurves.h"
 
@@ -12,19 +13,35 @@ static const CurveDescription defaults[] = {
   { nullptr }
 };
 
+// rgb, then master only for any other channel
+static const int tableCount = 4;
+
 class DeepCColorLookup : public DeepCWrapper
 {
     LookupCurves lut;
     float source_value[3];
     float target_value[3];
 
+    // baked tables
+    bool _exact;
+    int _lutSize;
+    float _lutMin;
+    float _lutMax;
+    // set in _validate
+    deepc::simd::Lut1D _tables[tableCount];
+
     public:
 
         DeepCColorLookup(Node* node) : DeepCWrapper(node), lut(defaults)
+            , _exact(false)
+            , _lutSize(4096)
+            , _lutMin(0.0f)
+            , _lutMax(4.0f)
         {
 
 
         }
+        virtual void _validate(bool);
         virtual void wrappedPerChannel(
             const float inputVal,
             float perSampleData,
@@ -33,6 +50,8 @@ class DeepCColorLookup : public DeepCWrapper
             Vector3& sampleColor
             );
 
+        virtual void wrappedPerBatch(DeepCSampleBatch& batch);
+
         virtual void custom_knobs(Knob_Callback f);
 
         static const Iop::Description d;
@@ -40,14 +59,44 @@ class DeepCColorLookup : public DeepCWrapper
         virtual Op* op() { return this; }
         const char* node_help() const;
 
+        // master curve, then the curve of the channel; non-rgb channels
+        // only get the master curve
         float lookup(int z, float value){
             value = float(lut.getValue(0, value));
-            value = float(lut.getValue(z + 1, value));
+            if (z < 3)
+                value = float(lut.getValue(z + 1, value));
             return value;
         };
 };
 
 
+void DeepCColorLookup::_validate(bool for_real)
+{
+    DeepCWrapper::_validate(for_real);
+
+    if (_exact)
+    {
+        for (int i = 0; i < tableCount; i++)
+            _tables[i].clear();
+        return;
+    }
+
+    // bake master and channel curves together, one table per channel
+    const int size = MAX(MIN(_lutSize, 1 << 20), 2);
+    const float lo = _lutMin;
+    float hi = _lutMax;
+    if (!(hi > lo))
+        hi = lo + 1.0f;
+    for (int i = 0; i < tableCount; i++)
+    {
+        _tables[i].bake(
+            [this, i](float value) { return lookup(i, value); },
+            lo, hi, size
+            );
+    }
+}
+
+
 /*
 The guts. Do any processing on the channel value. The result will be masked
 and mixed appropriately.
@@ -64,6 +113,30 @@ void DeepCColorLookup::wrappedPerChannel(
     outData = lookup(colourIndex(z), inputVal);
 }
 
+
+/*
+Batched version of wrappedPerChannel, working on a whole row of samples at
+once. Unless exact is on, the curves are looked up in the tables baked in
+_validate rather than evaluated per value.
+*/
+void DeepCColorLookup::wrappedPerBatch(DeepCSampleBatch& batch)
+{
+    const size_t n = batch.size();
+    for (int lane = 0; lane < batch.lanes(); lane++)
+    {
+        const float* in = batch.in(lane);
+        float* out = batch.out(lane);
+        const int cIndex = MIN(batch.colourIndex(lane), tableCount - 1);
+        if (!_exact)
+        {
+            _tables[cIndex].apply(in, out, n);
+            continue;
+        }
+        for (size_t i = 0; i < n; i++)
+            out[i] = lookup(cIndex, in[i]);
+    }
+}
+
 const char* setRgbScript =
   "source = nuke.thisNode().knob('source')\n"
   "target = nuke.thisNode().knob('target')\n"
@@ -87,6 +160,30 @@ void DeepCColorLookup::custom_knobs(Knob_Callback f)
     PyScript_knob(f, setRgbScript, "setRGB", "Set RGB");
     Tooltip(f, "Add points on the r, g, b curves mapping source to target.");
 
+    Divider(f, "");
+    Int_knob(f, &_lutSize, "lut_size", "lut size");
+    SetFlags(f, Knob::STARTLINE);
+    Tooltip(f,
+        "Number of entries in the tables the curves are baked into. Values "
+        "are interpolated linearly between entries."
+    );
+    Float_knob(f, &_lutMin, IRange(-1, 1), "lut_min", "lut range");
+    SetFlags(f, Knob::STARTLINE);
+    Tooltip(f, "Lowest input value the tables cover.");
+    Float_knob(f, &_lutMax, IRange(1, 4), "lut_max", "");
+    ClearFlags(f, Knob::STARTLINE);
+    Tooltip(f,
+        "Highest input value the tables cover. Outside the range the curves "
+        "are continued linearly from their ends, which is exact for the "
+        "default curves; widen it if you have keys outside the range."
+    );
+    Bool_knob(f, &_exact, "exact");
+    SetFlags(f, Knob::STARTLINE);
+    Tooltip(f,
+        "Evaluate the curves for every value instead of using the baked "
+        "tables. Slower; for checking the tables against the curves."
+    );
+
 
 }
 
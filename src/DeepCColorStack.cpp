@@ -0,0 +1,826 @@
+#include "DeepCWrapper.h"
+#include "DeepCSimd.h"
+#include "DDImage/RGB.h"
+#include <DDImage/Convolve.h>
+
+#include <algorithm>
+#include <math.h>
+#include <vector>
+
+using namespace DD::Image;
+
+// the operations a stage of the stack can run
+enum {
+    OP_NONE = 0, OP_GRADE, OP_SATURATION, OP_HUESHIFT, OP_MATRIX,
+    OP_MULTIPLY, OP_ADD, OP_CLAMP
+};
+
+static const char* const operationNames[] = {
+    "none",
+    "grade",
+    "saturation",
+    "hue shift",
+    "matrix",
+    "multiply",
+    "add",
+    "clamp",
+    0
+};
+
+static const int stageCount = 8;
+
+// the usual grade chain; matrix is left for the user to place
+static const int defaultStages[stageCount] = {
+    OP_GRADE, OP_SATURATION, OP_HUESHIFT, OP_MULTIPLY,
+    OP_ADD, OP_CLAMP, OP_NONE, OP_NONE
+};
+
+// luminance modes, as DeepCSaturation
+enum {
+    REC709 = 0, CCIR601, AVERAGE, MAXIMUM
+};
+
+static const char* mode_names[] = {
+    "Rec 709", "Ccir 601", "Average", "Maximum", nullptr
+};
+
+
+/*
+x' = m * (x, 1) for an rgb colour. Runs of linear operations are composed
+into one of these in _validate; double precision so long stacks don't drift.
+*/
+struct ColorAffine
+{
+    double m[3][4];
+
+    void makeIdentity()
+    {
+        for (int r = 0; r < 3; r++)
+            for (int c = 0; c < 4; c++)
+                m[r][c] = r == c ? 1.0 : 0.0;
+    }
+
+    bool isIdentity() const
+    {
+        for (int r = 0; r < 3; r++)
+            for (int c = 0; c < 4; c++)
+                if (m[r][c] != (r == c ? 1.0 : 0.0))
+                    return false;
+        return true;
+    }
+
+    bool isDiagonal() const
+    {
+        for (int r = 0; r < 3; r++)
+            for (int c = 0; c < 3; c++)
+                if (r != c && m[r][c] != 0.0)
+                    return false;
+        return true;
+    }
+
+    // this = after * this
+    void then(const ColorAffine& after)
+    {
+        ColorAffine result;
+        for (int r = 0; r < 3; r++)
+        {
+            for (int c = 0; c < 4; c++)
+            {
+                double v = c == 3 ? after.m[r][3] : 0.0;
+                for (int k = 0; k < 3; k++)
+                    v += after.m[r][k] * m[k][c];
+                result.m[r][c] = v;
+            }
+        }
+        *this = result;
+    }
+
+    static ColorAffine fromMatrix3(const Matrix3& mtx)
+    {
+        // columns are the images of the basis vectors, which keeps us out
+        // of Matrix3's storage order
+        ColorAffine a;
+        a.makeIdentity();
+        for (int c = 0; c < 3; c++)
+        {
+            Vector3 basis(0.0f, 0.0f, 0.0f);
+            basis[c] = 1.0f;
+            const Vector3 column = mtx.transform(basis);
+            for (int r = 0; r < 3; r++)
+                a.m[r][c] = column[r];
+        }
+        return a;
+    }
+};
+
+
+/*
+One step of the compiled stack. Only the operations which can't be folded
+into an affine (gamma, clamps and maximum saturation) get stages of their
+own.
+*/
+struct ColorStackStage
+{
+    enum Kind { AFFINE, POWER, CLAMP, MAX_SATURATION };
+
+    Kind kind;
+    // AFFINE
+    float matrix[3][4];
+    bool diagonal;
+    // POWER: exponent per channel; MAX_SATURATION: saturation in [0]
+    float value[3];
+    // CLAMP: values below low become lowTo, above high become highTo
+    bool clampLow;
+    bool clampHigh;
+    float low[3];
+    float high[3];
+    float lowTo[3];
+    float highTo[3];
+};
+
+
+class DeepCColorStack : public DeepCWrapper
+{
+    int _stages[stageCount];
+
+    // grade
+    float blackpoint[3];
+    float whitepoint[3];
+    float black[3];
+    float white[3];
+    float multiply[3];
+    float add[3];
+    float gamma[3];
+    bool _reverse;
+    bool _blackClamp;
+    bool _whiteClamp;
+
+    // saturation
+    float _saturation;
+    int _mode;
+
+    // hue shift
+    double _hue;
+    double _hueSaturation;
+    double _hueValue;
+
+    // matrix
+    ConvolveArray _arrayKnob;
+    bool _invert;
+
+    // multiply and add
+    float _multiplyValue[3];
+    float _addValue[3];
+
+    // clamp
+    bool _minClamp;
+    bool _maxClamp;
+    bool _minClampTo;
+    bool _maxClampTo;
+    float minValue[3];
+    float maxValue[3];
+    float minClampToValue[3];
+    float maxClampToValue[3];
+
+    ChannelSet _brothers;
+
+    // the stack compiled in _validate
+    std::vector<ColorStackStage> _program;
+
+    void flushAffine(ColorAffine& pending);
+    void addPower(ColorAffine& pending, const float exponent[3]);
+    void addClamp(
+        ColorAffine& pending,
+        bool clampLow, const float low[3], const float lowTo[3],
+        bool clampHigh, const float high[3], const float highTo[3]
+        );
+    void compileGrade(ColorAffine& pending);
+    void compileSaturation(ColorAffine& pending);
+
+    public:
+
+        DeepCColorStack(Node* node) : DeepCWrapper(node),
+            _arrayKnob()
+        {
+            for (int i = 0; i < stageCount; i++)
+                _stages[i] = defaultStages[i];
+
+            for (int i=0; i<3; i++)
+            {
+                blackpoint[i] = 0.0f;
+                whitepoint[i] = 1.0f;
+                black[i] = 0.0f;
+                white[i] = 1.0f;
+                multiply[i] = 1.0f;
+                add[i] = 0.0f;
+                gamma[i] = 1.0f;
+
+                _multiplyValue[i] = 1.0f;
+                _addValue[i] = 0.0f;
+
+                minValue[i] = 0.0f;
+                minClampToValue[i] = 0.0f;
+                maxValue[i] = 1.0f;
+                maxClampToValue[i] = 1.0f;
+            }
+            _reverse = false;
+            _blackClamp = false;
+            _whiteClamp = false;
+
+            _saturation = 1.0f;
+            _mode = 0;
+
+            _hue = 0.0;
+            _hueSaturation = _hueValue = 1.0;
+
+            _invert = false;
+
+            // the stack has a clamp stage by default, so it must start out
+            // doing nothing
+            _minClamp = _maxClamp = false;
+            _minClampTo = _maxClampTo = false;
+
+            _brothers = Chan_Black;
+        }
+
+        void findNeededDeepChannels(ChannelSet& neededDeepChannels);
+        void _validate(bool);
+
+        virtual void wrappedPerSample(
+            Box::iterator it,
+            size_t sampleNo,
+            float alpha,
+            DeepPixel deepInPixel,
+            float &perSampleData,
+            Vector3 &sampleColor
+            );
+        virtual void wrappedPerChannel(
+            const float inputVal,
+            float perSampleData,
+            Channel z,
+            float& outData,
+            Vector3& sampleColor
+            );
+
+        virtual void wrappedPerBatch(DeepCSampleBatch& batch);
+
+        virtual void custom_knobs(Knob_Callback f);
+
+        static const Iop::Description d;
+        const char* Class() const { return d.name; }
+        virtual Op* op() { return this; }
+        const char* node_help() const;
+};
+
+
+void DeepCColorStack::findNeededDeepChannels(ChannelSet& neededDeepChannels)
+{
+    DeepCWrapper::findNeededDeepChannels(neededDeepChannels);
+
+    Channel firstChan;
+    firstChan = _processChannelSet.first();
+    _brothers = Chan_Black;
+    _brothers.addBrothers(firstChan, 3);
+    neededDeepChannels += _brothers;
+}
+
+
+void DeepCColorStack::flushAffine(ColorAffine& pending)
+{
+    if (pending.isIdentity())
+        return;
+
+    ColorStackStage stage;
+    stage.kind = ColorStackStage::AFFINE;
+    for (int r = 0; r < 3; r++)
+        for (int c = 0; c < 4; c++)
+            stage.matrix[r][c] = static_cast<float>(pending.m[r][c]);
+    stage.diagonal = pending.isDiagonal();
+    _program.push_back(stage);
+    pending.makeIdentity();
+}
+
+
+void DeepCColorStack::addPower(ColorAffine& pending, const float exponent[3])
+{
+    if (exponent[0] == 1.0f && exponent[1] == 1.0f && exponent[2] == 1.0f)
+        return;
+
+    flushAffine(pending);
+    ColorStackStage stage;
+    stage.kind = ColorStackStage::POWER;
+    for (int i = 0; i < 3; i++)
+        stage.value[i] = exponent[i];
+    _program.push_back(stage);
+}
+
+
+void DeepCColorStack::addClamp(
+    ColorAffine& pending,
+    bool clampLow, const float low[3], const float lowTo[3],
+    bool clampHigh, const float high[3], const float highTo[3]
+    )
+{
+    if (!clampLow && !clampHigh)
+        return;
+
+    flushAffine(pending);
+    ColorStackStage stage;
+    stage.kind = ColorStackStage::CLAMP;
+    stage.clampLow = clampLow;
+    stage.clampHigh = clampHigh;
+    for (int i = 0; i < 3; i++)
+    {
+        stage.low[i] = low[i];
+        stage.lowTo[i] = lowTo[i];
+        stage.high[i] = high[i];
+        stage.highTo[i] = highTo[i];
+    }
+    _program.push_back(stage);
+}
+
+
+/*
+Same coefficients as DeepCGrade: an affine ramp and a gamma, the other way
+round when reversed, then the black and white clamps.
+*/
+void DeepCColorStack::compileGrade(ColorAffine& pending)
+{
+    float A[3], B[3], G[3];
+    for (int i = 0; i < 3; i++) {
+        // make safe the gamma values
+        const float safeGamma = clamp(gamma[i], 0.00001f, 65500.0f);
+
+        A[i] = multiply[i] * ((white[i] - black[i]) / (whitepoint[i] - blackpoint[i]));
+        B[i] = add[i] + black[i] - A[i] * blackpoint[i];
+        G[i] = 1.0f / safeGamma;
+        if (_reverse)
+        {
+            // opposite linear ramp
+            if (A[i])
+            {
+                A[i] = 1.0f / A[i];
+            } else
+            {
+                A[i] = 1.0f;
+            }
+            B[i] = -B[i] * A[i];
+            // inverse gamma
+            G[i] = 1.0f/G[i];
+        }
+    }
+
+    ColorAffine ramp;
+    ramp.makeIdentity();
+    for (int i = 0; i < 3; i++)
+    {
+        ramp.m[i][i] = A[i];
+        ramp.m[i][3] = B[i];
+    }
+
+    if (_reverse)
+    {
+        addPower(pending, G);
+        pending.then(ramp);
+    } else
+    {
+        pending.then(ramp);
+        addPower(pending, G);
+    }
+
+    const float zero[3] = {0.0f, 0.0f, 0.0f};
+    const float one[3] = {1.0f, 1.0f, 1.0f};
+    addClamp(pending, _blackClamp, zero, zero, _whiteClamp, one, one);
+}
+
+
+/*
+out = in * s + luma * (1 - s). Every luminance mode but maximum is a
+weighted sum of rgb, so the whole thing is a matrix.
+*/
+void DeepCColorStack::compileSaturation(ColorAffine& pending)
+{
+    if (_mode == MAXIMUM)
+    {
+        flushAffine(pending);
+        ColorStackStage stage;
+        stage.kind = ColorStackStage::MAX_SATURATION;
+        stage.value[0] = _saturation;
+        _program.push_back(stage);
+        return;
+    }
+
+    double weights[3];
+    switch (_mode) {
+        case CCIR601:
+            weights[0] = 0.299;
+            weights[1] = 0.587;
+            weights[2] = 0.114;
+            break;
+        case AVERAGE:
+            weights[0] = weights[1] = weights[2] = 1.0 / 3.0;
+            break;
+        default:
+            weights[0] = y_convert_rec709(1.0f, 0.0f, 0.0f);
+            weights[1] = y_convert_rec709(0.0f, 1.0f, 0.0f);
+            weights[2] = y_convert_rec709(0.0f, 0.0f, 1.0f);
+            break;
+    }
+
+    ColorAffine saturation;
+    saturation.makeIdentity();
+    for (int r = 0; r < 3; r++)
+        for (int c = 0; c < 3; c++)
+            saturation.m[r][c] = (r == c ? _saturation : 0.0) + (1.0 - _saturation) * weights[c];
+    pending.then(saturation);
+}
+
+
+void DeepCColorStack::_validate(bool for_real)
+{
+    DeepCWrapper::_validate(for_real);
+
+    _program.clear();
+    ColorAffine pending;
+    pending.makeIdentity();
+
+    for (int s = 0; s < stageCount; s++)
+    {
+        switch (_stages[s])
+        {
+            case OP_GRADE:
+                compileGrade(pending);
+                break;
+            case OP_SATURATION:
+                compileSaturation(pending);
+                break;
+            case OP_HUESHIFT:
+            {
+                // as DeepCHueShift
+                Matrix3 rgbToYiq;
+                rgbToYiq.set(0.299f,    0.587f,  0.114f,
+                             0.596f,   -0.274f, -0.321f,
+                             0.211f,   -0.523f,  0.311f);
+                const Matrix3 yiqToRgb = rgbToYiq.inverse();
+                const double phi = _hue * M_PI / (double)180;
+                const double u = cos(phi);
+                const double w = sin(phi);
+                Matrix3 hsv;
+                hsv.set(_hueValue,              0.0f,                      0.0f,
+                        0.0f,     _hueValue * _hueSaturation * u,  -(_hueValue * _hueSaturation * w),
+                        0.0f,     _hueValue * _hueSaturation * w,    _hueValue * _hueSaturation * u);
+                pending.then(ColorAffine::fromMatrix3(yiqToRgb * hsv * rgbToYiq));
+                break;
+            }
+            case OP_MATRIX:
+            {
+                Matrix3 mtx;
+                mtx.set(_arrayKnob.array[0], _arrayKnob.array[1], _arrayKnob.array[2],
+                        _arrayKnob.array[3], _arrayKnob.array[4], _arrayKnob.array[5],
+                        _arrayKnob.array[6], _arrayKnob.array[7], _arrayKnob.array[8]);
+                if (_invert)
+                    mtx = mtx.inverse();
+                pending.then(ColorAffine::fromMatrix3(mtx));
+                break;
+            }
+            case OP_MULTIPLY:
+            {
+                ColorAffine scale;
+                scale.makeIdentity();
+                for (int i = 0; i < 3; i++)
+                    scale.m[i][i] = _multiplyValue[i];
+                pending.then(scale);
+                break;
+            }
+            case OP_ADD:
+            {
+                ColorAffine offset;
+                offset.makeIdentity();
+                for (int i = 0; i < 3; i++)
+                    offset.m[i][3] = _addValue[i];
+                pending.then(offset);
+                break;
+            }
+            case OP_CLAMP:
+            {
+                float lowTo[3], highTo[3];
+                for (int i = 0; i < 3; i++)
+                {
+                    lowTo[i] = _minClampTo ? minClampToValue[i] : minValue[i];
+                    highTo[i] = _maxClampTo ? maxClampToValue[i] : maxValue[i];
+                }
+                addClamp(pending, _minClamp, minValue, lowTo, _maxClamp, maxValue, highTo);
+                break;
+            }
+            default:
+                break;
+        }
+    }
+    flushAffine(pending);
+}
+
+
+/*
+The per-sample path runs the compiled program on one colour, so both paths
+agree.
+*/
+void DeepCColorStack::wrappedPerSample(
+    Box::iterator it,
+    size_t sampleNo,
+    float alpha,
+    DeepPixel deepInPixel,
+    float &perSampleData,
+    Vector3 &sampleColor
+    )
+{
+    ChannelSet available;
+    available = deepInPixel.channels();
+
+    foreach(z, _brothers) {
+        int cIndex = colourIndex(z);
+        if (cIndex >= 3)
+        {
+            continue;
+        }
+        if (available.contains(z))
+        {
+            sampleColor[cIndex] = deepInPixel.getUnorderedSample(sampleNo, z);
+            if (_unpremult)
+                sampleColor[cIndex] /= alpha;
+        }
+    }
+
+    for (size_t s = 0; s < _program.size(); s++)
+    {
+        const ColorStackStage& stage = _program[s];
+        float c[3] = {sampleColor[0], sampleColor[1], sampleColor[2]};
+        for (int i = 0; i < 3; i++)
+        {
+            switch (stage.kind)
+            {
+                case ColorStackStage::AFFINE:
+                    sampleColor[i] = stage.matrix[i][0] * c[0]
+                                     + stage.matrix[i][1] * c[1]
+                                     + stage.matrix[i][2] * c[2]
+                                     + stage.matrix[i][3];
+                    break;
+                case ColorStackStage::POWER:
+                    if (stage.value[i] != 1.0f)
+                        sampleColor[i] = deepc::simd::fastPow(c[i], stage.value[i]);
+                    break;
+                case ColorStackStage::CLAMP:
+                    if (stage.clampLow && c[i] < stage.low[i])
+                        sampleColor[i] = stage.lowTo[i];
+                    if (stage.clampHigh && c[i] > stage.high[i])
+                        sampleColor[i] = stage.highTo[i];
+                    break;
+                case ColorStackStage::MAX_SATURATION:
+                {
+                    const float luma = MAX(MAX(c[0], c[1]), c[2]);
+                    sampleColor[i] = c[i] * stage.value[0] + luma * (1.0f - stage.value[0]);
+                    break;
+                }
+            }
+        }
+    }
+}
+
+
+void DeepCColorStack::wrappedPerChannel(
+    const float inputVal,
+    float perSampleData,
+    Channel z,
+    float& outData,
+    Vector3& sampleColor
+    )
+{
+    int cIndex = colourIndex(z);
+    if (_brothers.contains(z) && cIndex < 3)
+        outData = sampleColor[cIndex];
+    else
+        outData = inputVal;
+}
+
+
+/*
+Batched version: the rgb of the whole row is gathered once, every stage of
+the program runs over it, and the results are scattered back to the lanes.
+*/
+void DeepCColorStack::wrappedPerBatch(DeepCSampleBatch& batch)
+{
+    static thread_local std::vector<float> rgb[3];
+    static thread_local std::vector<float> luma;
+
+    const size_t n = batch.size();
+    const float* alpha = batch.alpha();
+
+    // gather the colour: from our own lanes where we have them, as the
+    // wrapper has already unpremultiplied those
+    int laneOf[3] = {-1, -1, -1};
+    for (int lane = 0; lane < batch.lanes(); lane++)
+    {
+        const int cIndex = batch.colourIndex(lane);
+        if (cIndex < 3 && _brothers.contains(batch.channel(lane)))
+            laneOf[cIndex] = lane;
+    }
+    for (int k = 0; k < 3; k++)
+        rgb[k].resize(n);
+    foreach(z, _brothers) {
+        const int k = colourIndex(z);
+        if (k >= 3)
+            continue;
+        if (laneOf[k] >= 0)
+        {
+            const float* in = batch.in(laneOf[k]);
+            std::copy(in, in + n, rgb[k].begin());
+            continue;
+        }
+        const float* src = batch.source(z);
+        for (size_t i = 0; i < n; i++)
+        {
+            float v = src ? src[i] : 0.0f;
+            if (_unpremult)
+                v /= alpha[i];
+            rgb[k][i] = v;
+        }
+    }
+    float* r = rgb[0].data();
+    float* g = rgb[1].data();
+    float* b = rgb[2].data();
+
+    for (size_t s = 0; s < _program.size(); s++)
+    {
+        const ColorStackStage& stage = _program[s];
+        switch (stage.kind)
+        {
+            case ColorStackStage::AFFINE:
+                if (stage.diagonal)
+                {
+                    for (int k = 0; k < 3; k++)
+                        deepc::simd::affine(rgb[k].data(), rgb[k].data(), n,
+                                            stage.matrix[k][k], stage.matrix[k][3]);
+                    break;
+                }
+                for (size_t i = 0; i < n; i++)
+                {
+                    const float c0 = r[i];
+                    const float c1 = g[i];
+                    const float c2 = b[i];
+                    r[i] = stage.matrix[0][0] * c0 + stage.matrix[0][1] * c1 + stage.matrix[0][2] * c2 + stage.matrix[0][3];
+                    g[i] = stage.matrix[1][0] * c0 + stage.matrix[1][1] * c1 + stage.matrix[1][2] * c2 + stage.matrix[1][3];
+                    b[i] = stage.matrix[2][0] * c0 + stage.matrix[2][1] * c1 + stage.matrix[2][2] * c2 + stage.matrix[2][3];
+                }
+                break;
+            case ColorStackStage::POWER:
+                for (int k = 0; k < 3; k++)
+                {
+                    if (stage.value[k] != 1.0f)
+                        deepc::simd::power(rgb[k].data(), rgb[k].data(), n, stage.value[k]);
+                }
+                break;
+            case ColorStackStage::CLAMP:
+                for (int k = 0; k < 3; k++)
+                {
+                    float* c = rgb[k].data();
+                    for (size_t i = 0; i < n; i++)
+                    {
+                        float v = c[i];
+                        if (stage.clampLow && c[i] < stage.low[k])
+                            v = stage.lowTo[k];
+                        if (stage.clampHigh && c[i] > stage.high[k])
+                            v = stage.highTo[k];
+                        c[i] = v;
+                    }
+                }
+                break;
+            case ColorStackStage::MAX_SATURATION:
+            {
+                luma.resize(n);
+                for (size_t i = 0; i < n; i++)
+                    luma[i] = MAX(MAX(r[i], g[i]), b[i]);
+                const float saturation = stage.value[0];
+                for (int k = 0; k < 3; k++)
+                {
+                    float* c = rgb[k].data();
+                    for (size_t i = 0; i < n; i++)
+                        c[i] = c[i] * saturation + luma[i] * (1.0f - saturation);
+                }
+                break;
+            }
+        }
+    }
+
+    for (int lane = 0; lane < batch.lanes(); lane++)
+    {
+        const int cIndex = batch.colourIndex(lane);
+        const float* in = batch.in(lane);
+        float* out = batch.out(lane);
+        if (cIndex < 3 && _brothers.contains(batch.channel(lane)))
+            std::copy(rgb[cIndex].begin(), rgb[cIndex].end(), out);
+        else
+            std::copy(in, in + n, out);
+    }
+}
+
+
+void DeepCColorStack::custom_knobs(Knob_Callback f)
+{
+    BeginGroup(f, "stack");
+    for (int s = 0; s < stageCount; s++)
+    {
+        static const char* const names[stageCount] = {
+            "stage1", "stage2", "stage3", "stage4",
+            "stage5", "stage6", "stage7", "stage8"
+        };
+        static const char* const labels[stageCount] = {
+            "1", "2", "3", "4", "5", "6", "7", "8"
+        };
+        Enumeration_knob(f, &_stages[s], operationNames, names[s], labels[s]);
+        if (s % 4 == 0)
+            SetFlags(f, Knob::STARTLINE);
+        else
+            ClearFlags(f, Knob::STARTLINE);
+        Tooltip(f,
+            "Operations run in this order, each configured in its group "
+            "below. Neighbouring matrix, hue shift, saturation, multiply, "
+            "add and gammaless grade operations are combined into a single "
+            "matrix, so a whole chain costs about as much as one node."
+        );
+    }
+    EndGroup(f); // stack
+
+    BeginClosedGroup(f, "Grade");
+    Color_knob(f, blackpoint, IRange(-1, 1), "blackpoint", "blackpoint");
+    Tooltip(f, "This color is turned into black");
+    Color_knob(f, whitepoint, IRange(0, 4), "whitepoint", "whitepoint");
+    Tooltip(f, "This color is turned into white");
+    Color_knob(f, black, IRange(-1, 1), "black", "lift");
+    Tooltip(f, "Black is turned into this color");
+    Color_knob(f, white, IRange(0, 4), "white", "gain");
+    Tooltip(f, "White is turned into this color");
+    Color_knob(f, multiply, IRange(0, 4), "multiply", "multiply");
+    Tooltip(f, "Constant to multiply result by");
+    Color_knob(f, add, IRange(-1, 1), "add", "offset");
+    Tooltip(f, "Constant to add to result (raises both black & white, unlike lift)");
+    Color_knob(f, gamma, IRange(0.2, 5), "gamma", "gamma");
+    Tooltip(f, "Gamma correction applied to final result");
+    Bool_knob(f, &_reverse, "reverse");
+    SetFlags(f, Knob::STARTLINE);
+    Bool_knob(f, &_blackClamp, "black_clamp");
+    Bool_knob(f, &_whiteClamp, "white_clamp");
+    EndGroup(f); // Grade
+
+    BeginClosedGroup(f, "Saturation");
+    Float_knob(f, &_saturation, IRange(0, 4), "saturation");
+    Enumeration_knob(f, &_mode, mode_names, "_mode", "luminance math");
+    Tooltip(f, "Choose a mode to apply the greyscale conversion.");
+    EndGroup(f); // Saturation
+
+    BeginClosedGroup(f, "Hue Shift");
+    Double_knob(f, &_hue, IRange(-180, 180), "hue", "hue");
+    Tooltip(f, "Rotate the hue of the image. The value is in degree.");
+    Double_knob(f, &_hueSaturation, "hue_saturation", "saturation");
+    Tooltip(f, "Scale the saturation only.");
+    Double_knob(f, &_hueValue, "hue_value", "value");
+    Tooltip(f, "Scale the brightness only.");
+    EndGroup(f); // Hue Shift
+
+    BeginClosedGroup(f, "Matrix");
+    Array_knob(f, &_arrayKnob, 3, 3, "matrix");
+    Tooltip(f, "Output red is the first row multiplied by the input rgb.\n"
+               "Output green is the second row multiplied by the input rgb.\n"
+               "Output blue is the third row multiplied by the input rgb.\n");
+    Bool_knob(f, &_invert, "invert", "invert");
+    Tooltip(f, "Use the inverse of the matrix.");
+    EndGroup(f); // Matrix
+
+    BeginClosedGroup(f, "Multiply / Add");
+    Color_knob(f, _multiplyValue, IRange(0, 5), "multiply_value", "multiply");
+    Color_knob(f, _addValue, IRange(0, 5), "add_value", "add");
+    EndGroup(f); // Multiply / Add
+
+    BeginClosedGroup(f, "Clamp");
+    Color_knob(f, minValue, IRange(0, 1), "minimum", "minimum");
+    Bool_knob(f, &_minClamp, "minimum_enable", "enable");
+    Color_knob(f, maxValue, IRange(0, 1), "maximum", "maximum");
+    Bool_knob(f, &_maxClamp, "maximum_enable", "enable");
+    Color_knob(f, minClampToValue, IRange(0, 1), "MinClampTo", "MinClampTo");
+    Bool_knob(f, &_minClampTo, "MinClampTo_enable", "enable");
+    Color_knob(f, maxClampToValue, IRange(0, 1), "MaxClampTo", "MaxClampTo");
+    Bool_knob(f, &_maxClampTo, "MaxClampTo_enable", "enable");
+    EndGroup(f); // Clamp
+}
+
+
+const char* DeepCColorStack::node_help() const
+{
+    return
+    "Runs a stack of DeepC colour operations - grade, saturation, hue "
+    "shift, matrix, multiply, add and clamp - in a single pass over the "
+    "deep data, instead of one pass per node. The linear operations are "
+    "combined into one matrix before rendering.";
+}
+
+
+static Op* build(Node* node) { return new DeepCColorStack(node); }
+const Op::Description DeepCColorStack::d("DeepCColorStack", 0, build);
@@ -6,6 +6,10 @@ Falk Hofmann, 12/2021
 #include "DDImage/Iop.h"
 #include "DDImage/DeepFilterOp.h"
 #include "DDImage/Knobs.h"
+#include "DeepCVirtualConstant.h"
+
+#include <cstring>
+#include <vector>
 
 static const char* CLASS = "DeepCConstant";
 static const char* const enumAlphaTypes[] = { "uniform", "additive", "multiplicative", 0 };
@@ -26,6 +30,7 @@ class DeepCConstant : public DeepFilterOp
     Vector4 _values_front;
     Vector4 _values_back;
     int _alphaType;
+    bool _virtualConstant;
 
 public:
 
@@ -41,6 +46,7 @@ public:
         _sampleDistance = 1.0f;
         channels = Mask_RGBA;
         _alphaType = 2;
+        _virtualConstant = true;
         for (int n = 0; n < 4; n++) {
             _values_front[n] = _values_back[n] = 0.0f;
             color_front[n] = 0.2f;
@@ -92,6 +98,10 @@ void DeepCConstant::knobs(Knob_Callback f)
     Tooltip(f, "Amount of deep samples per pixel.");
     SetRange(f, 2, 1000);
     SetFlags(f, Knob::NO_ANIMATION);
+    Bool_knob(f, &_virtualConstant, deepc::virtualConstantKnobName, "virtual constant");
+    SetFlags(f, Knob::STARTLINE);
+    Tooltip(f, "Let downstream DeepC nodes read a single pixel of this constant and reuse it, "
+        "instead of asking for a full plane of identical pixels.");
 
 }
 
@@ -139,23 +149,34 @@ void DeepCConstant::_validate(bool for_real)
     _sampleDistance = _overallDepth / (_samples);
     DeepCConstant::calcValues(knob("color_front"), _values_front);
     DeepCConstant::calcValues(knob("color_back"), _values_back);
+    _values_front[3] = (_values_front[3] <= 0.0) ? 0.000001 : _values_front[3];
+    _values_back[3] = (_values_back[3] <= 0.0) ? 0.000001 : _values_back[3];
 }
 
+/*
+Every pixel is the same, so the samples are worked out for the first pixel
+only and copied to the rest of the box as one block.
+*/
 bool DeepCConstant::doDeepEngine(DD::Image::Box box, const DD::Image::ChannelSet& channels, DeepOutputPlane& plane)
 {
     int saveSample = (_samples > 0) ? _samples : 1;
-    _values_front[3] = (_values_front[3] <= 0.0) ? 0.000001 : _values_front[3];
-    _values_back[3] = (_values_back[3] <= 0.0) ? 0.000001 : _values_back[3];
 
     DeepInPlaceOutputPlane outPlane(channels, box, DeepPixel::eZDescending);
-    outPlane.reserveSamples(box.area());
+    outPlane.reserveSamples(box.area() * saveSample);
 
+    static thread_local std::vector<float> pixelTemplate;
+    bool haveTemplate = false;
     for (Box::iterator it = box.begin();
         it != box.end();
         it++) {
 
         outPlane.setSampleCount(it, saveSample);
         DeepOutputPixel out = outPlane.getPixel(it);
+        if (haveTemplate) {
+            memcpy(out.getWritableUnorderedSample(0), pixelTemplate.data(), pixelTemplate.size() * sizeof(float));
+            continue;
+        }
+
         for (int sampleNo = 0; sampleNo < saveSample; sampleNo++) {
 
             float depth = _sampleDistance * sampleNo;
@@ -179,6 +200,11 @@ bool DeepCConstant::doDeepEngine(DD::Image::Box box, const DD::Image::ChannelSet
                 }
             }
         }
+
+        // a pixel's samples are stored back to back
+        const float* first = out.getWritableUnorderedSample(0);
+        pixelTemplate.assign(first, first + static_cast<size_t>(saveSample) * channels.size());
+        haveTemplate = true;
     }
     mFnAssert(outPlane.isComplete());
     plane = outPlane;
@@ -0,0 +1,79 @@
+// SPDX-License-Identifier: MIT
+//
+// ============================================================================
+//
+//  DeepCCropPlane — copy a deep plane, emptying pixels outside a crop box
+//
+//  The crop box is worked out per row rather than per pixel: rows outside
+//  it are emptied without looking at the input, and inside a row only the
+//  columns between the crop edges are copied, one whole pixel at a time
+//  through a DeepChannelPlan.
+//
+//  Used by DeepCAdjustBBox and DeepCCopyBBox.
+//
+// ============================================================================
+
+#ifndef DEEPC_CROP_PLANE_H
+#define DEEPC_CROP_PLANE_H
+
+#include "DDImage/Box.h"
+#include "DDImage/ChannelSet.h"
+#include "DDImage/DeepPlane.h"
+
+#include "DeepChannelPlan.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace deepc {
+
+// Copy channels of in over box into plane. Pixels are kept where
+// crop[0] <= x < crop[2] and crop[1] <= y < crop[3], and empty elsewhere.
+inline void cropPlane(const DD::Image::DeepPlane& in, const DD::Image::Box& box,
+                      const DD::Image::ChannelSet& channels, const float crop[4],
+                      DD::Image::DeepOutputPlane& plane)
+{
+    DD::Image::DeepInPlaceOutputPlane outPlane(channels, box);
+    outPlane.reserveSamples(in.getTotalSampleCount());
+
+    static thread_local DeepChannelPlan channelPlan;
+    channelPlan.reset(in.channels(), channels);
+
+    // integer x and y lie inside the crop box from these up to, but not
+    // including, the far edges
+    const int cropX = static_cast<int>(std::max(std::ceil(crop[0]), static_cast<float>(box.x())));
+    const int cropY = static_cast<int>(std::max(std::ceil(crop[1]), static_cast<float>(box.y())));
+    const int cropR = static_cast<int>(std::min(std::ceil(crop[2]), static_cast<float>(box.r())));
+    const int cropT = static_cast<int>(std::min(std::ceil(crop[3]), static_cast<float>(box.t())));
+
+    for (int y = box.y(); y < box.t(); y++)
+    {
+        const bool rowInside = y >= cropY && y < cropT && cropX < cropR;
+        if (!rowInside)
+        {
+            for (int x = box.x(); x < box.r(); x++)
+                outPlane.setSampleCount(y, x, 0);
+            continue;
+        }
+
+        for (int x = box.x(); x < cropX; x++)
+            outPlane.setSampleCount(y, x, 0);
+        for (int x = cropX; x < cropR; x++)
+        {
+            DD::Image::DeepPixel inPixel = in.getPixel(y, x);
+            outPlane.setSampleCount(y, x, inPixel.getSampleCount());
+            DD::Image::DeepOutputPixel outPixel = outPlane.getPixel(y, x);
+            channelPlan.copyPixel(inPixel, outPixel);
+        }
+        for (int x = cropR; x < box.r(); x++)
+            outPlane.setSampleCount(y, x, 0);
+    }
+
+    outPlane.reviseSamples();
+    mFnAssert(outPlane.isComplete());
+    plane = outPlane;
+}
+
+} // namespace deepc
+
+#endif // DEEPC_CROP_PLANE_H
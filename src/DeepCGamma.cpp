@@ -1,4 +1,7 @@
 #include "DeepCWrapper.h"
+#include "DeepCSimd.h"
+
+#include <algorithm>
 
 using namespace DD::Image;
 
@@ -25,6 +28,8 @@ class DeepCGamma : public DeepCWrapper
             Vector3& sampleColor
             );
 
+        virtual void wrappedPerBatch(DeepCSampleBatch& batch);
+
         virtual void custom_knobs(Knob_Callback f);
 
         static const Iop::Description d;
@@ -57,6 +62,30 @@ void DeepCGamma::wrappedPerChannel(
 }
 
 
+/*
+Batched version of wrappedPerChannel, working on a whole row of samples at
+once.
+*/
+void DeepCGamma::wrappedPerBatch(DeepCSampleBatch& batch)
+{
+    const size_t n = batch.size();
+    for (int lane = 0; lane < batch.lanes(); lane++)
+    {
+        const float* in = batch.in(lane);
+        float* out = batch.out(lane);
+        const float g = value[batch.colourIndex(lane)];
+        if (g != 1.0)
+        {
+            const float e = 1.0f / clamp(g, 0.00001f, 65500.0f);
+            deepc::simd::power(in, out, n, e);
+        } else
+        {
+            std::copy(in, in + n, out);
+        }
+    }
+}
+
+
 void DeepCGamma::custom_knobs(Knob_Callback f)
 {
     Color_knob(f, value, IRange(0.2, 5), "value", "value");
@@ -1,4 +1,5 @@
 #include "DeepCWrapper.h"
+#include "DeepCSimd.h"
 
 using namespace DD::Image;
 
@@ -54,6 +55,8 @@ class DeepCGrade : public DeepCWrapper
             Vector3& sampleColor
             );
 
+        virtual void wrappedPerBatch(DeepCSampleBatch& batch);
+
         virtual void custom_knobs(Knob_Callback f);
 
         static const Iop::Description d;
@@ -126,6 +129,40 @@ void DeepCGrade::wrappedPerChannel(
 }
 
 
+/*
+Batched version of wrappedPerChannel, working on a whole row of samples at
+once.
+*/
+void DeepCGrade::wrappedPerBatch(DeepCSampleBatch& batch)
+{
+    const size_t n = batch.size();
+    for (int lane = 0; lane < batch.lanes(); lane++)
+    {
+        const float* in = batch.in(lane);
+        float* out = batch.out(lane);
+        const int cIndex = batch.colourIndex(lane);
+        if (_reverse)
+        {
+            // opposite gamma, precomputed, then the inverse linear ramp
+            if (G[cIndex] != 1.0f)
+            {
+                deepc::simd::power(in, out, n, G[cIndex]);
+                deepc::simd::affine(out, out, n, A[cIndex], B[cIndex]);
+            } else
+            {
+                deepc::simd::affine(in, out, n, A[cIndex], B[cIndex]);
+            }
+        } else
+        {
+            deepc::simd::affine(in, out, n, A[cIndex], B[cIndex]);
+            if (G[cIndex] != 1.0f)
+                deepc::simd::power(out, out, n, G[cIndex]);
+        }
+        deepc::simd::clampRange(out, n, _blackClamp, 0.0f, _whiteClamp, 1.0f);
+    }
+}
+
+
 void DeepCGrade::custom_knobs(Knob_Callback f)
 {
     Color_knob(f, blackpoint, IRange(-1, 1), "blackpoint", "blackpoint");
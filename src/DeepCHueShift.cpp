@@ -44,6 +44,8 @@ public:
             Vector3& sampleColor
             );
 
+        virtual void wrappedPerBatch(DeepCSampleBatch& batch);
+
 
         void _validate(bool);
         virtual void custom_knobs(Knob_Callback f);
@@ -127,6 +129,47 @@ void DeepCHueShift::wrappedPerChannel(
 }
 
 
+/*
+Batched version of wrappedPerChannel, working on a whole row of samples at
+once.
+*/
+void DeepCHueShift::wrappedPerBatch(DeepCSampleBatch& batch)
+{
+    const size_t n = batch.size();
+    const float* alpha = batch.alpha();
+
+    const float* rgb[3] = {NULL, NULL, NULL};
+    foreach(z, _brothers) {
+        int cIndex = colourIndex(z);
+        if (cIndex >= 3)
+        {
+            continue;
+        }
+        rgb[cIndex] = batch.source(z);
+    }
+
+    // the three transforms only need composing once per batch
+    const Matrix3 mtx = mtx_yiq_to_rgb * mtx_hsv * mtx_rgb_to_yiq;
+
+    for (size_t i = 0; i < n; i++)
+    {
+        Vector3 sampleColor(0.0f, 0.0f, 0.0f);
+        for (int k = 0; k < 3; k++)
+        {
+            if (rgb[k] && alpha[i] != 0.0f)
+                sampleColor[k] = rgb[k][i] / alpha[i];
+        }
+        sampleColor = mtx.transform(sampleColor);
+
+        for (int lane = 0; lane < batch.lanes(); lane++)
+        {
+            const int cIndex = batch.colourIndex(lane);
+            batch.out(lane)[i] = cIndex < 3 ? sampleColor[cIndex] : batch.in(lane)[i];
+        }
+    }
+}
+
+
 void DeepCHueShift::custom_knobs(Knob_Callback f)
 {
     Double_knob(f, &_hue, IRange(-180, 180), "hue", "hue");
@@ -1,5 +1,11 @@
 #include "DeepCMWrapper.h"
 
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
 using namespace DD::Image;
 
 static const char *const sampleId[] = {"closest", "furthest", 0};
@@ -16,6 +22,188 @@ enum
     LINEAR
 };
 
+/*
+The IDs of a multi-ID DeepCID, split into groups. Groups are separated by ';'
+or new lines, IDs within a group by commas or spaces, and "a-b" is the range
+of whole numbers from a to b. With a tolerance of at most 0.5 and whole
+number IDs (the usual case for ID passes) a sample can only match its nearest
+whole number, so lookups go through an open-addressing hash table; otherwise
+the IDs are kept sorted and searched for the ones within tolerance.
+*/
+class DeepCIDSet
+{
+    public:
+        DeepCIDSet() : _groups(0), _tolerance(0.0f), _hashed(false), _mask(0) {}
+
+        // parse text into groups of IDs; false, with a message, if it can't
+        bool parse(const char* text, std::string& message)
+        {
+            _entries.clear();
+            _groups = 0;
+            if (text == NULL)
+                return true;
+
+            bool groupOpen = false;
+            const char* c = text;
+            while (*c)
+            {
+                if (*c == ';' || *c == '\n')
+                {
+                    if (groupOpen)
+                        _groups++;
+                    groupOpen = false;
+                    c++;
+                    continue;
+                }
+                if (*c == ',' || *c == ' ' || *c == '\t' || *c == '\r')
+                {
+                    c++;
+                    continue;
+                }
+
+                char* end;
+                const double first = strtod(c, &end);
+                if (end == c)
+                {
+                    message = std::string("can't read the id list at \"") + c + "\"";
+                    return false;
+                }
+                c = end;
+                double last = first;
+                if (*c == '-')
+                {
+                    last = strtod(c + 1, &end);
+                    if (end == c + 1 || first != floor(first) || last != floor(last) || last < first)
+                    {
+                        message = "id ranges need whole numbers, lowest first";
+                        return false;
+                    }
+                    c = end;
+                }
+                if (last - first >= MAX_IDS || _entries.size() + (last - first) >= MAX_IDS)
+                {
+                    message = "too many ids in the id list";
+                    return false;
+                }
+                for (double id = first; id <= last; id++)
+                {
+                    Entry entry = { static_cast<float>(id), _groups };
+                    _entries.push_back(entry);
+                }
+                groupOpen = true;
+            }
+            if (groupOpen)
+                _groups++;
+            return true;
+        }
+
+        // build the lookup for a tolerance
+        void prepare(float tolerance)
+        {
+            _tolerance = tolerance;
+
+            // an id listed in more than one group belongs to the first
+            std::stable_sort(_entries.begin(), _entries.end(), byValue);
+            _entries.erase(std::unique(_entries.begin(), _entries.end(), sameValue), _entries.end());
+
+            _hashed = tolerance <= 0.5f;
+            for (size_t i = 0; i < _entries.size() && _hashed; i++)
+                _hashed = isWhole(_entries[i].value);
+
+            _keys.clear();
+            _slotGroup.clear();
+            _mask = 0;
+            if (!_hashed)
+                return;
+
+            size_t capacity = 16;
+            while (capacity < _entries.size() * 2)
+                capacity *= 2;
+            _mask = capacity - 1;
+            _keys.assign(capacity, static_cast<long long>(EMPTY));
+            _slotGroup.assign(capacity, 0);
+            for (size_t i = 0; i < _entries.size(); i++)
+            {
+                const long long key = static_cast<long long>(_entries[i].value);
+                size_t slot = hash(key) & _mask;
+                while (_keys[slot] != EMPTY)
+                    slot = (slot + 1) & _mask;
+                _keys[slot] = key;
+                _slotGroup[slot] = _entries[i].group;
+            }
+        }
+
+        int groups() const { return _groups; }
+
+        // mattes[g * n + i] = 1 where ids[i] matches an ID of group g; the
+        // caller zeroes mattes, groups() * n floats
+        void match(const float* ids, size_t n, float* mattes) const
+        {
+            if (_entries.empty())
+                return;
+            for (size_t i = 0; i < n; i++)
+            {
+                const float id = ids[i];
+                if (_hashed)
+                {
+                    const float nearest = floorf(id + 0.5f);
+                    if (!isWhole(nearest) || !(fabsf(id - nearest) < _tolerance))
+                        continue;
+                    const long long key = static_cast<long long>(nearest);
+                    for (size_t slot = hash(key) & _mask; _keys[slot] != EMPTY; slot = (slot + 1) & _mask)
+                    {
+                        if (_keys[slot] == key)
+                        {
+                            mattes[_slotGroup[slot] * n + i] = 1.0f;
+                            break;
+                        }
+                    }
+                } else
+                {
+                    const Entry low = { id - _tolerance, 0 };
+                    std::vector<Entry>::const_iterator entry =
+                        std::upper_bound(_entries.begin(), _entries.end(), low, byValue);
+                    for (; entry != _entries.end() && entry->value < id + _tolerance; ++entry)
+                    {
+                        if (fabsf(id - entry->value) < _tolerance)
+                            mattes[entry->group * n + i] = 1.0f;
+                    }
+                }
+            }
+        }
+
+    private:
+        struct Entry
+        {
+            float value;
+            int group;
+        };
+
+        static constexpr long long EMPTY = -0x7fffffffffffffffLL - 1;
+        static constexpr double MAX_IDS = 1 << 20;
+
+        static bool byValue(const Entry& a, const Entry& b) { return a.value < b.value; }
+        static bool sameValue(const Entry& a, const Entry& b) { return a.value == b.value; }
+        // whole and well inside the range of a long long
+        static bool isWhole(float value) { return value == floorf(value) && fabsf(value) < 1e18f; }
+        static size_t hash(long long key)
+        {
+            unsigned long long h = static_cast<unsigned long long>(key);
+            h ^= h >> 33;
+            h *= 0xff51afd7ed558ccdULL;
+            h ^= h >> 33;
+            return static_cast<size_t>(h);
+        }
+
+        std::vector<Entry> _entries;
+        int _groups;
+        float _tolerance;
+        bool _hashed;
+        std::vector<long long> _keys;
+        std::vector<int> _slotGroup;
+        size_t _mask;
+};
+
 class DeepCID : public DeepCMWrapper
 {
     // const char* _auxChannelKnobName;
@@ -26,6 +214,14 @@ class DeepCID : public DeepCMWrapper
     int _sampleId;
     Vector2 _pick;
 
+    bool _multiId;
+    const char* _idList;
+    // built from _idList in _validate
+    DeepCIDSet _idSet;
+    // the group of each output channel, its place in _processChannelSet,
+    // indexed by channel; built in _validate
+    std::vector<int> _channelGroup;
+
 public:
     DeepCID(Node *node) : DeepCMWrapper(node), _auxChannel(Chan_Black), _deepID(0.0f), _tolerance(0.5f)
     {
@@ -33,6 +229,8 @@ public:
         _pick.x = _pick.y = 0.0;
         _sampleId = 0;
         _deepID = 0.0f;
+        _multiId = false;
+        _idList = "";
     }
 
         virtual void wrappedPerSample(
@@ -43,6 +241,7 @@ public:
             float &perSampleData,
             Vector3& sampleColor
             );
+        virtual void wrappedPerBatch(DeepCSampleBatch& batch);
 
         virtual void _validate(bool for_real);
         virtual void top_knobs(Knob_Callback f);
@@ -60,6 +259,26 @@ void DeepCID::_validate(bool for_real)
     _auxiliaryChannelSet = Chan_Black;
     _auxiliaryChannelSet += _auxChannel;
     DeepCMWrapper::_validate(for_real);
+
+    if (_multiId)
+    {
+        std::string message;
+        if (!_idSet.parse(_idList, message))
+        {
+            error("%s", message.c_str());
+            return;
+        }
+        _idSet.prepare(_tolerance);
+    }
+
+    _channelGroup.clear();
+    int group = 0;
+    foreach(z, _processChannelSet)
+    {
+        if (_channelGroup.size() <= static_cast<size_t>(z))
+            _channelGroup.resize(z + 1, -1);
+        _channelGroup[z] = group++;
+    }
 }
 
 void DeepCID::wrappedPerSample(
@@ -97,6 +316,60 @@ void DeepCID::wrappedPerSample(
     }
 }
 
+/*
+Batched version of wrappedPerSample and wrappedPerChannel. With an id list,
+the n'th output channel gets the matte of the n'th group, or every output
+channel gets the one matte if there is only one group. Lanes only hold the
+output channels requested, so a lane's group comes from its channel rather
+than its place among the lanes.
+*/
+void DeepCID::wrappedPerBatch(DeepCSampleBatch& batch)
+{
+    static thread_local std::vector<float> ids, mattes, none;
+
+    const size_t n = batch.size();
+    const int groups = _multiId ? MAX(_idSet.groups(), 1) : 1;
+    mattes.assign(n * groups, 0.0f);
+
+    const float* source = batch.source(_auxChannel);
+    if (source != NULL)
+    {
+        ids.resize(n);
+        const float* alpha = batch.alpha();
+        for (size_t i = 0; i < n; i++)
+            ids[i] = _unpremultPosition ? source[i] / alpha[i] : source[i];
+
+        if (_multiId)
+        {
+            _idSet.match(ids.data(), n, mattes.data());
+        } else
+        {
+            for (size_t i = 0; i < n; i++)
+                mattes[i] = fabs(ids[i] - _deepID) < _tolerance ? 1.0f : 0.0f;
+        }
+    }
+
+    for (int lane = 0; lane < batch.lanes(); lane++)
+    {
+        const float* matte = mattes.data();
+        if (groups > 1)
+        {
+            const size_t z = static_cast<size_t>(batch.channel(lane));
+            const int group = z < _channelGroup.size() ? _channelGroup[z] : -1;
+            if (group >= 0 && group < groups)
+            {
+                matte += group * n;
+            } else
+            {
+                // more output channels than groups: the rest match nothing
+                none.assign(n, 0.0f);
+                matte = none.data();
+            }
+        }
+        applyOperation(batch.in(lane), matte, batch.out(lane), n);
+    }
+}
+
 void DeepCID::top_knobs(Knob_Callback f)
 {
     // _auxiliaryChannelSet is actually a channel in this case, but they mostly
@@ -129,10 +402,26 @@ void DeepCID::custom_knobs(Knob_Callback f)
     Tooltip(f, "Actual Deep ID to use for mask creation.");
     Float_knob(f, &_tolerance, "tolerance");
     Tooltip(f, "Tolerance to use for mask separation between values.");
+    Bool_knob(f, &_multiId, "multi_id", "use id list");
+    Tooltip(f, "Match every ID in the id list instead of the single id above.");
+    Multiline_String_knob(f, &_idList, "id_list", "id list", 4);
+    Tooltip(f, "IDs to match, separated by commas or spaces, with a-b for a "
+    "range of whole numbers, e.g. \"3, 7, 100-140\".\n\n"
+    "Separate several groups with ';' or new lines to make one matte per "
+    "group: the first output channel gets the first group, the second "
+    "output channel the second group and so on. With a single group every "
+    "output channel gets the same matte.");
 }
 
 int DeepCID::knob_changed(Knob *k)
 {
+    if (k->is("multi_id") || k == &Knob::showPanel)
+    {
+        knob("id")->enable(!_multiId);
+        knob("id_list")->enable(_multiId);
+        if (k->is("multi_id"))
+            return 1;
+    }
     if (k->is("id_pick"))
     {
         input0()->validate(true);
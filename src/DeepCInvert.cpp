@@ -22,6 +22,8 @@ class DeepCInvert : public DeepCWrapper
             Vector3& sampleColor
             );
 
+        virtual void wrappedPerBatch(DeepCSampleBatch& batch);
+
         virtual void custom_knobs(Knob_Callback f);
 
         static const Iop::Description d;
@@ -48,6 +50,28 @@ void DeepCInvert::wrappedPerChannel(
 }
 
 
+/*
+Batched version of wrappedPerChannel, working on a whole row of samples at
+once.
+*/
+void DeepCInvert::wrappedPerBatch(DeepCSampleBatch& batch)
+{
+    const size_t n = batch.size();
+    for (int lane = 0; lane < batch.lanes(); lane++)
+    {
+        const float* in = batch.in(lane);
+        float* out = batch.out(lane);
+        for (size_t i = 0; i < n; i++)
+            out[i] = 1 - in[i];
+        if (_clamp)
+        {
+            for (size_t i = 0; i < n; i++)
+                out[i] = clamp(out[i], 0.0, 1.0);
+        }
+    }
+}
+
+
 void DeepCInvert::custom_knobs(Knob_Callback f)
 {
     Bool_knob(f, &_clamp, "clamp", "clamp");
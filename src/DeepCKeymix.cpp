@@ -4,6 +4,15 @@
 #include "DDImage/Knobs.h"
 #include "DDImage/Row.h"
 
+#include "DeepCSideMask.h"
+#include "DeepChannelPlan.h"
+#include "DeepSampleOptimizer.h"
+#include "DeepCVirtualConstant.h"
+
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+
 static const char *CLASS = "DeepCKeymix";
 static const char *HELP = "A Keymix node to use withing a deep stream. Mimics the 2d KeyMix node in controls and behavior.\n\n"
                           "Falk Hofmann 12/2021";
@@ -11,6 +20,7 @@ static const char *HELP = "A Keymix node to use withing a deep stream. Mimics th
 using namespace DD::Image;
 
 static const char *const bbox_names[] = {"union", "B\tB side", "A\tA side", nullptr};
+static const char *const merge_names[] = {"concatenate", "depth sort", nullptr};
 
 class DeepCKeymix : public DeepFilterOp
 {
@@ -28,11 +38,28 @@ class DeepCKeymix : public DeepFilterOp
     };
     int bbox_type;
 
+    enum
+    {
+        CONCATENATE,
+        DEPTH_SORT
+    };
+    int mergeMode;
+    float collapseTolerance;
+
+    // samples seen and written since the last validate, for the statistics
+    std::atomic<long long> _samplesA;
+    std::atomic<long long> _samplesB;
+    std::atomic<long long> _samplesOut;
+    const char *_statText;
+    char _statBuf[256];
+
 protected:
     Iop *_maskOp;
     DeepOp *_aOp;
     DeepOp *_bOp;
     bool _bypass;
+    // A is the same at every pixel, so one pixel of it is read per engine
+    bool _aConstant;
 
 public:
     DeepCKeymix(Node *node) : DeepFilterOp(node)
@@ -41,9 +68,16 @@ public:
 
         _processChannelSet = Mask_All;
         maskChannel = Chan_Alpha;
-        invertMask = _bypass = false;
+        invertMask = _bypass = _aConstant = false;
         mix = 1;
         bbox_type = UNION;
+        mergeMode = CONCATENATE;
+        collapseTolerance = 0.0f;
+        _samplesA = 0;
+        _samplesB = 0;
+        _samplesOut = 0;
+        _statText = _statBuf;
+        _statBuf[0] = 0;
     }
 
     const char *node_help() const override { return HELP; }
@@ -89,13 +123,75 @@ public:
         Tooltip(f, "Dissolve between B-only at 0 and the full keymix at 1");
         Enumeration_knob(f, &bbox_type, bbox_names, "bbox", "Set BBox to");
         Tooltip(f, "Clip one input to match the other if wanted");
+
+        Divider(f, "");
+        Enumeration_knob(f, &mergeMode, merge_names, "merge_mode", "partial mask");
+        Tooltip(f, "How A and B are combined where the mask is between 0 and 1.\n\n"
+                   "concatenate: every B sample followed by every A sample, unordered.\n"
+                   "depth sort: A and B are merged by depth; coincident samples "
+                   "(such as the same surface in both inputs) are collapsed into one "
+                   "and the result is sorted front to back.");
+        Float_knob(f, &collapseTolerance, "collapse_tolerance", "collapse tolerance");
+        SetRange(f, 0.0f, 1.0f);
+        Tooltip(f, "In depth sort mode, samples whose fronts lie within this distance "
+                   "of each other are collapsed. At 0 only samples covering exactly "
+                   "the same depth range are collapsed.");
+        String_knob(f, &_statText, "stat_display", "samples");
+        SetFlags(f, Knob::DISABLED | Knob::OUTPUT_ONLY);
+        Tooltip(f, "Samples read from B and A and written out since the last change, "
+                   "and the growth of the output over B.");
+        Button(f, "update_stats", "Update Statistics");
+        ClearFlags(f, Knob::STARTLINE);
+    }
+
+    int knob_changed(Knob *k) override
+    {
+        if (k->is("merge_mode") || k == &Knob::showPanel)
+        {
+            knob("collapse_tolerance")->enable(mergeMode == DEPTH_SORT);
+            return 1;
+        }
+        if (k->is("update_stats"))
+        {
+            updateStatKnob();
+            return 1;
+        }
+        return DeepFilterOp::knob_changed(k);
+    }
+
+    void updateStatKnob()
+    {
+        const long long a = _samplesA.load(std::memory_order_relaxed);
+        const long long b = _samplesB.load(std::memory_order_relaxed);
+        const long long out = _samplesOut.load(std::memory_order_relaxed);
+
+        if (b > 0)
+            snprintf(_statBuf, sizeof(_statBuf), "B: %lld   A: %lld   Out: %lld   (%+.1f%% over B)",
+                     b, a, out, 100.0 * ((double)out / (double)b - 1.0));
+        else
+            snprintf(_statBuf, sizeof(_statBuf), "No samples processed yet - render to see statistics.");
+
+        Knob *k = knob("stat_display");
+        if (k)
+            k->set_text(_statBuf);
+    }
+
+    void _close() override
+    {
+        updateStatKnob();
+        DeepFilterOp::_close();
     }
 
     void _validate(bool for_real) override
     {
+        _samplesA.store(0, std::memory_order_relaxed);
+        _samplesB.store(0, std::memory_order_relaxed);
+        _samplesOut.store(0, std::memory_order_relaxed);
+
         _bypass = _processChannelSet.size() == 0 ? true : false;
 
         _aOp = dynamic_cast<DeepOp *>(Op::input(1));
+        _aConstant = false;
         _bOp = input0();
         _maskOp = dynamic_cast<Iop *>(Op::input(2));
 
@@ -109,6 +205,7 @@ public:
                 _aOp->validate(for_real);
                 _bOp->validate(for_real);
                 _maskOp->validate(for_real);
+                _aConstant = deepc::isVirtualConstant(_aOp->op());
 
                 DeepInfo infoA = _aOp->deepInfo();
                 DeepInfo infoB = _bOp->deepInfo();
@@ -152,7 +249,7 @@ public:
 
         if (_aOp != nullptr)
         {
-            requests.push_back(RequestData(_aOp, box, requestChannels, count));
+            requests.push_back(RequestData(_aOp, _aConstant ? deepc::virtualConstantBox(box) : box, requestChannels, count));
         }
         if (_maskOp != nullptr)
         {
@@ -160,6 +257,25 @@ public:
         }
     }
 
+    // add the samples of in to pool, every slot but the depths scaled by
+    // weight; pool rows use the output channel layout
+    static void addSamples(deepc::SamplePool &pool, const DeepPixel &in, const deepc::DeepChannelPlan &plan,
+                           const std::vector<int> &mixSlots, float weight, int frontSlot, int backSlot, int alphaSlot)
+    {
+        for (size_t sampleNo = 0, samples = in.getSampleCount(); sampleNo < samples; sampleNo++)
+        {
+            float *row = pool.add(0.0f, 0.0f, 0.0f);
+            plan.copySample(in.getUnorderedSample(sampleNo), row);
+            for (size_t i = 0; i < mixSlots.size(); i++)
+                row[mixSlots[i]] *= weight;
+
+            deepc::SampleHeader &header = pool.header(pool.size() - 1);
+            header.zFront = row[frontSlot];
+            header.zBack = backSlot >= 0 ? row[backSlot] : header.zFront;
+            header.alpha = alphaSlot >= 0 ? row[alphaSlot] : 0.0f;
+        }
+    }
+
     bool doDeepEngine(DD::Image::Box box, const ChannelSet &requestedChannels, DeepOutputPlane &plane) override
     {
 
@@ -176,6 +292,10 @@ public:
 
         DeepInPlaceOutputPlane outPlane(process, box);
         outPlane.reserveSamples(bPlane.getTotalSampleCount());
+
+        long long samplesA = 0;
+        long long samplesB = bPlane.getTotalSampleCount();
+        long long samplesOut = 0;
         if (_bypass)
         {
             for (Box::iterator it = box.begin(), itEnd = box.end(); it != itEnd; ++it)
@@ -183,6 +303,7 @@ public:
                 DeepPixel bPixel = bPlane.getPixel(it);
                 size_t inPixelSamples = bPixel.getSampleCount();
                 outPlane.setSampleCount(it, inPixelSamples);
+                samplesOut += inPixelSamples;
                 DeepOutputPixel outPixel = outPlane.getPixel(it);
                 size_t outSample = 0;
                 for (size_t sampleNo = 0; sampleNo < inPixelSamples; sampleNo++)
@@ -202,114 +323,155 @@ public:
         else
         {
             DeepPlane aPlane;
-            if (!_aOp->deepEngine(box, process, aPlane))
+            if (!_aOp->deepEngine(_aConstant ? deepc::virtualConstantBox(box) : box, process, aPlane))
                 return false;
+            samplesA = aPlane.getTotalSampleCount() * (_aConstant ? box.area() : 1);
+            DeepPixel constantA = aPlane.getPixel(box.y(), box.x());
 
             float maskVal;
-            int currentYRow;
-            Row maskRow(box.x(), box.r());
+            static thread_local deepc::SideMask sideMask;
+            if (!sideMask.fetch(*_maskOp, maskChannel, box, invertMask))
+                return false;
 
-            _maskOp->get(box.y(), box.x(), box.r(), maskChannel, maskRow);
-            currentYRow = box.y();
+            static thread_local deepc::DeepChannelPlan aPlan;
+            static thread_local deepc::DeepChannelPlan bPlan;
+            aPlan.reset(aPlane.channels(), process);
+            bPlan.reset(bPlane.channels(), process);
 
-            for (Box::iterator it = box.begin(), itEnd = box.end(); it != itEnd; ++it)
+            // output slots scaled when blending - everything but the depths
+            std::vector<int> mixSlots;
+            foreach (z, process)
             {
+                if (z != Chan_DeepFront && z != Chan_DeepBack)
+                    mixSlots.push_back(bPlan.slotOf(z));
+            }
 
-                if (currentYRow != it.y)
-                {
-                    _maskOp->get(it.y, box.x(), box.r(), maskChannel, maskRow);
-                    maskVal = maskRow[maskChannel][it.x];
-                    maskVal = clamp(maskVal, 0.0f, 1.0f);
-                    currentYRow = it.y;
-                }
-                else
+            // merging by depth needs to know where the samples are
+            const int frontSlot = bPlan.slotOf(Chan_DeepFront);
+            const int backSlot = bPlan.slotOf(Chan_DeepBack);
+            const int alphaSlot = bPlan.slotOf(Chan_Alpha);
+            const bool depthSort = mergeMode == DEPTH_SORT && frontSlot >= 0;
+            static thread_local deepc::SamplePool pool;
+
+            Box::iterator it = box.begin();
+            const Box::iterator itEnd = box.end();
+            while (it != itEnd)
+            {
+                const int currentYRow = it.y;
+
+                // fully masked rows are just B or A passed through
+                const bool allB = mix <= 0.0f || sideMask.rowAllZero(currentYRow);
+                const bool allA = !allB && mix >= 1.0f && sideMask.rowAllOne(currentYRow);
+                if (allB || allA)
                 {
-                    maskVal = clamp(maskRow[maskChannel][it.x], 0.0f, 1.0f);
+                    const deepc::DeepChannelPlan &plan = allB ? bPlan : aPlan;
+                    for (; it != itEnd && it.y == currentYRow; ++it)
+                    {
+                        DeepPixel pixel = allB ? bPlane.getPixel(it) : _aConstant ? constantA : aPlane.getPixel(it);
+                        outPlane.setSampleCount(it, pixel.getSampleCount());
+                        samplesOut += pixel.getSampleCount();
+                        DeepOutputPixel outPixel = outPlane.getPixel(it);
+                        plan.copyPixel(pixel, outPixel);
+                    }
+                    continue;
                 }
 
-                if (invertMask)
+                for (; it != itEnd && it.y == currentYRow; ++it)
                 {
-                    maskVal = 1.0f - maskVal;
-                }
+                    maskVal = sideMask.value(it.x, currentYRow);
 
-                DeepPixel aPixel = aPlane.getPixel(it);
-                DeepPixel bPixel = bPlane.getPixel(it);
+                    DeepPixel aPixel = _aConstant ? constantA : aPlane.getPixel(it);
+                    DeepPixel bPixel = bPlane.getPixel(it);
 
-                size_t inPixelSamples;
-                int aSampleNo = aPixel.getSampleCount();
-                int bSampleNo = bPixel.getSampleCount();
+                    size_t inPixelSamples;
+                    int aSampleNo = aPixel.getSampleCount();
+                    int bSampleNo = bPixel.getSampleCount();
 
-                if (maskVal == 0.0f)
-                {
-                    inPixelSamples = bSampleNo;
-                }
-                else if (maskVal * mix >= 1.0f)
-                {
-                    inPixelSamples = aSampleNo;
-                }
-                else
-                {
-                    if (mix > 0.0f)
+                    float mixing = maskVal * mix;
+                    if (depthSort && mixing > 0.0f && mixing < 1.0f)
                     {
-                        inPixelSamples = bSampleNo + aSampleNo;
+                        pool.reset(static_cast<int>(bPlan.size()));
+                        addSamples(pool, bPixel, bPlan, mixSlots, 1.0f - mixing, frontSlot, backSlot, alphaSlot);
+                        addSamples(pool, aPixel, aPlan, mixSlots, mixing, frontSlot, backSlot, alphaSlot);
+                        deepc::optimizeSamples(pool, collapseTolerance, 0.0f, 0);
+
+                        outPlane.setSampleCount(it, pool.size());
+                        samplesOut += pool.size();
+                        DeepOutputPixel outPixel = outPlane.getPixel(it);
+                        for (size_t sampleNo = 0; sampleNo < pool.size(); sampleNo++)
+                        {
+                            const deepc::SampleHeader &header = pool.header(sampleNo);
+                            float *outData = outPixel.getWritableUnorderedSample(sampleNo);
+                            memcpy(outData, pool.channels(sampleNo), bPlan.size() * sizeof(float));
+                            outData[frontSlot] = header.zFront;
+                            if (backSlot >= 0)
+                                outData[backSlot] = header.zBack;
+                        }
+                        continue;
                     }
-                    else
+
+                    if (maskVal == 0.0f)
                     {
                         inPixelSamples = bSampleNo;
                     }
-                }
-
-                outPlane.setSampleCount(it, inPixelSamples);
-
-                DeepOutputPixel outPixel = outPlane.getPixel(it);
-                ChannelSet aInPixelChannels = aPixel.channels();
-                ChannelSet bInPixelChannels = bPixel.channels();
-
-                float mixing = maskVal * mix;
-                for (size_t sampleNo = 0; sampleNo < inPixelSamples; sampleNo++)
-                {
-                    foreach (z, process)
+                    else if (maskVal * mix >= 1.0f)
                     {
-                        float &outData = outPixel.getWritableUnorderedSample(sampleNo, z);
-
-                        int cIndex = colourIndex(z);
-
-                        if ((mixing <= 0.0f))
+                        inPixelSamples = aSampleNo;
+                    }
+                    else
+                    {
+                        if (mix > 0.0f)
                         {
-                            outData = bPixel.getUnorderedSample(sampleNo, z);
+                            inPixelSamples = bSampleNo + aSampleNo;
                         }
-                        if ((mixing > 0.0f) && (mixing < 1.0f))
+                        else
                         {
-                            if ((z == Chan_DeepFront) || (z == Chan_DeepBack))
-                                continue;
+                            inPixelSamples = bSampleNo;
+                        }
+                    }
 
-                            float bInData = 0.0f;
+                    outPlane.setSampleCount(it, inPixelSamples);
+                    samplesOut += inPixelSamples;
+                    DeepOutputPixel outPixel = outPlane.getPixel(it);
 
+                    if (mixing <= 0.0f)
+                    {
+                        bPlan.copyPixel(bPixel, outPixel);
+                    }
+                    else if (mixing >= 1.0f)
+                    {
+                        aPlan.copyPixel(aPixel, outPixel);
+                    }
+                    else
+                    {
+                        // B samples fade out and A samples fade in; depths
+                        // are kept as they are
+                        for (size_t sampleNo = 0; sampleNo < inPixelSamples; sampleNo++)
+                        {
+                            float *outData = outPixel.getWritableUnorderedSample(sampleNo);
+                            float weight;
                             if (sampleNo < bSampleNo)
                             {
-                                bInData = bInPixelChannels.contains(z)
-                                              ? bPixel.getUnorderedSample(sampleNo, z)
-                                              : 0.0f;
-
-                                outData = (1.0f - mixing) * bInData;
+                                bPlan.copySample(bPixel.getUnorderedSample(sampleNo), outData);
+                                weight = 1.0f - mixing;
                             }
                             else
                             {
-                                const float &aInData = aInPixelChannels.contains(z)
-                                                           ? aPixel.getUnorderedSample(sampleNo - bSampleNo, z)
-                                                           : 0.0f;
-                                outData = (aInData * mixing) + bInData;
+                                aPlan.copySample(aPixel.getUnorderedSample(sampleNo - bSampleNo), outData);
+                                weight = mixing;
                             }
-                        }
-                        if (mixing >= 1.0f)
-                        {
-                            outData = aPixel.getUnorderedSample(sampleNo, z);
+                            for (size_t i = 0; i < mixSlots.size(); i++)
+                                outData[mixSlots[i]] *= weight;
                         }
                     }
                 }
             }
         }
 
+        _samplesA.fetch_add(samplesA, std::memory_order_relaxed);
+        _samplesB.fetch_add(samplesB, std::memory_order_relaxed);
+        _samplesOut.fetch_add(samplesOut, std::memory_order_relaxed);
+
         outPlane.reviseSamples();
         mFnAssert(outPlane.isComplete());
         plane = outPlane;
@@ -1,4 +1,9 @@
 #include "DeepCMWrapper.h"
+#include "DeepCSimd.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
 
 using namespace DD::Image;
 
@@ -15,8 +20,305 @@ void DeepCMWrapper::_validate(bool for_real)
     // add our output channels to the _deepInfo
     ChannelSet new_channelset;
     new_channelset = _deepInfo.channels();
-    new_channelset += _processChannelSet;
+    new_channelset += _allProcessChannels;
     _deepInfo = DeepInfo(_deepInfo.formats(), _deepInfo.box(), new_channelset);
+
+    // resolve the position transform once, rather than per sample
+    const Matrix4 inverseAxis = positionAxis().inverse();
+    for (int row = 0; row < 4; row++)
+    {
+        for (int col = 0; col < 4; col++)
+            _prepared.inverseAxis[row * 4 + col] = inverseAxis(row, col);
+    }
+    for (int i = 0; i < 3; i++)
+        _prepared.position[i] = Chan_Black;
+    foreach (z, _auxiliaryChannelSet)
+    {
+        if (colourIndex(z) < 3)
+            _prepared.position[colourIndex(z)] = z;
+    }
+    _prepared.unpremultPosition = _unpremultPosition;
+}
+
+
+Matrix4 DeepCMWrapper::positionAxis() const
+{
+    Matrix4 identity;
+    identity.makeIdentity();
+    return identity;
+}
+
+
+/*
+Position of one sample, taken through the prepared inverse axis. Components
+with no position channel, or missing from the input, read as 0.
+*/
+void DeepCMWrapper::samplePosition(
+    const DeepPixel& deepInPixel,
+    size_t sampleNo,
+    float alpha,
+    float position[3]
+    ) const
+{
+    ChannelSet available;
+    available = deepInPixel.channels();
+
+    float p[3];
+    for (int i = 0; i < 3; i++)
+    {
+        const Channel z = _prepared.position[i];
+        p[i] = 0.0f;
+        if (z != Chan_Black && available.contains(z))
+        {
+            p[i] = deepInPixel.getUnorderedSample(sampleNo, z);
+            if (_prepared.unpremultPosition)
+                p[i] /= alpha;
+        }
+    }
+    deepc::simd::transformPoints(
+        &p[0], &p[1], &p[2],
+        &position[0], &position[1], &position[2],
+        1, _prepared.inverseAxis
+        );
+}
+
+
+/*
+Position channels of every sample in the batch, unpremultiplied if asked but
+not transformed. Missing components read as 0.
+*/
+void DeepCMWrapper::gatherPositions(
+    DeepCSampleBatch& batch,
+    std::vector<float>& x,
+    std::vector<float>& y,
+    std::vector<float>& z
+    ) const
+{
+    const size_t n = batch.size();
+    std::vector<float>* components[3] = {&x, &y, &z};
+    for (int i = 0; i < 3; i++)
+    {
+        std::vector<float>& dst = *components[i];
+        dst.resize(n);
+        const float* src = _prepared.position[i] != Chan_Black
+                           ? batch.source(_prepared.position[i])
+                           : NULL;
+        if (!src)
+        {
+            std::fill(dst.begin(), dst.end(), 0.0f);
+            continue;
+        }
+        if (_prepared.unpremultPosition)
+        {
+            const float* alpha = batch.alpha();
+            for (size_t s = 0; s < n; s++)
+                dst[s] = src[s] / alpha[s];
+        } else
+        {
+            std::copy(src, src + n, dst.begin());
+        }
+    }
+}
+
+
+/*
+Batched version of samplePosition: gathers the position channels of every
+sample in the batch and transforms them in one vectorized pass.
+*/
+void DeepCMWrapper::transformPositions(
+    DeepCSampleBatch& batch,
+    std::vector<float>& x,
+    std::vector<float>& y,
+    std::vector<float>& z
+    ) const
+{
+    const size_t n = batch.size();
+    gatherPositions(batch, x, y, z);
+    deepc::simd::transformPoints(
+        x.data(), y.data(), z.data(),
+        x.data(), y.data(), z.data(),
+        n, _prepared.inverseAxis
+        );
+}
+
+
+/*
+Shape space position and depth of the front-most sample of a pixel, skipping
+samples we can't unpremultiply. Returns false if there is no such sample.
+*/
+bool DeepCMWrapper::frontPosition(
+    const DeepPixel& deepInPixel,
+    float position[3],
+    float& depth
+    ) const
+{
+    ChannelSet available;
+    available = deepInPixel.channels();
+    const bool hasDepth = available.contains(Chan_DeepFront);
+    const bool hasAlpha = available.contains(Chan_Alpha);
+
+    bool found = false;
+    size_t front = 0;
+    float frontAlpha = 1.0f;
+    depth = 0.0f;
+    for (size_t sampleNo = 0; sampleNo < deepInPixel.getSampleCount(); sampleNo++)
+    {
+        const float alpha = hasAlpha
+                            ? deepInPixel.getUnorderedSample(sampleNo, Chan_Alpha)
+                            : 1.0f;
+        if (_prepared.unpremultPosition && alpha == 0.0f)
+            continue;
+        const float sampleDepth = hasDepth
+                                  ? deepInPixel.getUnorderedSample(sampleNo, Chan_DeepFront)
+                                  : 0.0f;
+        if (!found || sampleDepth < depth)
+        {
+            found = true;
+            front = sampleNo;
+            frontAlpha = alpha;
+            depth = sampleDepth;
+        }
+    }
+    if (found)
+        samplePosition(deepInPixel, front, frontAlpha, position);
+    return found;
+}
+
+
+/*
+Each pixel of the row is represented by its front-most sample. The spacing
+along x (and y) is the smaller of the distances to the pixels on either
+side, so a silhouette edge doesn't read as a huge footprint; the larger of
+the two axes is used. The spacing is then scaled by depth, so samples
+further back in a pixel get proportionally wider footprints.
+
+Neighbours come from batch.plane(), so child classes using this should return
+at least 1 from inputPadding(); otherwise pixels on the edges of a request
+only see one side, and a one-row request no vertical spacing at all.
+*/
+void DeepCMWrapper::positionFootprints(
+    DeepCSampleBatch& batch,
+    std::vector<float>& footprint
+    ) const
+{
+    struct Front
+    {
+        float position[3];
+        float depth;
+        bool valid;
+    };
+
+    const size_t n = batch.size();
+    footprint.assign(n, 0.0f);
+    if (n == 0)
+        return;
+
+    const DeepPlane& plane = batch.plane();
+    const Box& box = plane.box();
+    const int y = batch.position(0).y;
+    const int width = box.w();
+
+    // rows y - 1, y and y + 1 of front samples
+    static thread_local std::vector<Front> rows[3];
+    for (int row = 0; row < 3; row++)
+    {
+        const int rowY = y + row - 1;
+        rows[row].resize(width);
+        for (int x = 0; x < width; x++)
+        {
+            Front& front = rows[row][x];
+            front.valid = rowY >= box.y() && rowY < box.t()
+                          && frontPosition(plane.getPixel(rowY, box.x() + x), front.position, front.depth);
+        }
+    }
+
+    const float infinity = std::numeric_limits<float>::infinity();
+    const Front* here = rows[1].data();
+    static thread_local std::vector<float> spacing;
+    spacing.assign(width, 0.0f);
+    for (int x = 0; x < width; x++)
+    {
+        if (!here[x].valid)
+            continue;
+
+        const Front* neighbours[2][2] = {
+            {x > 0 ? &here[x - 1] : NULL, x + 1 < width ? &here[x + 1] : NULL},
+            {&rows[0][x], &rows[2][x]}
+        };
+        for (int axis = 0; axis < 2; axis++)
+        {
+            float nearest = infinity;
+            for (int side = 0; side < 2; side++)
+            {
+                const Front* other = neighbours[axis][side];
+                if (!other || !other->valid)
+                    continue;
+                float d2 = 0.0f;
+                for (int c = 0; c < 3; c++)
+                {
+                    const float d = other->position[c] - here[x].position[c];
+                    d2 += d * d;
+                }
+                nearest = MIN(nearest, sqrtf(d2));
+            }
+            if (nearest != infinity)
+                spacing[x] = MAX(spacing[x], nearest);
+        }
+    }
+
+    const float* depth = batch.source(Chan_DeepFront);
+    for (size_t i = 0; i < n; i++)
+    {
+        const int x = batch.position(i).x - box.x();
+        footprint[i] = spacing[x];
+        if (depth && here[x].depth > 0.0f)
+            footprint[i] *= MAX(depth[i], 0.0f) / here[x].depth;
+    }
+}
+
+
+/*
+Batched version of the operation switch in wrappedPerChannel, with the switch
+hoisted out of the sample loop. out may alias in or matte.
+*/
+void DeepCMWrapper::applyOperation(
+    const float* in,
+    const float* matte,
+    float* out,
+    size_t n
+    ) const
+{
+    switch (_operation)
+    {
+        case REPLACE:
+            if (out != matte)
+                std::copy(matte, matte + n, out);
+            break;
+        case UNION:
+            for (size_t i = 0; i < n; i++)
+                out[i] = in[i] + matte[i] - in[i] * matte[i];
+            break;
+        case MASK:
+            for (size_t i = 0; i < n; i++)
+                out[i] = in[i] * matte[i];
+            break;
+        case STENCIL:
+            for (size_t i = 0; i < n; i++)
+                out[i] = in[i] * (1.0f - matte[i]);
+            break;
+        case _OUT:
+            for (size_t i = 0; i < n; i++)
+                out[i] = (1.0f - in[i]) * matte[i];
+            break;
+        case MIN_OP:
+            for (size_t i = 0; i < n; i++)
+                out[i] = MIN(in[i], matte[i]);
+            break;
+        case MAX_OP:
+            for (size_t i = 0; i < n; i++)
+                out[i] = MAX(in[i], matte[i]);
+            break;
+    }
 }
 
 /*
@@ -1,6 +1,7 @@
 #include "DeepCWrapper.h"
 
 #include <string>
+#include <vector>
 using namespace DD::Image;
 using namespace std;
 
@@ -17,6 +18,19 @@ static const char* const operationNames[] = {
     0
     };
 
+/*
+Everything the matte nodes need to turn position data into shape space,
+resolved from the knobs once in _validate instead of once per sample.
+*/
+struct DeepCMPreparedState
+{
+    // inverse of positionAxis(), row-major
+    float inverseAxis[16];
+    // the aux channel feeding each of x, y and z, Chan_Black if none
+    Channel position[3];
+    bool unpremultPosition;
+};
+
 class DeepCMWrapper : public DeepCWrapper
 {
     protected:
@@ -28,6 +42,56 @@ class DeepCMWrapper : public DeepCWrapper
 
         int _operation;
 
+        // set in _validate
+        DeepCMPreparedState _prepared;
+
+        // the space the position data is transformed into, identity by
+        // default; child classes with an Axis_knob return it here
+        virtual Matrix4 positionAxis() const;
+
+        // position of one sample in shape space
+        void samplePosition(
+            const DeepPixel& deepInPixel,
+            size_t sampleNo,
+            float alpha,
+            float position[3]
+            ) const;
+        // positions of a whole batch as stored in the input, resized to
+        // batch.size()
+        void gatherPositions(
+            DeepCSampleBatch& batch,
+            std::vector<float>& x,
+            std::vector<float>& y,
+            std::vector<float>& z
+            ) const;
+        // positions of a whole batch in shape space, resized to batch.size()
+        void transformPositions(
+            DeepCSampleBatch& batch,
+            std::vector<float>& x,
+            std::vector<float>& y,
+            std::vector<float>& z
+            ) const;
+        // spacing of neighbouring pixels in shape space at each sample of
+        // the batch, resized to batch.size(); 0 where it can't be measured
+        void positionFootprints(
+            DeepCSampleBatch& batch,
+            std::vector<float>& footprint
+            ) const;
+        // combine n matte values with the input values using _operation
+        void applyOperation(
+            const float* in,
+            const float* matte,
+            float* out,
+            size_t n
+            ) const;
+
+    private:
+        bool frontPosition(
+            const DeepPixel& deepInPixel,
+            float position[3],
+            float& depth
+            ) const;
+
     public:
 
         DeepCMWrapper(Node* node) : DeepCWrapper(node)
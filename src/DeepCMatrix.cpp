@@ -40,6 +40,8 @@ public:
             Vector3& sampleColor
             );
 
+        virtual void wrappedPerBatch(DeepCSampleBatch& batch);
+
 
         void _validate(bool);
         virtual void custom_knobs(Knob_Callback f);
@@ -114,6 +116,46 @@ void DeepCMatrix::wrappedPerChannel(
 }
 
 
+/*
+Batched version of wrappedPerChannel, working on a whole row of samples at
+once.
+*/
+void DeepCMatrix::wrappedPerBatch(DeepCSampleBatch& batch)
+{
+    const size_t n = batch.size();
+    const float* alpha = batch.alpha();
+
+    const float* rgb[3] = {NULL, NULL, NULL};
+    foreach(z, _brothers) {
+        int cIndex = colourIndex(z);
+        if (cIndex >= 3)
+        {
+            continue;
+        }
+        rgb[cIndex] = batch.source(z);
+    }
+
+    const Matrix3& mtx = _invert ? array_mtx3_inverse : array_mtx3;
+
+    for (size_t i = 0; i < n; i++)
+    {
+        Vector3 sampleColor(0.0f, 0.0f, 0.0f);
+        for (int k = 0; k < 3; k++)
+        {
+            if (rgb[k])
+                sampleColor[k] = rgb[k][i] / alpha[i];
+        }
+        sampleColor = mtx.transform(sampleColor);
+
+        for (int lane = 0; lane < batch.lanes(); lane++)
+        {
+            const int cIndex = batch.colourIndex(lane);
+            batch.out(lane)[i] = cIndex < 3 ? sampleColor[cIndex] : batch.in(lane)[i];
+        }
+    }
+}
+
+
 void DeepCMatrix::custom_knobs(Knob_Callback f)
 {
     Array_knob(f, &_arrayKnob, 3, 3, "matrix");
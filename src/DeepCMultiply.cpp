@@ -1,4 +1,7 @@
 #include "DeepCWrapper.h"
+#include "DeepCSimd.h"
+
+#include <algorithm>
 
 using namespace DD::Image;
 
@@ -25,6 +28,8 @@ class DeepCMultiply : public DeepCWrapper
             Vector3& sampleColor
             );
 
+        virtual void wrappedPerBatch(DeepCSampleBatch& batch);
+
         virtual void custom_knobs(Knob_Callback f);
 
         static const Iop::Description d;
@@ -55,6 +60,29 @@ void DeepCMultiply::wrappedPerChannel(
 }
 
 
+/*
+Batched version of wrappedPerChannel, working on a whole row of samples at
+once.
+*/
+void DeepCMultiply::wrappedPerBatch(DeepCSampleBatch& batch)
+{
+    const size_t n = batch.size();
+    for (int lane = 0; lane < batch.lanes(); lane++)
+    {
+        const float* in = batch.in(lane);
+        float* out = batch.out(lane);
+        const float v = value[batch.colourIndex(lane)];
+        if (v != 1.0)
+        {
+            deepc::simd::affine(in, out, n, v, 0.0f);
+        } else
+        {
+            std::copy(in, in + n, out);
+        }
+    }
+}
+
+
 void DeepCMultiply::custom_knobs(Knob_Callback f)
 {
     Color_knob(f, value, IRange(0, 5), "value", "value");
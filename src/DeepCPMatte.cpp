@@ -1,12 +1,23 @@
 #include "DeepCMWrapper.h"
+#include "DeepCSimd.h"
 #include "DDImage/ViewerContext.h"
 #include "DDImage/gl.h"
 
+#include <algorithm>
+#include <cmath>
+#include <string>
+#include <vector>
+
 using namespace DD::Image;
 
 static const char *const sampleId[] = {"closest", "furthest", 0};
 static const char *const shapeNames[] = {"sphere", "cube", 0};
 static const char *const falloffTypeNames[] = {"smooth", "linear", 0};
+// the orders offered by the Axis knob; "SRT" scales first, translates last
+static const char *const xformOrderNames[] = {"SRT", "STR", "RST", "RTS", "TSR", "TRS", 0};
+static const char *const rotOrderNames[] = {"XYZ", "XZY", "YXZ", "YZX", "ZXY", "ZYX", 0};
+static const int defaultXformOrder = 0;
+static const int defaultRotOrder = 4;
 
 enum
 {
@@ -20,6 +31,167 @@ enum
     LINEAR
 };
 
+// Most shapes a node can have, the one set up by the selection axis
+// included. The knobs of the extra shapes are made as the shape count asks,
+// but their values have to live inside the op — Nuke stores knob values
+// into every op of a node at the same offset — so they sit in a fixed
+// array, sized well beyond the twenty or so mattes a shot tends to need.
+static const int maxShapes = 64;
+static const int extraShapeCount = maxShapes - 1;
+
+// knob names of one extra shape, numbered from 2 like "translate2"
+struct ExtraShapeKnobNames
+{
+    std::string group;
+    std::string label;
+    std::string enable;
+    std::string output;
+    std::string shape;
+    std::string falloffType;
+    std::string falloff;
+    std::string falloffGamma;
+    std::string xformOrder;
+    std::string rotOrder;
+    std::string translate;
+    std::string rotate;
+    std::string scale;
+    std::string uniformScale;
+    std::string skew;
+    std::string pivot;
+};
+
+// built once, as knobs keep pointers to their names
+static const ExtraShapeKnobNames &extraShapeKnobNames(int shape)
+{
+    static const std::vector<ExtraShapeKnobNames> names = []
+    {
+        std::vector<ExtraShapeKnobNames> all(extraShapeCount);
+        for (int i = 0; i < extraShapeCount; i++)
+        {
+            const std::string n = std::to_string(i + 2);
+            ExtraShapeKnobNames &k = all[i];
+            k.group = "shape_group" + n;
+            k.label = "Shape " + n;
+            k.enable = "enable" + n;
+            k.output = "output" + n;
+            k.shape = "shape" + n;
+            k.falloffType = "falloffType" + n;
+            k.falloff = "falloff" + n;
+            k.falloffGamma = "falloff_gamma" + n;
+            k.xformOrder = "xform_order" + n;
+            k.rotOrder = "rot_order" + n;
+            k.translate = "translate" + n;
+            k.rotate = "rotate" + n;
+            k.scale = "scaling" + n;
+            k.uniformScale = "uniform_scale" + n;
+            k.skew = "skew" + n;
+            k.pivot = "pivot" + n;
+        }
+        return all;
+    }();
+    return names[shape];
+}
+
+// knob values of one extra shape
+struct ExtraShape
+{
+    bool enable;
+    Channel output;
+    int shape;
+    int falloffType;
+    float falloff;
+    float falloffGamma;
+    int xformOrder;
+    int rotOrder;
+    float translate[3];
+    float rotate[3];
+    float scale[3];
+    float uniformScale;
+    float skew[3];
+    float pivot[3];
+
+    ExtraShape()
+        : enable(false)
+        , output(Chan_Black)
+        , shape(0)
+        , falloffType(SMOOTH)
+        , falloff(1.0f)
+        , falloffGamma(1.0f)
+        , xformOrder(defaultXformOrder)
+        , rotOrder(defaultRotOrder)
+        , uniformScale(1.0f)
+    {
+        for (int i = 0; i < 3; i++)
+        {
+            translate[i] = 0.0f;
+            rotate[i] = 0.0f;
+            scale[i] = 1.0f;
+            skew[i] = 0.0f;
+            pivot[i] = 0.0f;
+        }
+    }
+
+    // Shape space to world, built the way the Axis knob builds its matrix:
+    // scale, rotation and translation in the transform order and the
+    // rotations in the rotation order, all about the pivot. Matrix4 adds
+    // each step on the right, so the letters of an order are walked last
+    // first.
+    Matrix4 matrix() const
+    {
+        Matrix4 m;
+        m.makeIdentity();
+        m.translate(pivot[0], pivot[1], pivot[2]);
+        const char *order = xformOrderNames[xformOrder];
+        for (int i = 2; i >= 0; i--)
+        {
+            if (order[i] == 'T')
+            {
+                m.translate(translate[0], translate[1], translate[2]);
+            }
+            else if (order[i] == 'R')
+            {
+                const char *axes = rotOrderNames[rotOrder];
+                for (int j = 2; j >= 0; j--)
+                {
+                    if (axes[j] == 'X')
+                        m.rotateX(radians(rotate[0]));
+                    else if (axes[j] == 'Y')
+                        m.rotateY(radians(rotate[1]));
+                    else
+                        m.rotateZ(radians(rotate[2]));
+                }
+            }
+            else
+            {
+                m.scale(scale[0] * uniformScale, scale[1] * uniformScale, scale[2] * uniformScale);
+                m.skew(skew[0], skew[1], skew[2]);
+            }
+        }
+        m.translate(-pivot[0], -pivot[1], -pivot[2]);
+        return m;
+    }
+};
+
+/*
+One shape, resolved from the knobs in _validate.
+*/
+struct PreparedShape
+{
+    int shape;
+    int falloffType;
+    float falloff;
+    float falloffGamma;
+    // the channel written, or Chan_Black for the output channels
+    Channel target;
+    // world to shape space, row-major
+    float inverse[16];
+    // world space bounds outside of which the matte is 0; only valid if
+    // cull is set
+    float lo[3];
+    float hi[3];
+    bool cull;
+};
+
 class DeepCPMatte : public DeepCMWrapper
 {
 
@@ -32,8 +204,33 @@ class DeepCPMatte : public DeepCMWrapper
     float _falloff;
     float _falloffGamma;
 
+    // shapes in use, the selection axis one included
+    int _shapeCount;
+    ExtraShape _extraShapes[extraShapeCount];
+    // extra shapes that have knobs, and how many knobs those are
+    int _shapesWithKnobs;
+    int _shapeKnobCount;
+
+    // the selection axis shape first, then every enabled extra shape
+    std::vector<PreparedShape> _shapes;
+
+    void prepareShape(
+        const Matrix4& matrix,
+        int shape,
+        int falloffType,
+        float falloff,
+        float falloffGamma,
+        Channel target
+        );
+
+    // extra shapes in use, from the shape count knob
+    int extraShapesUsed() const { return std::min(std::max(_shapeCount, 1), maxShapes) - 1; }
+
+    // knobs of the extra shapes in use; p is the DeepCPMatte
+    static void addShapeKnobs(void *p, Knob_Callback f);
+
 public:
-    DeepCPMatte(Node *node) : DeepCMWrapper(node), _shape(0), _sampleId(0), _falloffType(0), _falloff(1.0f), _falloffGamma(1.0f)
+    DeepCPMatte(Node *node) : DeepCMWrapper(node), _shape(0), _sampleId(0), _falloffType(0), _falloff(1.0f), _falloffGamma(1.0f), _shapeCount(1), _shapesWithKnobs(0), _shapeKnobCount(0)
     {
         _auxChannelKnobName = "position_data";
         _positionPick[0] = _positionPick[1] = 0.0f;
@@ -49,10 +246,19 @@ public:
         float &perSampleData,
         Vector3 &sampleColor);
 
+    virtual void wrappedPerBatch(DeepCSampleBatch &batch);
+
+    virtual void findProcessChannels(ChannelSet &processChannels);
+    virtual void _validate(bool);
+
+    virtual Matrix4 positionAxis() const { return _axisKnob; }
+    static float matte(const PreparedShape &shape, float x, float y, float z);
+
     virtual void custom_knobs(Knob_Callback f);
     int knob_changed(Knob *k);
     void build_handles(ViewerContext *ctx);
     void draw_handle(ViewerContext *ctx);
+    void drawShape(const Matrix4 &matrix, int shape, float falloff);
 
     static const Iop::Description d;
     const char *Class() const { return d.name; }
@@ -74,62 +280,200 @@ void DeepCPMatte::wrappedPerSample(
     float &perSampleData,
     Vector3 &sampleColor)
 {
-    // generate mask
-    float m;
-    Vector4 position;
-    float distance;
+    float position[3];
+    samplePosition(deepInPixel, sampleNo, alpha, position);
+    perSampleData = matte(_shapes[0], position[0], position[1], position[2]);
+}
+
+/*
+Extra shapes writing to a channel of their own add it to the channels we
+process.
+*/
+void DeepCPMatte::findProcessChannels(ChannelSet &processChannels)
+{
+    DeepCMWrapper::findProcessChannels(processChannels);
+    for (int i = 0; i < extraShapesUsed(); i++)
+    {
+        if (_extraShapes[i].enable && _extraShapes[i].output != Chan_Black)
+            processChannels += _extraShapes[i].output;
+    }
+}
 
-    ChannelSet available;
-    available = deepInPixel.channels();
+void DeepCPMatte::_validate(bool for_real)
+{
+    DeepCMWrapper::_validate(for_real);
 
-    foreach (z, _auxiliaryChannelSet)
+    _shapes.clear();
+    prepareShape(_axisKnob, _shape, _falloffType, _falloff, _falloffGamma, Chan_Black);
+    for (int i = 0; i < extraShapesUsed(); i++)
     {
-        if (colourIndex(z) >= 3)
-        {
+        const ExtraShape &extra = _extraShapes[i];
+        if (!extra.enable)
             continue;
-        }
-        if (available.contains(z))
+        prepareShape(
+            extra.matrix(), extra.shape, extra.falloffType,
+            extra.falloff, extra.falloffGamma, extra.output
+            );
+    }
+}
+
+/*
+Both shapes are 0 outside the cube from -1 to 1 in shape space, as long as the
+falloff and its gamma are positive, so the world space bounds of that cube's
+corners let us skip samples without transforming them.
+*/
+void DeepCPMatte::prepareShape(
+    const Matrix4 &matrix,
+    int shape,
+    int falloffType,
+    float falloff,
+    float falloffGamma,
+    Channel target
+    )
+{
+    PreparedShape prepared;
+    prepared.shape = shape;
+    prepared.falloffType = falloffType;
+    prepared.falloff = falloff;
+    prepared.falloffGamma = falloffGamma;
+    prepared.target = target;
+
+    const Matrix4 inverse = matrix.inverse();
+    for (int row = 0; row < 4; row++)
+    {
+        for (int col = 0; col < 4; col++)
+            prepared.inverse[row * 4 + col] = inverse(row, col);
+    }
+
+    prepared.cull = falloff > 0.0f && falloffGamma > 0.0f;
+    for (int corner = 0; corner < 8; corner++)
+    {
+        const Vector3 p = matrix.transform(Vector3(
+            corner & 1 ? 1.0f : -1.0f,
+            corner & 2 ? 1.0f : -1.0f,
+            corner & 4 ? 1.0f : -1.0f
+            ));
+        for (int i = 0; i < 3; i++)
         {
-            // grab data from auxiliary channelset
-            if (_unpremultPosition)
-            {
-                position[colourIndex(z)] = deepInPixel.getUnorderedSample(sampleNo, z) / alpha;
-            }
-            else
-            {
-                position[colourIndex(z)] = deepInPixel.getUnorderedSample(sampleNo, z);
-            }
+            prepared.lo[i] = corner == 0 ? p[i] : std::min(prepared.lo[i], p[i]);
+            prepared.hi[i] = corner == 0 ? p[i] : std::max(prepared.hi[i], p[i]);
         }
     }
-    position[3] = 1.0f;
-    Matrix4 inverse__axisKnob = _axisKnob.inverse();
-    position = inverse__axisKnob * position;
-    position = position.divide_w();
+    for (int i = 0; i < 3; i++)
+    {
+        if (!std::isfinite(prepared.lo[i]) || !std::isfinite(prepared.hi[i]))
+            prepared.cull = false;
+    }
 
-    if (_shape == 0)
+    _shapes.push_back(prepared);
+}
+
+/*
+Matte value of a point already in selection space.
+*/
+float DeepCPMatte::matte(const PreparedShape &shape, float x, float y, float z)
+{
+    float m = 0.0f;
+    float distance;
+
+    if (shape.shape == 0)
     {
         // sphere
-        distance = pow(
-            position[0] * position[0] + position[1] * position[1] + position[2] * position[2], .5);
+        distance = pow(x * x + y * y + z * z, .5);
     }
     else
     {
         // cube
-        distance = 1.0 - (clamp(1 - fabs(position[0])) * clamp(1 - fabs(position[1])) * clamp(1 - fabs(position[2])));
+        distance = 1.0 - (clamp(1 - fabs(x)) * clamp(1 - fabs(y)) * clamp(1 - fabs(z)));
     }
-    distance = clamp((1 - distance) / _falloff, 0.0f, 1.0f);
-    distance = pow(distance, 1.0f / _falloffGamma);
+    distance = clamp((1 - distance) / shape.falloff, 0.0f, 1.0f);
+    distance = pow(distance, 1.0f / shape.falloffGamma);
 
     // falloff
-    if (_falloffType == SMOOTH)
+    if (shape.falloffType == SMOOTH)
     {
         m = smoothstep(0.0f, 1.0f, distance);
     }
-    else if (_falloffType == LINEAR)
+    else if (shape.falloffType == LINEAR)
     {
         m = clamp(distance, 0.0f, 1.0f);
     }
-    perSampleData = m;
+    return m;
+}
+
+/*
+Batched version of wrappedPerSample and wrappedPerChannel: every shape in
+turn picks out the samples inside its world space bounds, transforms just
+those in one vectorized pass and evaluates its matte. A lane's matte is the
+maximum of the shapes writing to its channel.
+*/
+void DeepCPMatte::wrappedPerBatch(DeepCSampleBatch &batch)
+{
+    static thread_local std::vector<float> px, py, pz, x, y, z, m, laneMattes;
+    static thread_local std::vector<int> inside;
+
+    const size_t n = batch.size();
+    const int lanes = batch.lanes();
+    gatherPositions(batch, px, py, pz);
+    laneMattes.assign(lanes * n, 0.0f);
+
+    for (size_t s = 0; s < _shapes.size(); s++)
+    {
+        const PreparedShape &shape = _shapes[s];
+
+        bool writes = false;
+        for (int lane = 0; lane < lanes; lane++)
+        {
+            const Channel target = batch.channel(lane);
+            writes |= shape.target == Chan_Black
+                      ? _processChannelSet.contains(target)
+                      : shape.target == target;
+        }
+        if (!writes)
+            continue;
+
+        inside.clear();
+        x.resize(n);
+        y.resize(n);
+        z.resize(n);
+        for (size_t i = 0; i < n; i++)
+        {
+            if (shape.cull && !(
+                   px[i] >= shape.lo[0] && px[i] <= shape.hi[0]
+                && py[i] >= shape.lo[1] && py[i] <= shape.hi[1]
+                && pz[i] >= shape.lo[2] && pz[i] <= shape.hi[2]))
+                continue;
+            x[inside.size()] = px[i];
+            y[inside.size()] = py[i];
+            z[inside.size()] = pz[i];
+            inside.push_back(static_cast<int>(i));
+        }
+        const size_t count = inside.size();
+        if (count == 0)
+            continue;
+
+        deepc::simd::transformPoints(
+            x.data(), y.data(), z.data(),
+            x.data(), y.data(), z.data(),
+            count, shape.inverse
+            );
+        m.resize(count);
+        for (size_t i = 0; i < count; i++)
+            m[i] = matte(shape, x[i], y[i], z[i]);
+
+        for (int lane = 0; lane < lanes; lane++)
+        {
+            const Channel target = batch.channel(lane);
+            if (shape.target == Chan_Black ? !_processChannelSet.contains(target) : shape.target != target)
+                continue;
+            float *laneMatte = laneMattes.data() + lane * n;
+            for (size_t i = 0; i < count; i++)
+                laneMatte[inside[i]] = std::max(laneMatte[inside[i]], m[i]);
+        }
+    }
+
+    for (int lane = 0; lane < lanes; lane++)
+        applyOperation(batch.in(lane), laneMattes.data() + lane * n, batch.out(lane), n);
 }
 
 void DeepCPMatte::build_handles(ViewerContext *ctx)
@@ -147,21 +491,32 @@ void DeepCPMatte::draw_handle(ViewerContext *ctx)
 
     glColor(ctx->node_color());
 
+    drawShape(_axisKnob, _shape, _falloff);
+    for (int i = 0; i < extraShapesUsed(); i++)
+    {
+        const ExtraShape &extra = _extraShapes[i];
+        if (extra.enable)
+            drawShape(extra.matrix(), extra.shape, extra.falloff);
+    }
+}
+
+void DeepCPMatte::drawShape(const Matrix4 &matrix, int shape, float falloff)
+{
     glPushMatrix();
-    glMultMatrixf(_axisKnob.array());
+    glMultMatrixf(matrix.array());
 
     // Outer wireframe — unit scale in Axis local space (falloff-zero boundary)
-    if (_shape == 0)
+    if (shape == 0)
         gl_sphere(0.5f);
     else
         gl_cubef(0.0f, 0.0f, 0.0f, 1.0f);
 
     // Inner wireframe — full-selection boundary, only draw when not degenerate
-    float innerScale = 1.0f - _falloff;
+    float innerScale = 1.0f - falloff;
     if (innerScale > 0.001f)
     {
         glScalef(innerScale, innerScale, innerScale);
-        if (_shape == 0)
+        if (shape == 0)
             gl_sphere(0.5f);
         else
             gl_cubef(0.0f, 0.0f, 0.0f, 1.0f);
@@ -181,10 +536,71 @@ void DeepCPMatte::custom_knobs(Knob_Callback f)
     Enumeration_knob(f, &_falloffType, falloffTypeNames, "falloffType");
     Float_knob(f, &_falloff, "falloff");
     Float_knob(f, &_falloffGamma, "falloff_gamma");
+
+    Divider(f, "");
+    Int_knob(f, &_shapeCount, "shape_count", "shapes");
+    SetRange(f, 1, maxShapes);
+    // knob_changed has to make the shape knobs on script load too, before
+    // their values are read
+    SetFlags(f, Knob::KNOB_CHANGED_ALWAYS);
+    Tooltip(f, "Number of shapes, the one set up by the selection axis "
+               "included, up to 64. A group of knobs is added for every "
+               "extra shape.");
+
+    // the shape knobs are made by knob_changed; every other pass over the
+    // knobs has to see them too
+    if (!f.makeKnobs())
+        addShapeKnobs(this->firstOp(), f);
+}
+
+void DeepCPMatte::addShapeKnobs(void *p, Knob_Callback f)
+{
+    DeepCPMatte *op = static_cast<DeepCPMatte *>(p);
+    for (int i = 0; i < op->extraShapesUsed(); i++)
+    {
+        const ExtraShapeKnobNames &names = extraShapeKnobNames(i);
+        ExtraShape &extra = op->_extraShapes[i];
+        BeginClosedGroup(f, names.group.c_str(), names.label.c_str());
+        Bool_knob(f, &extra.enable, names.enable.c_str(), "enable");
+        Channel_knob(f, &extra.output, 1, names.output.c_str(), "output");
+        Tooltip(f, "Channel this shape writes its matte to. With none, the "
+                   "shape is combined with the main shape into the output "
+                   "channels.");
+        Enumeration_knob(f, &extra.xformOrder, xformOrderNames, names.xformOrder.c_str(), "transform order");
+        Enumeration_knob(f, &extra.rotOrder, rotOrderNames, names.rotOrder.c_str(), "rotation order");
+        // only translate is a point in world space, the rest get no handle
+        XYZ_knob(f, extra.translate, names.translate.c_str(), "translate");
+        XYZ_knob(f, extra.rotate, names.rotate.c_str(), "rotate");
+        SetFlags(f, Knob::NO_HANDLE);
+        XYZ_knob(f, extra.scale, names.scale.c_str(), "scale");
+        SetFlags(f, Knob::NO_HANDLE);
+        Float_knob(f, &extra.uniformScale, names.uniformScale.c_str(), "uniform scale");
+        XYZ_knob(f, extra.skew, names.skew.c_str(), "skew");
+        SetFlags(f, Knob::NO_HANDLE);
+        XYZ_knob(f, extra.pivot, names.pivot.c_str(), "pivot");
+        SetFlags(f, Knob::NO_HANDLE);
+        Enumeration_knob(f, &extra.shape, shapeNames, names.shape.c_str(), "shape");
+        Enumeration_knob(f, &extra.falloffType, falloffTypeNames, names.falloffType.c_str(), "falloffType");
+        Float_knob(f, &extra.falloff, names.falloff.c_str(), "falloff");
+        Float_knob(f, &extra.falloffGamma, names.falloffGamma.c_str(), "falloff_gamma");
+        EndGroup(f);
+    }
 }
 
 int DeepCPMatte::knob_changed(Knob *k)
 {
+    if (k->is("shape_count") || k == &Knob::showPanel)
+    {
+        // a knob's default is the value it is made with, so shapes getting
+        // knobs again start from the defaults rather than old values
+        const int used = extraShapesUsed();
+        for (int i = _shapesWithKnobs; i < used; i++)
+            _extraShapes[i] = ExtraShape();
+        _shapeKnobCount = replace_knobs(knob("shape_count"), _shapeKnobCount, addShapeKnobs, this->firstOp());
+        _shapesWithKnobs = used;
+        if (k->is("shape_count"))
+            return 1;
+    }
     if (k->is("center"))
     {
         input0()->validate(true);
@@ -215,7 +631,16 @@ int DeepCPMatte::knob_changed(Knob *k)
 
 const char *DeepCPMatte::node_help() const
 {
-    return "PMatte node for DeepC.";
+    return "PMatte node for DeepC.\n\n"
+           "Up to 64 shapes can be used, set by the shapes knob: the one "
+           "set up by the selection axis writes to the output channels, and "
+           "each extra shape writes either to a channel of its own or, with "
+           "its output set to none, to the output channels too. Where shapes "
+           "overlap the larger matte wins.\n\n"
+           "Extra shapes have the same transform controls as the selection "
+           "axis, as separate knobs since an Axis knob's own knob names can "
+           "only be used once per node. Their translate knobs can be dragged "
+           "in the 3D viewer.";
 }
 
 static Op *build(Node *node) { return new DeepCPMatte(node); }
@@ -1,6 +1,9 @@
 #include "DeepCMWrapper.h"
+#include "DeepCSimd.h"
 #include "FastNoise.h"
 
+#include <vector>
+
 using namespace DD::Image;
 
 
@@ -83,6 +86,12 @@ class DeepCPNoise : public DeepCMWrapper
     float _lacunarity;
     float _gain;
 
+    // octave LOD
+    bool _octaveLod;
+    float _lodBias;
+    // set in _validate
+    bool _lodActive;
+
     int _distanceFunction; // enum
     int _cellularReturnType; // enum
     int _cellularDistanceIndex0;
@@ -130,6 +139,9 @@ class DeepCPNoise : public DeepCMWrapper
             _octaves = 5;
             _lacunarity = 2.0f;
             _gain = .5f;
+            _octaveLod = false;
+            _lodBias = 0.0f;
+            _lodActive = false;
 
             // cellular
             _distanceFunction = 0;
@@ -168,6 +180,11 @@ class DeepCPNoise : public DeepCMWrapper
             float& outData,
             Vector3& sampleColor
             );
+        virtual void wrappedPerBatch(DeepCSampleBatch& batch);
+        virtual Matrix4 positionAxis() const { return _axisKnob; }
+        // the footprints of octave LOD need the pixels around every
+        // output pixel, wherever downstream splits its requests
+        virtual int inputPadding() const { return _lodActive ? 1 : 0; }
         virtual void custom_knobs(Knob_Callback f);
 
         static const Iop::Description d;
@@ -222,6 +239,12 @@ void DeepCPNoise::_validate(bool for_real)
         _cellularDistanceIndex1
     );
 
+    // only the fractal types have octaves to drop
+    const FastNoise::NoiseType noiseType = noiseTypes[_noiseType];
+    _lodActive = _octaveLod
+                 && (noiseType == FastNoise::SimplexFractal || noiseType == FastNoise::PerlinFractal)
+                 && _octaves > 1
+                 && _lacunarity > 1.0f;
 }
 
 /*
@@ -241,31 +264,8 @@ void DeepCPNoise::wrappedPerSample(
 {
 
     // generate noise
-    Vector4 position;
-    float noiseValue;
-    float positionDisturbance[3];
-    ChannelSet available;
-    available = deepInPixel.channels();
-    foreach(z, _auxiliaryChannelSet) {
-        if (colourIndex(z) >= 3)
-        {
-            continue;
-        }
-        if (available.contains(z))
-        {
-            // grab data from auxiliary channelset
-            if (_unpremultPosition)
-            {
-                position[colourIndex(z)] = deepInPixel.getUnorderedSample(sampleNo, z) / alpha;
-            } else {
-                position[colourIndex(z)] = deepInPixel.getUnorderedSample(sampleNo, z);
-            }
-        }
-    }
-    position[3] = 1.0f;
-    Matrix4 inverse__axisKnob = _axisKnob.inverse();
-    position = inverse__axisKnob * position;
-    position = position.divide_w(); // TODO: is this necessary? shouldn't be.
+    float position[3];
+    samplePosition(deepInPixel, sampleNo, alpha, position);
 
     perSampleData = _fastNoise.GetNoise(position[0], position[1], position[2], _noiseEvolution);
     // TODO: used to be then processing the result like this:
@@ -287,7 +287,8 @@ void DeepCPNoise::wrappedPerChannel(
     int cIndex;
     float gradedPerSampleData;
 
-    cIndex = colourIndex(z);
+    // the grade knobs are rgb only
+    cIndex = MIN(colourIndex(z), 2);
 
     if (_reverse)
     {
@@ -337,6 +338,75 @@ void DeepCPNoise::wrappedPerChannel(
 }
 
 
+/*
+Batched version of wrappedPerSample and wrappedPerChannel: the positions of
+the whole row are transformed in one pass and the noise is evaluated over the
+whole row with FastNoise's vectorized GetNoiseBatch, then graded and combined
+per lane.
+
+With octave LOD on, each sample's fractal sum stops at the octave whose
+features would be smaller than two pixel footprints, fading the last octave
+in between, so distant or grazing surfaces don't alias.
+*/
+void DeepCPNoise::wrappedPerBatch(DeepCSampleBatch& batch)
+{
+    static thread_local std::vector<float> x, y, z, limits, noise, graded;
+
+    const size_t n = batch.size();
+    transformPositions(batch, x, y, z);
+
+    const float* octaveLimits = NULL;
+    if (_lodActive)
+    {
+        positionFootprints(batch, limits);
+        // octave i has a feature size of 1 / (frequency * lacunarity^i)
+        const float octaves = static_cast<float>(_octaves);
+        const float frequency = fabsf(_frequency);
+        const float invLogLacunarity = 1.0f / logf(_lacunarity);
+        for (size_t i = 0; i < n; i++)
+        {
+            float limit = octaves;
+            const float footprint = limits[i] * frequency;
+            if (footprint > 0.0f)
+                limit = 1.0f + logf(.5f / footprint) * invLogLacunarity + _lodBias;
+            limits[i] = clamp(limit, 1.0f, octaves);
+        }
+        octaveLimits = limits.data();
+    }
+
+    noise.resize(n);
+    _fastNoise.GetNoiseBatch(x.data(), y.data(), z.data(), _noiseEvolution, noise.data(), n, octaveLimits);
+    deepc::simd::affine(noise.data(), noise.data(), n, .5f, .5f);
+
+    graded.resize(n);
+    for (int lane = 0; lane < batch.lanes(); lane++)
+    {
+        // the grade knobs are rgb only
+        const int cIndex = MIN(batch.colourIndex(lane), 2);
+        if (_reverse)
+        {
+            // opposite gamma, precomputed, then the inverse linear ramp
+            if (G[cIndex] != 1.0f)
+            {
+                deepc::simd::power(noise.data(), graded.data(), n, G[cIndex]);
+                deepc::simd::affine(graded.data(), graded.data(), n, A[cIndex], B[cIndex]);
+            } else
+            {
+                deepc::simd::affine(noise.data(), graded.data(), n, A[cIndex], B[cIndex]);
+            }
+        } else
+        {
+            deepc::simd::affine(noise.data(), graded.data(), n, A[cIndex], B[cIndex]);
+            if (G[cIndex] != 1.0f)
+                deepc::simd::power(graded.data(), graded.data(), n, G[cIndex]);
+        }
+        deepc::simd::clampRange(graded.data(), n, _blackClamp, 0.0f, _whiteClamp, 1.0f);
+
+        applyOperation(batch.in(lane), graded.data(), batch.out(lane), n);
+    }
+}
+
+
 void DeepCPNoise::custom_knobs(Knob_Callback f)
 {
     BeginGroup(f, "Position");
@@ -380,6 +450,20 @@ void DeepCPNoise::custom_knobs(Knob_Callback f)
         "The relative strength of noise from each layer"
         "when compared to the last one."
     );
+    Bool_knob(f, &_octaveLod, "octave_lod", "octave LOD");
+    SetFlags(f, Knob::STARTLINE);
+    Tooltip(f,
+        "Drop the octaves that are finer than the pixels they land on, fading "
+        "out the last one, so noise on distant or grazing surfaces doesn't "
+        "alias or shimmer. The footprint of each pixel is measured from the "
+        "position data of its neighbours. Simplex and Perlin only."
+    );
+    Float_knob(f, &_lodBias, IRange(-2, 2), "lod_bias", "LOD bias");
+    Tooltip(f,
+        "Octaves to add to (or, when negative, take away from) the number "
+        "octave LOD keeps. Positive values keep more detail at the risk of "
+        "aliasing."
+    );
     EndGroup(f); // Fractal
     // cellular functions
     BeginClosedGroup(f, "Cellular");
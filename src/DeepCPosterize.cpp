@@ -25,6 +25,8 @@ public:
             Vector3& sampleColor
             );
 
+        virtual void wrappedPerBatch(DeepCSampleBatch& batch);
+
         void _validate(bool);
 
         virtual void custom_knobs(Knob_Callback f);
@@ -54,6 +56,26 @@ void DeepCPosterize::wrappedPerChannel(
 }
 
 
+/*
+Batched version of wrappedPerChannel, working on a whole row of samples at
+once.
+*/
+void DeepCPosterize::wrappedPerBatch(DeepCSampleBatch& batch)
+{
+    const size_t n = batch.size();
+    for (int lane = 0; lane < batch.lanes(); lane++)
+    {
+        const float* in = batch.in(lane);
+        float* out = batch.out(lane);
+        for (size_t i = 0; i < n; i++)
+        {
+            int val = in[i] * _save_colors;
+            out[i] = val / _save_colors;
+        }
+    }
+}
+
+
 void DeepCPosterize::custom_knobs(Knob_Callback f)
 {
     Double_knob(f, &colors, IRange(2, 256), "colors", "Colors");
@@ -3,6 +3,8 @@
 #include "DDImage/ChannelSet.h"
 #include "DDImage/Channel.h"
 
+#include "DeepChannelPlan.h"
+
 using namespace DD::Image;
 
 class DeepCRemoveChannels : public DeepFilterOp
@@ -85,7 +87,9 @@ bool DeepCRemoveChannels::doDeepEngine(DD::Image::Box bbox, const DD::Image::Cha
     DeepInPlaceOutputPlane inPlaceOutPlane(requestedChannels, bbox);
     inPlaceOutPlane.reserveSamples(deepInPlane.getTotalSampleCount());
 
-    const DD::Image::ChannelSet inputChannels = input0()->deepInfo().channels();
+    // output channels the input doesn't have come out as zero
+    static thread_local deepc::DeepChannelPlan plan;
+    plan.reset(deepInPlane.channels(), requestedChannels);
 
     for (Box::iterator it = bbox.begin(); it != bbox.end(); ++it)
     {
@@ -94,24 +98,12 @@ bool DeepCRemoveChannels::doDeepEngine(DD::Image::Box bbox, const DD::Image::Cha
 
         // Get the deep pixel from the input plane:
         DeepPixel deepInPixel = deepInPlane.getPixel(it);
-        size_t inPixelSamples = deepInPixel.getSampleCount();
-        ChannelSet inPixelChannels = deepInPixel.channels();
 
         inPlaceOutPlane.setSampleCount(it, deepInPixel.getSampleCount());
         DeepOutputPixel outPixel = inPlaceOutPlane.getPixel(it);
 
         // copy samples to DeepOutputPlane
-        for (size_t sampleNo = 0; sampleNo < inPixelSamples; sampleNo++)
-        {
-            foreach (z, requestedChannels)
-            {
-                const float& inData = inPixelChannels.contains(z)
-                                      ? deepInPixel.getUnorderedSample(sampleNo, z)
-                                      : 0.0f;
-                float& outData = outPixel.getWritableUnorderedSample(sampleNo, z);
-                outData = inData;
-            }
-        }
+        plan.copyPixel(deepInPixel, outPixel);
     }
 
     // inPlaceOutPlane.reviseSamples();
@@ -1,4 +1,6 @@
 #include "DeepCWrapper.h"
+
+#include <vector>
 #include "DDImage/RGB.h"
 
 using namespace DD::Image;
@@ -49,6 +51,8 @@ class DeepCSaturation : public DeepCWrapper
             Vector3& sampleColor
             );
 
+        virtual void wrappedPerBatch(DeepCSampleBatch& batch);
+
         virtual void custom_knobs(Knob_Callback f);
 
         static const Iop::Description d;
@@ -148,6 +152,58 @@ void DeepCSaturation::wrappedPerChannel(
 }
 
 
+/*
+Batched version of wrappedPerChannel, working on a whole row of samples at
+once.
+*/
+void DeepCSaturation::wrappedPerBatch(DeepCSampleBatch& batch)
+{
+    const size_t n = batch.size();
+    const float* alpha = batch.alpha();
+
+    const float* rgb[3] = {NULL, NULL, NULL};
+    foreach(z, _brothers) {
+        if (colourIndex(z) >= 3)
+        {
+            continue;
+        }
+        rgb[colourIndex(z)] = batch.source(z);
+    }
+
+    static thread_local std::vector<float> luma;
+    luma.resize(n);
+    for (size_t i = 0; i < n; i++)
+    {
+        float c[3];
+        for (int k = 0; k < 3; k++)
+            c[k] = (rgb[k] && alpha[i] != 0.0f) ? rgb[k][i] / alpha[i] : 0.0f;
+
+        switch (_mode) {
+            case CCIR601:
+                luma[i] = y_convert_ccir601(c[0], c[1], c[2]);
+                break;
+            case AVERAGE:
+                luma[i] = y_convert_avg(c[0], c[1], c[2]);
+                break;
+            case MAXIMUM:
+                luma[i] = y_convert_max(c[0], c[1], c[2]);
+                break;
+            default:
+                luma[i] = y_convert_rec709(c[0], c[1], c[2]);
+                break;
+        }
+    }
+
+    for (int lane = 0; lane < batch.lanes(); lane++)
+    {
+        const float* in = batch.in(lane);
+        float* out = batch.out(lane);
+        for (size_t i = 0; i < n; i++)
+            out[i] = in[i] * _saturation + luma[i] * (1.0f - _saturation);
+    }
+}
+
+
 void DeepCSaturation::custom_knobs(Knob_Callback f)
 {
     Float_knob(f, &_saturation, IRange(0, 4), "saturation");
@@ -3,6 +3,8 @@
 #include "DDImage/ChannelSet.h"
 #include "DDImage/Channel.h"
 
+#include "DeepChannelPlan.h"
+
 using namespace DD::Image;
 
 class DeepCShuffle : public DeepFilterOp
@@ -84,7 +86,14 @@ bool DeepCShuffle::doDeepEngine(DD::Image::Box bbox, const DD::Image::ChannelSet
 
     DeepInPlaceOutputPlane inPlaceOutPlane(requestedChannels, bbox);
     inPlaceOutPlane.reserveSamples(deepInPlane.getTotalSampleCount());
-    const DD::Image::ChannelSet inputChannels = input0()->deepInfo().channels();
+
+    // later rows win when two rows write the same output channel
+    static thread_local deepc::DeepChannelPlan plan;
+    plan.reset(deepInPlane.channels(), requestedChannels);
+    plan.route(_outChannel0, _inChannel0);
+    plan.route(_outChannel1, _inChannel1);
+    plan.route(_outChannel2, _inChannel2);
+    plan.route(_outChannel3, _inChannel3);
 
     for (Box::iterator it = bbox.begin(); it != bbox.end(); ++it)
     {
@@ -93,34 +102,12 @@ bool DeepCShuffle::doDeepEngine(DD::Image::Box bbox, const DD::Image::ChannelSet
 
         // Get the deep pixel from the input plane:
         DeepPixel deepInPixel = deepInPlane.getPixel(it);
-        size_t inPixelSamples = deepInPixel.getSampleCount();
-        ChannelSet inPixelChannels = deepInPixel.channels();
 
         inPlaceOutPlane.setSampleCount(it, deepInPixel.getSampleCount());
         DeepOutputPixel outPixel = inPlaceOutPlane.getPixel(it);
 
-        Channel inChannel;
         // copy samples to DeepOutputPlane
-        for (size_t sampleNo = 0; sampleNo < inPixelSamples; sampleNo++)
-        {
-            foreach (z, requestedChannels)
-            {
-                inChannel = z;
-                if (z == _outChannel0)
-                    inChannel = _inChannel0;
-                if (z == _outChannel1)
-                    inChannel = _inChannel1;
-                if (z == _outChannel2)
-                    inChannel = _inChannel2;
-                if (z == _outChannel3)
-                    inChannel = _inChannel3;
-                const float& inData = inPixelChannels.contains(inChannel) && inChannel != Chan_Black
-                                      ? deepInPixel.getUnorderedSample(sampleNo, inChannel)
-                                      : 0.0f;
-                float& outData = outPixel.getWritableUnorderedSample(sampleNo, z);
-                outData = inData;
-            }
-        }
+        plan.copyPixel(deepInPixel, outPixel);
     }
 
     // inPlaceOutPlane.reviseSamples();
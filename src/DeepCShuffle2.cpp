@@ -3,7 +3,7 @@
 #include "DDImage/Knobs.h"
 #include "DDImage/ChannelSet.h"
 #include "DDImage/Channel.h"
-#include <array>
+#include "DeepChannelPlan.h"
 #include <string>
 #include <sstream>
 
@@ -17,14 +17,10 @@ class DeepCShuffle2 : public DeepFilterOp
     ChannelSet  _out2ChannelSet;   // defaults to Chan_Black (none)
     std::string _matrixState;      // serialized routing, owned by Op; mirrored by knob store()
 
-    // Populated in _validate() by parsing _matrixState.
-    // Up to 8 active routing slots. Each slot specifies an output channel and
-    // either a source channel to copy from, or a constant 0.0 / 1.0 value.
-    std::array<Channel, 8> _outputChannels;      // active output channels
-    std::array<Channel, 8> _sourceChannels;      // source channel per output slot (Chan_Black if constant)
-    std::array<bool,    8> _sourceIsConstant;    // true if this slot outputs a constant value
-    std::array<float,   8> _sourceConstantValue; // constant value (0.0 or 1.0) when _sourceIsConstant
-    int _activeSlots;                            // number of active routing slots
+    // Populated in _validate() by parsing _matrixState: for every routed
+    // output channel, either a source channel to copy from or a constant
+    // 0.0 / 1.0 value. There is no limit on the number of routes.
+    deepc::DeepChannelRouting _routing;
 
 public:
 
@@ -34,11 +30,6 @@ public:
         _in2ChannelSet  = Chan_Black;
         _out1ChannelSet = Mask_RGBA;
         _out2ChannelSet = Chan_Black;
-        _activeSlots    = 0;
-        _outputChannels.fill(Chan_Black);
-        _sourceChannels.fill(Chan_Black);
-        _sourceIsConstant.fill(false);
-        _sourceConstantValue.fill(0.0f);
     }
 
     void _validate(bool for_real) override;
@@ -105,12 +96,8 @@ void DeepCShuffle2::_validate(bool for_real)
         }
     }
 
-    // Reset routing arrays
-    _outputChannels.fill(Chan_Black);
-    _sourceChannels.fill(Chan_Black);
-    _sourceIsConstant.fill(false);
-    _sourceConstantValue.fill(0.0f);
-    _activeSlots = 0;
+    // Reset routing table
+    _routing.clear();
 
     if (_matrixState.empty())
     {
@@ -118,14 +105,15 @@ void DeepCShuffle2::_validate(bool for_real)
         return;
     }
 
-    // Parse positional routing state: "out1:0:in1:2,out1:1:const:0,..." up to 8 slots.
+    // Parse positional routing state: "out1:0:in1:2,out1:1:const:0,...". When
+    // several tokens route to the same output channel, the first one wins.
     // Format per token: outGroup:outRowIdx:sourceGroup:sourceColIdx
     //   outGroup    "out1" | "out2"  → resolved via _out1ChannelSet / _out2ChannelSet
     //   sourceGroup "in1"  | "in2"  → resolved via _in1ChannelSet / _in2ChannelSet
     //               "const"         → constant; sourceColIdx 0 = 0.0f, 1 = 1.0f
     std::istringstream tokenStream(_matrixState);
     std::string token;
-    while (_activeSlots < 8 && std::getline(tokenStream, token, ','))
+    while (std::getline(tokenStream, token, ','))
     {
         if (token.empty())
             continue;
@@ -149,11 +137,7 @@ void DeepCShuffle2::_validate(bool for_real)
 
         if (sourceGroup == "const")
         {
-            _outputChannels[_activeSlots]      = outputChannel;
-            _sourceChannels[_activeSlots]      = Chan_Black;
-            _sourceIsConstant[_activeSlots]    = true;
-            _sourceConstantValue[_activeSlots] = (sourceColIdx == 0) ? 0.0f : 1.0f;
-            ++_activeSlots;
+            _routing.constant(outputChannel, (sourceColIdx == 0) ? 0.0f : 1.0f);
         }
         else
         {
@@ -163,22 +147,14 @@ void DeepCShuffle2::_validate(bool for_real)
             if (sourceChannel == Chan_Black)
                 continue;
 
-            _outputChannels[_activeSlots]      = outputChannel;
-            _sourceChannels[_activeSlots]      = sourceChannel;
-            _sourceIsConstant[_activeSlots]    = false;
-            _sourceConstantValue[_activeSlots] = 0.0f;
-            ++_activeSlots;
+            _routing.route(outputChannel, sourceChannel);
         }
     }
 
     // Build the output channel set: start from existing input channels and add
     // any routed output channels so downstream ops can request them.
     ChannelSet newChannelSet = _deepInfo.channels();
-    for (int routeIndex = 0; routeIndex < _activeSlots; ++routeIndex)
-    {
-        if (_outputChannels[routeIndex] != Chan_Black)
-            newChannelSet += _outputChannels[routeIndex];
-    }
+    newChannelSet += _routing.outputs();
     _deepInfo = DeepInfo(_deepInfo.formats(), _deepInfo.box(), newChannelSet);
 }
 
@@ -190,13 +166,9 @@ void DeepCShuffle2::getDeepRequests(Box bbox,
                                     int count,
                                     std::vector<RequestData>& requests)
 {
+    // Only request channels from input when the source is not a constant.
     ChannelSet neededChannels = requestedChannels;
-    for (int routeIndex = 0; routeIndex < _activeSlots; ++routeIndex)
-    {
-        // Only request channels from input when the source is not a constant.
-        if (!_sourceIsConstant[routeIndex] && _sourceChannels[routeIndex] != Chan_Black)
-            neededChannels += _sourceChannels[routeIndex];
-    }
+    neededChannels += _routing.inputs();
     requests.push_back(RequestData(input0(), bbox, neededChannels, count));
 }
 
@@ -211,11 +183,7 @@ bool DeepCShuffle2::doDeepEngine(DD::Image::Box bbox,
         return true;
 
     ChannelSet neededChannels = requestedChannels;
-    for (int routeIndex = 0; routeIndex < _activeSlots; ++routeIndex)
-    {
-        if (!_sourceIsConstant[routeIndex] && _sourceChannels[routeIndex] != Chan_Black)
-            neededChannels += _sourceChannels[routeIndex];
-    }
+    neededChannels += _routing.inputs();
 
     DeepPlane deepInPlane;
     if (!input0()->deepEngine(bbox, neededChannels, deepInPlane))
@@ -224,61 +192,21 @@ bool DeepCShuffle2::doDeepEngine(DD::Image::Box bbox,
     DeepInPlaceOutputPlane inPlaceOutPlane(requestedChannels, bbox);
     inPlaceOutPlane.reserveSamples(deepInPlane.getTotalSampleCount());
 
+    // Unrouted channels pass through; routed ones read their source or a
+    // constant. The plan is a gather table over this plane's layouts, built
+    // in one pass from the routing resolved in _validate.
+    static thread_local deepc::DeepChannelPlan plan;
+    plan.reset(deepInPlane.channels(), requestedChannels, _routing);
+
     for (Box::iterator it = bbox.begin(); it != bbox.end(); ++it)
     {
         if (Op::aborted())
             return false;
 
         DeepPixel deepInPixel = deepInPlane.getPixel(it);
-        size_t inPixelSamples = deepInPixel.getSampleCount();
-        ChannelSet inPixelChannels = deepInPixel.channels();
-
-        inPlaceOutPlane.setSampleCount(it, inPixelSamples);
+        inPlaceOutPlane.setSampleCount(it, deepInPixel.getSampleCount());
         DeepOutputPixel outPixel = inPlaceOutPlane.getPixel(it);
-
-        for (size_t sampleNo = 0; sampleNo < inPixelSamples; ++sampleNo)
-        {
-            foreach (z, requestedChannels)
-            {
-                float outputValue = 0.0f;
-
-                // Check whether this output channel has a routing override.
-                bool routeFound = false;
-                for (int routeIndex = 0; routeIndex < _activeSlots; ++routeIndex)
-                {
-                    if (_outputChannels[routeIndex] != Chan_Black &&
-                        z == _outputChannels[routeIndex])
-                    {
-                        if (_sourceIsConstant[routeIndex])
-                        {
-                            // Write the constant value (0.0 or 1.0).
-                            outputValue = _sourceConstantValue[routeIndex];
-                        }
-                        else
-                        {
-                            const Channel sourceChannel = _sourceChannels[routeIndex];
-                            outputValue =
-                                (inPixelChannels.contains(sourceChannel) && sourceChannel != Chan_Black)
-                                ? deepInPixel.getUnorderedSample(sampleNo, sourceChannel)
-                                : 0.0f;
-                        }
-                        routeFound = true;
-                        break;
-                    }
-                }
-
-                if (!routeFound)
-                {
-                    // No routing override — passthrough: copy the input channel unchanged.
-                    outputValue =
-                        (inPixelChannels.contains(z) && z != Chan_Black)
-                        ? deepInPixel.getUnorderedSample(sampleNo, z)
-                        : 0.0f;
-                }
-
-                outPixel.getWritableUnorderedSample(sampleNo, z) = outputValue;
-            }
-        }
+        plan.copyPixel(deepInPixel, outPixel);
     }
 
     mFnAssert(inPlaceOutPlane.isComplete());
@@ -0,0 +1,112 @@
+// SPDX-License-Identifier: MIT
+//
+// ============================================================================
+//
+//  DeepCSideMask — tile-level prefetch of a flat side mask
+//
+//  Deep engines mask by a 2D input sampled once per output pixel. Rather
+//  than asking the mask Iop for one Row per scanline, SideMask pulls the
+//  whole box as a single Tile, clamps (and optionally inverts) it into a
+//  dense buffer, and records for every row whether it is entirely 0 or
+//  entirely 1. Engines use those flags to forward fully masked rows verbatim
+//  instead of walking their samples.
+//
+//  Used by DeepCWrapper and DeepCKeymix.
+//
+// ============================================================================
+
+#ifndef DEEPC_SIDE_MASK_H
+#define DEEPC_SIDE_MASK_H
+
+#include "DDImage/Iop.h"
+#include "DDImage/Tile.h"
+#include "DDImage/Box.h"
+#include "DDImage/Channel.h"
+
+#include <vector>
+
+namespace deepc {
+
+class SideMask
+{
+    public:
+        SideMask() : _x(0), _y(0), _width(0), _height(0) {}
+
+        // Fetch channel z of iop over box, clamped to [0, 1] and inverted if
+        // asked. The mask must already have been requested for box. Returns
+        // false if the tile could not be filled (e.g. the user aborted).
+        bool fetch(DD::Image::Iop& iop, DD::Image::Channel z,
+                   const DD::Image::Box& box, bool invert)
+        {
+            _x = box.x();
+            _y = box.y();
+            _width = box.w();
+            _height = box.h();
+            _values.resize(static_cast<size_t>(_width) * _height);
+            _rowFlags.assign(_height, 0);
+            if (_width <= 0 || _height <= 0)
+                return true;
+
+            DD::Image::Tile tile(iop, box.x(), box.y(), box.r(), box.t(), z);
+            if (!tile.valid())
+                return false;
+
+            for (int row = 0; row < _height; row++)
+            {
+                const int y = _y + row;
+                float* out = _values.data() + static_cast<size_t>(row) * _width;
+                bool allZero = true;
+                bool allOne = true;
+                for (int col = 0; col < _width; col++)
+                {
+                    float v = tile[z][tile.clampy(y)][tile.clampx(_x + col)];
+                    // a NaN mask counts as 0
+                    v = v > 0.0f ? (v < 1.0f ? v : 1.0f) : 0.0f;
+                    if (invert)
+                        v = 1.0f - v;
+                    out[col] = v;
+                    allZero &= v == 0.0f;
+                    allOne &= v == 1.0f;
+                }
+                _rowFlags[row] = (allZero ? ALL_ZERO : 0) | (allOne ? ALL_ONE : 0);
+            }
+            return true;
+        }
+
+        // mask value at (x, y), which must lie inside the fetched box
+        float value(int x, int y) const
+        {
+            return _values[static_cast<size_t>(y - _y) * _width + (x - _x)];
+        }
+
+        // the mask values of row y, indexed from the box's left edge
+        const float* row(int y) const
+        {
+            return _values.data() + static_cast<size_t>(y - _y) * _width;
+        }
+
+        bool rowAllZero(int y) const { return (_rowFlags[y - _y] & ALL_ZERO) != 0; }
+        bool rowAllOne(int y) const { return (_rowFlags[y - _y] & ALL_ONE) != 0; }
+
+        // true if every row of the box is 0
+        bool allZero() const
+        {
+            for (size_t row = 0; row < _rowFlags.size(); row++)
+            {
+                if (!(_rowFlags[row] & ALL_ZERO))
+                    return false;
+            }
+            return true;
+        }
+
+    private:
+        enum { ALL_ZERO = 1, ALL_ONE = 2 };
+
+        int _x, _y, _width, _height;
+        std::vector<float> _values;
+        std::vector<unsigned char> _rowFlags;
+};
+
+} // namespace deepc
+
+#endif // DEEPC_SIDE_MASK_H
@@ -0,0 +1,714 @@
+// SPDX-License-Identifier: MIT
+//
+// ============================================================================
+//
+//  DeepCSimd — scalar, SSE4.1 and AVX2 implementations and runtime dispatch
+//
+//  The vector paths are compiled with per-function target attributes, so the
+//  rest of the plugin does not need to be built for AVX2 and still loads on
+//  older CPUs.
+//
+// ============================================================================
+
+#include "DeepCSimd.h"
+
+#include <cfloat>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define DEEPC_SIMD_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#endif
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+#define DEEPC_TARGET(isa) __attribute__((target(isa)))
+#else
+#define DEEPC_TARGET(isa)
+#endif
+
+namespace deepc {
+namespace simd {
+
+// ---------------------------------------------------------------------------
+// Constants shared by every implementation
+// ---------------------------------------------------------------------------
+
+static const float kSqrt2 = 1.41421356f;
+
+// 2 / (ln(2) * k) for k = 1, 3, 5, 7, 9 — log2(m) = t * P(t^2),
+// t = (m - 1) / (m + 1)
+static const float kLog1 = 2.88539008f;
+static const float kLog3 = 0.961796694f;
+static const float kLog5 = 0.577078016f;
+static const float kLog7 = 0.412198583f;
+static const float kLog9 = 0.320598897f;
+
+// ln(2)^k / k! for k = 1..6 — Taylor series of 2^f
+static const float kExp1 = 0.693147181f;
+static const float kExp2 = 0.240226507f;
+static const float kExp3 = 0.0555041087f;
+static const float kExp4 = 0.00961812911f;
+static const float kExp5 = 0.00133335581f;
+static const float kExp6 = 0.000154035304f;
+
+static const float kDenormScale = 8388608.0f; // 2^23
+static const float kDenormBits = 23.0f;
+
+static const float kExpMin = -127.0f; // scales by 2^-127 == 0, flushing to zero
+static const float kExpMax = 128.0f;
+
+// ---------------------------------------------------------------------------
+// Scalar reference
+// ---------------------------------------------------------------------------
+
+static inline int floatBits(float x)
+{
+    int i;
+    std::memcpy(&i, &x, sizeof(i));
+    return i;
+}
+
+static inline float bitsFloat(int i)
+{
+    float x;
+    std::memcpy(&x, &i, sizeof(x));
+    return x;
+}
+
+// x must be a finite, positive float
+static inline float log2Positive(float x)
+{
+    // lift denormals into the normal range first
+    const bool tiny = x < FLT_MIN;
+    const int bits = floatBits(tiny ? x * kDenormScale : x);
+    float k = static_cast<float>((bits >> 23) - 127);
+    k = tiny ? k - kDenormBits : k;
+    float m = bitsFloat((bits & 0x007fffff) | 0x3f800000);
+    if (m > kSqrt2)
+    {
+        m = m * 0.5f;
+        k = k + 1.0f;
+    }
+    const float t = (m - 1.0f) / (m + 1.0f);
+    const float t2 = t * t;
+    float p = kLog9;
+    p = p * t2 + kLog7;
+    p = p * t2 + kLog5;
+    p = p * t2 + kLog3;
+    p = p * t2 + kLog1;
+    return k + t * p;
+}
+
+float fastLog2(float x)
+{
+    if (!(x > 0.0f))
+        return x == 0.0f ? -std::numeric_limits<float>::infinity()
+                         : std::numeric_limits<float>::quiet_NaN();
+    if (x == std::numeric_limits<float>::infinity())
+        return x;
+    return log2Positive(x);
+}
+
+float fastExp2(float x)
+{
+    if (x != x)
+        return x;
+    x = x < kExpMin ? kExpMin : x;
+    x = x > kExpMax ? kExpMax : x;
+    const float n = std::floor(x + 0.5f);
+    const float f = x - n;
+    float p = kExp6;
+    p = p * f + kExp5;
+    p = p * f + kExp4;
+    p = p * f + kExp3;
+    p = p * f + kExp2;
+    p = p * f + kExp1;
+    p = p * f + 1.0f;
+    return p * bitsFloat((static_cast<int>(n) + 127) << 23);
+}
+
+// what pow(x, e) does with negative x: NaN unless e is an integer, in which
+// case the result is +-pow(-x, e)
+enum NegativeBase {
+    NEGATIVE_NAN = 0,
+    NEGATIVE_EVEN,
+    NEGATIVE_ODD
+};
+
+static NegativeBase negativeBase(float e)
+{
+    if (std::floor(e) != e)
+        return NEGATIVE_NAN;
+    return std::fmod(e, 2.0f) == 0.0f ? NEGATIVE_EVEN : NEGATIVE_ODD;
+}
+
+static inline float powPositive(float x, float e)
+{
+    if (x == 0.0f)
+        return 0.0f;
+    if (x == std::numeric_limits<float>::infinity())
+        return x;
+    return fastExp2(e * log2Positive(x));
+}
+
+static inline float powScalar(float x, float e, NegativeBase negative)
+{
+    if (x >= 0.0f)
+        return powPositive(x, e);
+    if (x != x || negative == NEGATIVE_NAN)
+        return std::numeric_limits<float>::quiet_NaN();
+    const float r = powPositive(-x, e);
+    return negative == NEGATIVE_ODD ? -r : r;
+}
+
+float fastPow(float x, float e)
+{
+    return powScalar(x, e, negativeBase(e));
+}
+
+static void affineScalar(const float* in, float* out, size_t n, float a, float b)
+{
+    for (size_t i = 0; i < n; i++)
+        out[i] = in[i] * a + b;
+}
+
+static void powerScalar(const float* in, float* out, size_t n, float e)
+{
+    const NegativeBase negative = negativeBase(e);
+    for (size_t i = 0; i < n; i++)
+        out[i] = powScalar(in[i], e, negative);
+}
+
+static void clampRangeScalar(float* data, size_t n, bool clampLow, float lo,
+                             bool clampHigh, float hi)
+{
+    for (size_t i = 0; i < n; i++)
+    {
+        if (clampLow && data[i] < lo)
+            data[i] = lo;
+        if (clampHigh && data[i] > hi)
+            data[i] = hi;
+    }
+}
+
+static void transformPointsScalar(const float* x, const float* y, const float* z,
+                                  float* ox, float* oy, float* oz, size_t n,
+                                  const float m[16])
+{
+    for (size_t i = 0; i < n; i++)
+    {
+        const float px = x[i];
+        const float py = y[i];
+        const float pz = z[i];
+        const float tx = px * m[0] + py * m[1] + pz * m[2] + m[3];
+        const float ty = px * m[4] + py * m[5] + pz * m[6] + m[7];
+        const float tz = px * m[8] + py * m[9] + pz * m[10] + m[11];
+        const float tw = px * m[12] + py * m[13] + pz * m[14] + m[15];
+        ox[i] = tx / tw;
+        oy[i] = ty / tw;
+        oz[i] = tz / tw;
+    }
+}
+
+// t is the position in the table, in entries; the index is clamped to the
+// first and last segments (NaN goes to 0 and stays NaN through t - index)
+static void lutScalar(const float* value, const float* slope, int lastSegment,
+                      float lo, float scale, const float* in, float* out,
+                      size_t n)
+{
+    const float last = static_cast<float>(lastSegment);
+    for (size_t i = 0; i < n; i++)
+    {
+        const float t = (in[i] - lo) * scale;
+        float clamped = t >= 0.0f ? t : 0.0f;
+        clamped = clamped < last ? clamped : last;
+        const int index = static_cast<int>(clamped);
+        const float f = t - static_cast<float>(index);
+        out[i] = value[index] + f * slope[index];
+    }
+}
+
+#ifdef DEEPC_SIMD_X86
+
+// ---------------------------------------------------------------------------
+// SSE4.1 — 4 samples at a time
+// ---------------------------------------------------------------------------
+
+DEEPC_TARGET("sse4.1")
+static inline __m128 powSse(__m128 x, __m128 e, NegativeBase negative)
+{
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 inf = _mm_set1_ps(std::numeric_limits<float>::infinity());
+    const __m128 sign = _mm_set1_ps(-0.0f);
+
+    // log2 of |x|, lifting denormals into the normal range first
+    const __m128 ax = _mm_andnot_ps(sign, x);
+    const __m128 tiny = _mm_cmplt_ps(ax, _mm_set1_ps(FLT_MIN));
+    const __m128i bits = _mm_castps_si128(
+        _mm_blendv_ps(ax, _mm_mul_ps(ax, _mm_set1_ps(kDenormScale)), tiny));
+    __m128 k = _mm_cvtepi32_ps(
+        _mm_sub_epi32(_mm_srli_epi32(bits, 23), _mm_set1_epi32(127)));
+    k = _mm_blendv_ps(k, _mm_sub_ps(k, _mm_set1_ps(kDenormBits)), tiny);
+    __m128 mant = _mm_castsi128_ps(_mm_or_si128(
+        _mm_and_si128(bits, _mm_set1_epi32(0x007fffff)),
+        _mm_set1_epi32(0x3f800000)));
+    const __m128 big = _mm_cmpgt_ps(mant, _mm_set1_ps(kSqrt2));
+    mant = _mm_blendv_ps(mant, _mm_mul_ps(mant, _mm_set1_ps(0.5f)), big);
+    k = _mm_blendv_ps(k, _mm_add_ps(k, one), big);
+    const __m128 t = _mm_div_ps(_mm_sub_ps(mant, one), _mm_add_ps(mant, one));
+    const __m128 t2 = _mm_mul_ps(t, t);
+    __m128 p = _mm_set1_ps(kLog9);
+    p = _mm_add_ps(_mm_mul_ps(p, t2), _mm_set1_ps(kLog7));
+    p = _mm_add_ps(_mm_mul_ps(p, t2), _mm_set1_ps(kLog5));
+    p = _mm_add_ps(_mm_mul_ps(p, t2), _mm_set1_ps(kLog3));
+    p = _mm_add_ps(_mm_mul_ps(p, t2), _mm_set1_ps(kLog1));
+    const __m128 lg = _mm_add_ps(k, _mm_mul_ps(t, p));
+
+    // exp2
+    __m128 y = _mm_mul_ps(e, lg);
+    y = _mm_max_ps(y, _mm_set1_ps(kExpMin));
+    y = _mm_min_ps(y, _mm_set1_ps(kExpMax));
+    const __m128 n = _mm_floor_ps(_mm_add_ps(y, _mm_set1_ps(0.5f)));
+    const __m128 f = _mm_sub_ps(y, n);
+    __m128 q = _mm_set1_ps(kExp6);
+    q = _mm_add_ps(_mm_mul_ps(q, f), _mm_set1_ps(kExp5));
+    q = _mm_add_ps(_mm_mul_ps(q, f), _mm_set1_ps(kExp4));
+    q = _mm_add_ps(_mm_mul_ps(q, f), _mm_set1_ps(kExp3));
+    q = _mm_add_ps(_mm_mul_ps(q, f), _mm_set1_ps(kExp2));
+    q = _mm_add_ps(_mm_mul_ps(q, f), _mm_set1_ps(kExp1));
+    q = _mm_add_ps(_mm_mul_ps(q, f), one);
+    const __m128 scale = _mm_castsi128_ps(_mm_slli_epi32(
+        _mm_add_epi32(_mm_cvtps_epi32(n), _mm_set1_epi32(127)), 23));
+    __m128 r = _mm_mul_ps(q, scale);
+
+    // special cases, as in powScalar
+    r = _mm_blendv_ps(r, inf, _mm_cmpeq_ps(ax, inf));
+    r = _mm_blendv_ps(r, zero, _mm_cmpeq_ps(ax, zero));
+    const __m128 negativeX = _mm_cmplt_ps(x, zero);
+    if (negative == NEGATIVE_NAN)
+        r = _mm_blendv_ps(r, _mm_set1_ps(std::numeric_limits<float>::quiet_NaN()), negativeX);
+    else if (negative == NEGATIVE_ODD)
+        r = _mm_blendv_ps(r, _mm_xor_ps(r, sign), negativeX);
+    r = _mm_blendv_ps(r, x, _mm_cmpunord_ps(x, x));
+    return r;
+}
+
+DEEPC_TARGET("sse4.1")
+static void affineSse(const float* in, float* out, size_t n, float a, float b)
+{
+    const __m128 va = _mm_set1_ps(a);
+    const __m128 vb = _mm_set1_ps(b);
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4)
+        _mm_storeu_ps(out + i, _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(in + i), va), vb));
+    affineScalar(in + i, out + i, n - i, a, b);
+}
+
+DEEPC_TARGET("sse4.1")
+static void powerSse(const float* in, float* out, size_t n, float e)
+{
+    const __m128 ve = _mm_set1_ps(e);
+    const NegativeBase negative = negativeBase(e);
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4)
+        _mm_storeu_ps(out + i, powSse(_mm_loadu_ps(in + i), ve, negative));
+    powerScalar(in + i, out + i, n - i, e);
+}
+
+DEEPC_TARGET("sse4.1")
+static void clampRangeSse(float* data, size_t n, bool clampLow, float lo,
+                          bool clampHigh, float hi)
+{
+    const __m128 vlo = _mm_set1_ps(lo);
+    const __m128 vhi = _mm_set1_ps(hi);
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4)
+    {
+        __m128 v = _mm_loadu_ps(data + i);
+        if (clampLow)
+            v = _mm_blendv_ps(v, vlo, _mm_cmplt_ps(v, vlo));
+        if (clampHigh)
+            v = _mm_blendv_ps(v, vhi, _mm_cmpgt_ps(v, vhi));
+        _mm_storeu_ps(data + i, v);
+    }
+    clampRangeScalar(data + i, n - i, clampLow, lo, clampHigh, hi);
+}
+
+DEEPC_TARGET("sse4.1")
+static inline __m128 rowSse(__m128 px, __m128 py, __m128 pz, const float* r)
+{
+    __m128 t = _mm_mul_ps(px, _mm_set1_ps(r[0]));
+    t = _mm_add_ps(t, _mm_mul_ps(py, _mm_set1_ps(r[1])));
+    t = _mm_add_ps(t, _mm_mul_ps(pz, _mm_set1_ps(r[2])));
+    return _mm_add_ps(t, _mm_set1_ps(r[3]));
+}
+
+DEEPC_TARGET("sse4.1")
+static void transformPointsSse(const float* x, const float* y, const float* z,
+                               float* ox, float* oy, float* oz, size_t n,
+                               const float m[16])
+{
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4)
+    {
+        const __m128 px = _mm_loadu_ps(x + i);
+        const __m128 py = _mm_loadu_ps(y + i);
+        const __m128 pz = _mm_loadu_ps(z + i);
+        const __m128 tw = rowSse(px, py, pz, m + 12);
+        const __m128 tx = rowSse(px, py, pz, m);
+        const __m128 ty = rowSse(px, py, pz, m + 4);
+        const __m128 tz = rowSse(px, py, pz, m + 8);
+        _mm_storeu_ps(ox + i, _mm_div_ps(tx, tw));
+        _mm_storeu_ps(oy + i, _mm_div_ps(ty, tw));
+        _mm_storeu_ps(oz + i, _mm_div_ps(tz, tw));
+    }
+    transformPointsScalar(x + i, y + i, z + i, ox + i, oy + i, oz + i, n - i, m);
+}
+
+DEEPC_TARGET("sse4.1")
+static void lutSse(const float* value, const float* slope, int lastSegment,
+                   float lo, float scale, const float* in, float* out, size_t n)
+{
+    const __m128 vlo = _mm_set1_ps(lo);
+    const __m128 vscale = _mm_set1_ps(scale);
+    const __m128 vlast = _mm_set1_ps(static_cast<float>(lastSegment));
+    const __m128 zero = _mm_setzero_ps();
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4)
+    {
+        const __m128 t = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(in + i), vlo), vscale);
+        // max returns its second operand for NaN
+        const __m128i index = _mm_cvttps_epi32(_mm_min_ps(_mm_max_ps(t, zero), vlast));
+        const __m128 f = _mm_sub_ps(t, _mm_cvtepi32_ps(index));
+        // no gather before AVX2
+        int k[4];
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(k), index);
+        const __m128 a = _mm_setr_ps(value[k[0]], value[k[1]], value[k[2]], value[k[3]]);
+        const __m128 d = _mm_setr_ps(slope[k[0]], slope[k[1]], slope[k[2]], slope[k[3]]);
+        _mm_storeu_ps(out + i, _mm_add_ps(a, _mm_mul_ps(f, d)));
+    }
+    lutScalar(value, slope, lastSegment, lo, scale, in + i, out + i, n - i);
+}
+
+// ---------------------------------------------------------------------------
+// AVX2 — 8 samples at a time
+// ---------------------------------------------------------------------------
+
+DEEPC_TARGET("avx2")
+static inline __m256 powAvx2(__m256 x, __m256 e, NegativeBase negative)
+{
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 one = _mm256_set1_ps(1.0f);
+    const __m256 inf = _mm256_set1_ps(std::numeric_limits<float>::infinity());
+    const __m256 sign = _mm256_set1_ps(-0.0f);
+
+    // log2 of |x|, lifting denormals into the normal range first
+    const __m256 ax = _mm256_andnot_ps(sign, x);
+    const __m256 tiny = _mm256_cmp_ps(ax, _mm256_set1_ps(FLT_MIN), _CMP_LT_OQ);
+    const __m256i bits = _mm256_castps_si256(
+        _mm256_blendv_ps(ax, _mm256_mul_ps(ax, _mm256_set1_ps(kDenormScale)), tiny));
+    __m256 k = _mm256_cvtepi32_ps(
+        _mm256_sub_epi32(_mm256_srli_epi32(bits, 23), _mm256_set1_epi32(127)));
+    k = _mm256_blendv_ps(k, _mm256_sub_ps(k, _mm256_set1_ps(kDenormBits)), tiny);
+    __m256 mant = _mm256_castsi256_ps(_mm256_or_si256(
+        _mm256_and_si256(bits, _mm256_set1_epi32(0x007fffff)),
+        _mm256_set1_epi32(0x3f800000)));
+    const __m256 big = _mm256_cmp_ps(mant, _mm256_set1_ps(kSqrt2), _CMP_GT_OQ);
+    mant = _mm256_blendv_ps(mant, _mm256_mul_ps(mant, _mm256_set1_ps(0.5f)), big);
+    k = _mm256_blendv_ps(k, _mm256_add_ps(k, one), big);
+    const __m256 t = _mm256_div_ps(_mm256_sub_ps(mant, one), _mm256_add_ps(mant, one));
+    const __m256 t2 = _mm256_mul_ps(t, t);
+    __m256 p = _mm256_set1_ps(kLog9);
+    p = _mm256_add_ps(_mm256_mul_ps(p, t2), _mm256_set1_ps(kLog7));
+    p = _mm256_add_ps(_mm256_mul_ps(p, t2), _mm256_set1_ps(kLog5));
+    p = _mm256_add_ps(_mm256_mul_ps(p, t2), _mm256_set1_ps(kLog3));
+    p = _mm256_add_ps(_mm256_mul_ps(p, t2), _mm256_set1_ps(kLog1));
+    const __m256 lg = _mm256_add_ps(k, _mm256_mul_ps(t, p));
+
+    // exp2
+    __m256 y = _mm256_mul_ps(e, lg);
+    y = _mm256_max_ps(y, _mm256_set1_ps(kExpMin));
+    y = _mm256_min_ps(y, _mm256_set1_ps(kExpMax));
+    const __m256 n = _mm256_floor_ps(_mm256_add_ps(y, _mm256_set1_ps(0.5f)));
+    const __m256 f = _mm256_sub_ps(y, n);
+    __m256 q = _mm256_set1_ps(kExp6);
+    q = _mm256_add_ps(_mm256_mul_ps(q, f), _mm256_set1_ps(kExp5));
+    q = _mm256_add_ps(_mm256_mul_ps(q, f), _mm256_set1_ps(kExp4));
+    q = _mm256_add_ps(_mm256_mul_ps(q, f), _mm256_set1_ps(kExp3));
+    q = _mm256_add_ps(_mm256_mul_ps(q, f), _mm256_set1_ps(kExp2));
+    q = _mm256_add_ps(_mm256_mul_ps(q, f), _mm256_set1_ps(kExp1));
+    q = _mm256_add_ps(_mm256_mul_ps(q, f), one);
+    const __m256 scale = _mm256_castsi256_ps(_mm256_slli_epi32(
+        _mm256_add_epi32(_mm256_cvtps_epi32(n), _mm256_set1_epi32(127)), 23));
+    __m256 r = _mm256_mul_ps(q, scale);
+
+    // special cases, as in powScalar
+    r = _mm256_blendv_ps(r, inf, _mm256_cmp_ps(ax, inf, _CMP_EQ_OQ));
+    r = _mm256_blendv_ps(r, zero, _mm256_cmp_ps(ax, zero, _CMP_EQ_OQ));
+    const __m256 negativeX = _mm256_cmp_ps(x, zero, _CMP_LT_OQ);
+    if (negative == NEGATIVE_NAN)
+        r = _mm256_blendv_ps(r, _mm256_set1_ps(std::numeric_limits<float>::quiet_NaN()), negativeX);
+    else if (negative == NEGATIVE_ODD)
+        r = _mm256_blendv_ps(r, _mm256_xor_ps(r, sign), negativeX);
+    r = _mm256_blendv_ps(r, x, _mm256_cmp_ps(x, x, _CMP_UNORD_Q));
+    return r;
+}
+
+DEEPC_TARGET("avx2")
+static void affineAvx2(const float* in, float* out, size_t n, float a, float b)
+{
+    const __m256 va = _mm256_set1_ps(a);
+    const __m256 vb = _mm256_set1_ps(b);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8)
+        _mm256_storeu_ps(out + i, _mm256_add_ps(_mm256_mul_ps(_mm256_loadu_ps(in + i), va), vb));
+    affineScalar(in + i, out + i, n - i, a, b);
+}
+
+DEEPC_TARGET("avx2")
+static void powerAvx2(const float* in, float* out, size_t n, float e)
+{
+    const __m256 ve = _mm256_set1_ps(e);
+    const NegativeBase negative = negativeBase(e);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8)
+        _mm256_storeu_ps(out + i, powAvx2(_mm256_loadu_ps(in + i), ve, negative));
+    powerScalar(in + i, out + i, n - i, e);
+}
+
+DEEPC_TARGET("avx2")
+static void clampRangeAvx2(float* data, size_t n, bool clampLow, float lo,
+                           bool clampHigh, float hi)
+{
+    const __m256 vlo = _mm256_set1_ps(lo);
+    const __m256 vhi = _mm256_set1_ps(hi);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        __m256 v = _mm256_loadu_ps(data + i);
+        if (clampLow)
+            v = _mm256_blendv_ps(v, vlo, _mm256_cmp_ps(v, vlo, _CMP_LT_OQ));
+        if (clampHigh)
+            v = _mm256_blendv_ps(v, vhi, _mm256_cmp_ps(v, vhi, _CMP_GT_OQ));
+        _mm256_storeu_ps(data + i, v);
+    }
+    clampRangeScalar(data + i, n - i, clampLow, lo, clampHigh, hi);
+}
+
+DEEPC_TARGET("avx2")
+static inline __m256 rowAvx2(__m256 px, __m256 py, __m256 pz, const float* r)
+{
+    __m256 t = _mm256_mul_ps(px, _mm256_set1_ps(r[0]));
+    t = _mm256_add_ps(t, _mm256_mul_ps(py, _mm256_set1_ps(r[1])));
+    t = _mm256_add_ps(t, _mm256_mul_ps(pz, _mm256_set1_ps(r[2])));
+    return _mm256_add_ps(t, _mm256_set1_ps(r[3]));
+}
+
+DEEPC_TARGET("avx2")
+static void transformPointsAvx2(const float* x, const float* y, const float* z,
+                                float* ox, float* oy, float* oz, size_t n,
+                                const float m[16])
+{
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        const __m256 px = _mm256_loadu_ps(x + i);
+        const __m256 py = _mm256_loadu_ps(y + i);
+        const __m256 pz = _mm256_loadu_ps(z + i);
+        const __m256 tw = rowAvx2(px, py, pz, m + 12);
+        const __m256 tx = rowAvx2(px, py, pz, m);
+        const __m256 ty = rowAvx2(px, py, pz, m + 4);
+        const __m256 tz = rowAvx2(px, py, pz, m + 8);
+        _mm256_storeu_ps(ox + i, _mm256_div_ps(tx, tw));
+        _mm256_storeu_ps(oy + i, _mm256_div_ps(ty, tw));
+        _mm256_storeu_ps(oz + i, _mm256_div_ps(tz, tw));
+    }
+    transformPointsScalar(x + i, y + i, z + i, ox + i, oy + i, oz + i, n - i, m);
+}
+
+DEEPC_TARGET("avx2")
+static void lutAvx2(const float* value, const float* slope, int lastSegment,
+                    float lo, float scale, const float* in, float* out, size_t n)
+{
+    const __m256 vlo = _mm256_set1_ps(lo);
+    const __m256 vscale = _mm256_set1_ps(scale);
+    const __m256 vlast = _mm256_set1_ps(static_cast<float>(lastSegment));
+    const __m256 zero = _mm256_setzero_ps();
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        const __m256 t = _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(in + i), vlo), vscale);
+        // max returns its second operand for NaN
+        const __m256i index = _mm256_cvttps_epi32(_mm256_min_ps(_mm256_max_ps(t, zero), vlast));
+        const __m256 f = _mm256_sub_ps(t, _mm256_cvtepi32_ps(index));
+        const __m256 a = _mm256_i32gather_ps(value, index, 4);
+        const __m256 d = _mm256_i32gather_ps(slope, index, 4);
+        _mm256_storeu_ps(out + i, _mm256_add_ps(a, _mm256_mul_ps(f, d)));
+    }
+    lutScalar(value, slope, lastSegment, lo, scale, in + i, out + i, n - i);
+}
+
+// ---------------------------------------------------------------------------
+// CPU detection
+// ---------------------------------------------------------------------------
+
+static Isa detectIsa()
+{
+#if defined(_MSC_VER) && !defined(__clang__)
+    int info[4];
+    __cpuid(info, 1);
+    const bool sse41 = (info[2] & (1 << 19)) != 0;
+    const bool osxsave = (info[2] & (1 << 27)) != 0;
+    const bool avx = (info[2] & (1 << 28)) != 0;
+    bool avx2 = false;
+    if (osxsave && avx && (_xgetbv(0) & 0x6) == 0x6)
+    {
+        __cpuidex(info, 7, 0);
+        avx2 = (info[1] & (1 << 5)) != 0;
+    }
+#else
+    __builtin_cpu_init();
+    const bool sse41 = __builtin_cpu_supports("sse4.1");
+    const bool avx2 = __builtin_cpu_supports("avx2");
+#endif
+    if (avx2)
+        return ISA_AVX2;
+    if (sse41)
+        return ISA_SSE41;
+    return ISA_SCALAR;
+}
+
+#else
+
+static Isa detectIsa()
+{
+    return ISA_SCALAR;
+}
+
+#endif // DEEPC_SIMD_X86
+
+// ---------------------------------------------------------------------------
+// Dispatch
+// ---------------------------------------------------------------------------
+
+static Isa selectIsa()
+{
+    Isa isa = detectIsa();
+    // allow capping the instruction set, never raising it
+    const char* env = std::getenv("DEEPC_SIMD");
+    if (env)
+    {
+        if (std::strcmp(env, "scalar") == 0)
+            isa = ISA_SCALAR;
+        else if (std::strcmp(env, "sse4") == 0 && isa > ISA_SSE41)
+            isa = ISA_SSE41;
+    }
+    return isa;
+}
+
+struct Kernels {
+    void (*affine)(const float*, float*, size_t, float, float);
+    void (*power)(const float*, float*, size_t, float);
+    void (*clampRange)(float*, size_t, bool, float, bool, float);
+    void (*transformPoints)(const float*, const float*, const float*,
+                            float*, float*, float*, size_t, const float*);
+    void (*lut)(const float*, const float*, int, float, float,
+                const float*, float*, size_t);
+};
+
+static Kernels selectKernels(Isa isa)
+{
+    Kernels k = { affineScalar, powerScalar, clampRangeScalar,
+                  transformPointsScalar, lutScalar };
+#ifdef DEEPC_SIMD_X86
+    if (isa == ISA_AVX2)
+    {
+        k.affine = affineAvx2;
+        k.power = powerAvx2;
+        k.clampRange = clampRangeAvx2;
+        k.transformPoints = transformPointsAvx2;
+        k.lut = lutAvx2;
+    } else if (isa == ISA_SSE41)
+    {
+        k.affine = affineSse;
+        k.power = powerSse;
+        k.clampRange = clampRangeSse;
+        k.transformPoints = transformPointsSse;
+        k.lut = lutSse;
+    }
+#endif
+    return k;
+}
+
+static const Kernels& kernels()
+{
+    static const Kernels k = selectKernels(activeIsa());
+    return k;
+}
+
+Isa activeIsa()
+{
+    static const Isa isa = selectIsa();
+    return isa;
+}
+
+const char* isaName(Isa isa)
+{
+    switch (isa) {
+        case ISA_AVX2:
+            return "avx2";
+        case ISA_SSE41:
+            return "sse4";
+        default:
+            return "scalar";
+    }
+}
+
+void affine(const float* in, float* out, size_t n, float a, float b)
+{
+    kernels().affine(in, out, n, a, b);
+}
+
+void power(const float* in, float* out, size_t n, float e)
+{
+    kernels().power(in, out, n, e);
+}
+
+void clampRange(float* data, size_t n, bool clampLow, float lo,
+                bool clampHigh, float hi)
+{
+    if (!clampLow && !clampHigh)
+        return;
+    kernels().clampRange(data, n, clampLow, lo, clampHigh, hi);
+}
+
+void transformPoints(const float* x, const float* y, const float* z,
+                     float* ox, float* oy, float* oz, size_t n,
+                     const float m[16])
+{
+    kernels().transformPoints(x, y, z, ox, oy, oz, n, m);
+}
+
+float Lut1D::lookup(float x) const
+{
+    float out;
+    lutScalar(_value.data(), _slope.data(), static_cast<int>(_slope.size()) - 1,
+              _lo, _scale, &x, &out, 1);
+    return out;
+}
+
+void Lut1D::apply(const float* in, float* out, size_t n) const
+{
+    kernels().lut(_value.data(), _slope.data(), static_cast<int>(_slope.size()) - 1,
+                  _lo, _scale, in, out, n);
+}
+
+} // namespace simd
+} // namespace deepc
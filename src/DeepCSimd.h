@@ -0,0 +1,130 @@
+// SPDX-License-Identifier: MIT
+//
+// ============================================================================
+//
+//  DeepCSimd — vectorized float kernels for the wrapped colour nodes
+//
+//  Array kernels used by the DeepCWrapper batch API (DeepCSampleBatch): an
+//  affine ramp, a fast power function, range clamps, a projective point
+//  transform for position data and baked 1D lookup tables. Each kernel has
+//  scalar, SSE4.1 and AVX2 implementations; the best one the CPU supports is
+//  picked once, at first use.
+//
+//  All implementations perform the same float operations in the same
+//  order (no FMA), so results do not depend on which one runs.
+//
+//  The DEEPC_SIMD environment variable ("scalar", "sse4" or "avx2") caps the
+//  instruction set used, which is handy for debugging and benchmarking.
+//
+//  Zero Nuke SDK dependencies — only standard library headers.
+//
+// ============================================================================
+
+#ifndef DEEPC_SIMD_H
+#define DEEPC_SIMD_H
+
+#include <cstddef>
+#include <vector>
+
+namespace deepc {
+namespace simd {
+
+enum Isa {
+    ISA_SCALAR = 0,
+    ISA_SSE41,
+    ISA_AVX2
+};
+
+// instruction set the kernels below dispatch to
+Isa activeIsa();
+const char* isaName(Isa isa);
+
+// ---------------------------------------------------------------------------
+// fastLog2 / fastExp2 / fastPow — scalar reference approximations
+//
+// log2 reduces the mantissa to [sqrt(0.5), sqrt(2)) and evaluates a 5-term
+// atanh series; exp2 splits off the nearest integer and evaluates a degree 6
+// polynomial on [-0.5, 0.5]. Both are accurate to a few float ulps.
+//
+// fastPow(x, e) = exp2(e * log2(x)), e > 0. Its relative error is below
+// 3e-7 * (1 + |e * log2(x)|): under 1e-6 for results in [2^-10, 2^10] and
+// under 2e-5 anywhere in float range — well below anything visible in an
+// image. Special cases follow std::pow: pow(0, e) = 0, pow(inf, e) = inf, NaN
+// stays NaN, negative x give NaN unless e is an integer. Results below
+// 2^-126.5 flush to zero and results beyond 2^127.5 saturate to inf.
+// ---------------------------------------------------------------------------
+float fastLog2(float x);
+float fastExp2(float x);
+float fastPow(float x, float e);
+
+// ---------------------------------------------------------------------------
+// Array kernels — in and out may alias
+// ---------------------------------------------------------------------------
+
+// out[i] = in[i] * a + b
+void affine(const float* in, float* out, size_t n, float a, float b);
+
+// out[i] = fastPow(in[i], e), e > 0
+void power(const float* in, float* out, size_t n, float e);
+
+// data[i] = lo where data[i] < lo (if clampLow), hi where data[i] > hi (if
+// clampHigh); NaNs are left alone
+void clampRange(float* data, size_t n, bool clampLow, float lo,
+                bool clampHigh, float hi);
+
+// (ox, oy, oz) = (m * (x, y, z, 1)).divide_w() for n points stored as
+// separate x, y and z arrays; m is a row-major 4x4 matrix. Outputs may alias
+// the inputs.
+void transformPoints(const float* x, const float* y, const float* z,
+                     float* ox, float* oy, float* oz, size_t n,
+                     const float m[16]);
+
+// ---------------------------------------------------------------------------
+// Lut1D — a curve baked into a dense table
+//
+// bake() samples f at size points evenly spaced over [lo, hi]; lookups
+// interpolate linearly between them. Inputs outside [lo, hi] extend the end
+// segments, so HDR values keep the slope the curve has at the ends of the
+// range. NaN stays NaN.
+// ---------------------------------------------------------------------------
+class Lut1D
+{
+    public:
+        Lut1D() : _lo(0.0f), _scale(0.0f) {}
+
+        // size >= 2, hi > lo; f is called once per table entry
+        template <class F>
+        void bake(F f, float lo, float hi, size_t size)
+        {
+            _value.resize(size);
+            _slope.resize(size - 1);
+            for (size_t i = 0; i < size; i++)
+                _value[i] = f(lo + (hi - lo) * (static_cast<float>(i) / static_cast<float>(size - 1)));
+            for (size_t i = 0; i + 1 < size; i++)
+                _slope[i] = _value[i + 1] - _value[i];
+            _lo = lo;
+            _scale = static_cast<float>(size - 1) / (hi - lo);
+        }
+
+        bool empty() const { return _value.empty(); }
+        void clear() { _value.clear(); _slope.clear(); }
+
+        // scalar reference for apply()
+        float lookup(float x) const;
+
+        // out[i] = lookup(in[i]); in and out may alias
+        void apply(const float* in, float* out, size_t n) const;
+
+    private:
+        std::vector<float> _value;
+        // _value[i + 1] - _value[i]
+        std::vector<float> _slope;
+        float _lo;
+        // table entries per unit
+        float _scale;
+};
+
+} // namespace simd
+} // namespace deepc
+
+#endif // DEEPC_SIMD_H
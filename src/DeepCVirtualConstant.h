@@ -0,0 +1,52 @@
+// SPDX-License-Identifier: MIT
+//
+// ============================================================================
+//
+//  DeepCVirtualConstant — reading a DeepCConstant one pixel at a time
+//
+//  Every pixel a DeepCConstant produces holds the same samples, wherever it
+//  is. With its "virtual constant" knob on, downstream DeepC nodes may ask
+//  it for a single pixel and reuse that pixel for their whole box instead of
+//  having it fill a plane of identical pixels — at 4K with 64 samples that
+//  plane is gigabytes of repeated floats.
+//
+//  Plugins are separate libraries, so the source is recognised by its class
+//  name and knob rather than through a shared C++ interface.
+//
+//  Used by DeepCConstant and DeepCKeymix.
+//
+// ============================================================================
+
+#ifndef DEEPC_VIRTUAL_CONSTANT_H
+#define DEEPC_VIRTUAL_CONSTANT_H
+
+#include "DDImage/Op.h"
+#include "DDImage/Knob.h"
+#include "DDImage/Box.h"
+
+#include <cstring>
+
+namespace deepc {
+
+// name of the DeepCConstant knob that allows single pixel reads
+static const char* const virtualConstantKnobName = "virtual_constant";
+
+// true if op gives the same samples at every pixel and allows downstream
+// nodes to read just one of them
+inline bool isVirtualConstant(DD::Image::Op* op)
+{
+    if (!op || strcmp(op->Class(), "DeepCConstant") != 0)
+        return false;
+    DD::Image::Knob* k = op->knob(virtualConstantKnobName);
+    return k && k->get_value() != 0.0;
+}
+
+// the single pixel to ask a virtual constant for in place of box
+inline DD::Image::Box virtualConstantBox(const DD::Image::Box& box)
+{
+    return DD::Image::Box(box.x(), box.y(), box.x() + 1, box.y() + 1);
+}
+
+} // namespace deepc
+
+#endif // DEEPC_VIRTUAL_CONSTANT_H
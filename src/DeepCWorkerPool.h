@@ -0,0 +1,134 @@
+// SPDX-License-Identifier: MIT
+//
+// ============================================================================
+//
+//  DeepCWorkerPool — process-wide helper threads for splitting one tile
+//
+//  Nuke already runs one engine thread per core, so an engine that wants
+//  help with an unusually expensive tile must not spawn threads of its own:
+//  with every engine doing so a render ends up with cores² threads, each
+//  starting with cold thread_local scratch. Instead a single pool of
+//  persistent helpers is shared by every node in the process. It grows on
+//  demand up to the number of cores and is never torn down.
+//
+//  run() hands a job to up to `helpers` pool threads and also runs it on the
+//  calling thread. Jobs are expected to claim their work from a shared
+//  counter, so a helper that only gets round to the job once the caller has
+//  finished it simply skips it; run() never waits for queued, unstarted
+//  helpers, only for those already inside the job.
+//
+//  Zero Nuke SDK dependencies — only standard library headers.
+//
+// ============================================================================
+
+#ifndef DEEPC_WORKER_POOL_H
+#define DEEPC_WORKER_POOL_H
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace deepc {
+
+class WorkerPool
+{
+    public:
+        // the pool shared by every node; deliberately leaked so that no
+        // helper is joined while plugins are being unloaded
+        static WorkerPool& shared()
+        {
+            static WorkerPool* pool = new WorkerPool;
+            return *pool;
+        }
+
+        // Run job on this thread and on up to helpers pool threads, and
+        // return once every thread that started it has finished.
+        void run(int helpers, const std::function<void()>& job)
+        {
+            helpers = std::min(helpers, maxHelpers());
+            if (helpers <= 0)
+            {
+                job();
+                return;
+            }
+
+            std::shared_ptr<Batch> batch = std::make_shared<Batch>();
+            batch->job = &job;
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                while (static_cast<int>(_threads.size()) < helpers)
+                    _threads.emplace_back(&WorkerPool::helperLoop, this);
+                for (int i = 0; i < helpers; i++)
+                    _queue.push_back(batch);
+            }
+            _wake.notify_all();
+
+            job();
+
+            std::unique_lock<std::mutex> lock(batch->mutex);
+            batch->closed = true;
+            batch->done.wait(lock, [&] { return batch->active == 0; });
+        }
+
+    private:
+        struct Batch
+        {
+            Batch() : job(nullptr), active(0), closed(false) {}
+
+            const std::function<void()>* job;
+            std::mutex mutex;
+            std::condition_variable done;
+            int active;
+            // set once the caller is done; late helpers skip the job
+            bool closed;
+        };
+
+        WorkerPool() {}
+
+        static int maxHelpers()
+        {
+            const int cores = static_cast<int>(std::thread::hardware_concurrency());
+            return std::max(1, cores - 1);
+        }
+
+        void helperLoop()
+        {
+            for (;;)
+            {
+                std::shared_ptr<Batch> batch;
+                {
+                    std::unique_lock<std::mutex> lock(_mutex);
+                    _wake.wait(lock, [&] { return !_queue.empty(); });
+                    batch = _queue.front();
+                    _queue.pop_front();
+                }
+
+                {
+                    std::lock_guard<std::mutex> lock(batch->mutex);
+                    if (batch->closed)
+                        continue;
+                    batch->active++;
+                }
+                (*batch->job)();
+                {
+                    std::lock_guard<std::mutex> lock(batch->mutex);
+                    batch->active--;
+                }
+                batch->done.notify_all();
+            }
+        }
+
+        std::mutex _mutex;
+        std::condition_variable _wake;
+        std::deque<std::shared_ptr<Batch> > _queue;
+        std::vector<std::thread> _threads;
+};
+
+} // namespace deepc
+
+#endif // DEEPC_WORKER_POOL_H
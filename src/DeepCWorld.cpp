@@ -5,10 +5,13 @@
 #include "DDImage/DDMath.h"
 #include "DDImage/Matrix4.h"
 
+#include "DeepChannelPlan.h"
+#include "DeepCSimd.h"
 
 #include <stdio.h>
 #include <math.h>
 #include <iostream>
+#include <vector>
 
 using namespace DD::Image;
 
@@ -40,6 +43,10 @@ class DeepCWorld : public DeepPixelOp
     Matrix4 window_matrix;
     Matrix4 _inverse_window_matrix;
 
+    // camera_world_matrix * _inverse_window_matrix, row-major, for the
+    // batched transform in doDeepEngine
+    float _camera_to_world[16];
+
 public:
     DeepCWorld(Node* node) : DeepPixelOp(node),
     output_channelset(Chan_Black),
@@ -57,11 +64,7 @@ public:
     const char* node_help() const { return HELP; }
 
 
-    // Wrapper function to work around the "non-virtual thunk" issue on linux when symbol hiding is enabled.
-    virtual bool doDeepEngine(DD::Image::Box box, const ChannelSet &channels, DeepOutputPlane &plane)
-    {
-        return DeepPixelOp::doDeepEngine(box, channels, plane);
-    }
+    virtual bool doDeepEngine(DD::Image::Box box, const ChannelSet &channels, DeepOutputPlane &plane);
 
 
     // Wrapper function to work around the "non-virtual thunk" issue on linux when symbol hiding is enabled.
@@ -165,6 +168,13 @@ void DeepCWorld::_validate(bool for_real)
 
     }
 
+    const Matrix4 camera_to_world = camera_world_matrix * _inverse_window_matrix;
+    for (int row = 0; row < 4; row++)
+    {
+        for (int col = 0; col < 4; col++)
+            _camera_to_world[row * 4 + col] = camera_to_world(row, col);
+    }
+
     DeepPixelOp::_validate(for_real);
 
     // TODO: test if we need this new ChannelSet or if we can just assign
@@ -178,6 +188,146 @@ void DeepCWorld::_validate(bool for_real)
     _deepInfo = DeepInfo(_deepInfo.formats(), _deepInfo.box(), new_channelset);
 }
 
+/*
+Tile engine: the same maths as processSample, but the camera matrices are
+combined once in _validate, the camera rays are worked out once per row and
+column, and each row's samples go through one batched transform.
+*/
+bool DeepCWorld::doDeepEngine(DD::Image::Box box, const ChannelSet& channels, DeepOutputPlane& plane)
+{
+    if (!input0())
+        return true;
+
+    ChannelSet neededChannels = channels;
+    in_channels(0, neededChannels);
+
+    DeepPlane inPlane;
+    if (!input0()->deepEngine(box, neededChannels, inPlane))
+        return false;
+
+    DeepInPlaceOutputPlane outPlane(channels, box);
+    outPlane.reserveSamples(inPlane.getTotalSampleCount());
+
+    // everything but the position channels is copied through; position
+    // channels past the third are 0
+    static thread_local deepc::DeepChannelPlan channelPlan;
+    static thread_local std::vector<int> positionSlots;
+    static thread_local std::vector<int> positionAxes;
+    channelPlan.reset(inPlane.channels(), channels);
+    positionSlots.clear();
+    positionAxes.clear();
+    foreach(z, channels)
+    {
+        if (!(output_channelset & z))
+            continue;
+        channelPlan.constant(z, 0.0f);
+        if (colourIndex(z) < 3)
+        {
+            positionSlots.push_back(channelPlan.slotOf(z));
+            positionAxes.push_back(colourIndex(z));
+        }
+    }
+
+    const ChannelMap& inChannels = inPlane.channels();
+    const int frontOffset = inChannels.contains(Chan_DeepFront) ? inChannels.chanNo(Chan_DeepFront) : -1;
+    const int backOffset = inChannels.contains(Chan_DeepBack) ? inChannels.chanNo(Chan_DeepBack) : -1;
+    const int alphaOffset = inChannels.contains(Chan_Alpha) ? inChannels.chanNo(Chan_Alpha) : -1;
+
+    // camera-space ray through each column and row, at unit depth
+    const float scale_x = (haperture * 0.5f) / focal_length;
+    const float scale_y = (vaperture * 0.5f) / focal_length;
+    float uvx;
+    float uvy;
+    static thread_local std::vector<float> ray_x;
+    ray_x.resize(box.w());
+    for (int x = box.x(); x < box.r(); x++)
+    {
+        convertibleFormat()->to_uv((float)x, (float)box.y(), uvx, uvy);
+        ray_x[x - box.x()] = scale_x * (uvx * 2.0f - 1.0f);
+    }
+
+    static thread_local std::vector<float> position[3];
+    static thread_local std::vector<float> alphas;
+    static thread_local std::vector<float*> outSamples;
+
+    Box::iterator it = box.begin();
+    while (it != box.end())
+    {
+        if (Op::aborted())
+            return false; // bail fast on user-interrupt
+
+        const int y = it.y;
+        convertibleFormat()->to_uv((float)box.x(), (float)y, uvx, uvy);
+        const float ray_y = scale_y * (uvy * 2.0f - 1.0f);
+
+        for (int axis = 0; axis < 3; axis++)
+            position[axis].clear();
+        alphas.clear();
+        outSamples.clear();
+
+        // copy the row through and lay out its camera-space positions; the
+        // output samples stay put as the whole plane was reserved up front
+        for (; it != box.end() && it.y == y; ++it)
+        {
+            DeepPixel inPixel = inPlane.getPixel(it);
+            const size_t samples = inPixel.getSampleCount();
+            outPlane.setSampleCount(it, samples);
+            DeepOutputPixel outPixel = outPlane.getPixel(it);
+            const float ray = ray_x[it.x - box.x()];
+
+            for (size_t sampleNo = 0; sampleNo < samples; sampleNo++)
+            {
+                const float* inData = inPixel.getUnorderedSample(sampleNo);
+                float* outData = outPixel.getWritableUnorderedSample(sampleNo);
+                channelPlan.copySample(inData, outData);
+                outSamples.push_back(outData);
+
+                const float front = frontOffset < 0 ? 0.0f : inData[frontOffset];
+                const float back = backOffset < 0 ? 0.0f : inData[backOffset];
+                float depth;
+                switch (_depthSampleType)
+                {
+                    case 0:
+                        depth = front;
+                        break;
+                    case 1:
+                        depth = back;
+                        break;
+                    default:
+                        depth = (front + back) * .5f;
+                        break;
+                }
+                position[0].push_back(ray * depth);
+                position[1].push_back(ray_y * depth);
+                position[2].push_back(-1.0f * depth);
+                if (_premultOutput)
+                    alphas.push_back(alphaOffset < 0 ? 0.0f : inData[alphaOffset]);
+            }
+        }
+
+        const size_t n = outSamples.size();
+        if (n == 0 || positionSlots.empty())
+            continue;
+
+        deepc::simd::transformPoints(
+            position[0].data(), position[1].data(), position[2].data(),
+            position[0].data(), position[1].data(), position[2].data(),
+            n, _camera_to_world
+            );
+
+        for (size_t i = 0; i < n; i++)
+        {
+            const float alpha = _premultOutput ? alphas[i] : 1.0f;
+            for (size_t j = 0; j < positionSlots.size(); j++)
+                outSamples[i][positionSlots[j]] = position[positionAxes[j]][i] * alpha;
+        }
+    }
+
+    mFnAssert(outPlane.isComplete());
+    plane = outPlane;
+    return true;
+}
+
 void DeepCWorld::processSample(
     int y,
     int x,
@@ -1,7 +1,20 @@
 #include "DeepCWrapper.h"
+#include "DeepCSideMask.h"
+#include "DeepChannelPlan.h"
+
+#include <algorithm>
 
 using namespace DD::Image;
 
+/*
+The channels processed as lanes. Just the channels knob by default; subclasses
+which write to channels of their own add them here.
+*/
+void DeepCWrapper::findProcessChannels(ChannelSet& processChannels)
+{
+    processChannels = _processChannelSet;
+}
+
 /*
 Get all the channels we need - in addition to any requested from downstream -
 together in one convenient place. Subclasses should call the parent
@@ -10,7 +23,7 @@ implementation before their own.
 void DeepCWrapper::findNeededDeepChannels(ChannelSet& neededDeepChannels)
 {
     neededDeepChannels = Chan_Black;
-    neededDeepChannels += _processChannelSet;
+    neededDeepChannels += _allProcessChannels;
     if (_doDeepMask)
         neededDeepChannels += _deepMaskChannel;
     if (_unpremult || _unpremultDeepMask)
@@ -49,6 +62,7 @@ void DeepCWrapper::_validate(bool for_real)
     }
 
     // set up our needed channels
+    findProcessChannels(_allProcessChannels);
     findNeededDeepChannels(_allNeededDeepChannels);
 
     DeepFilterOp::_validate(for_real);
@@ -66,12 +80,31 @@ void DeepCWrapper::getDeepRequests(
         return;
     DD::Image::ChannelSet requestChannels = channels;
     requestChannels += _allNeededDeepChannels;
-    requests.push_back(RequestData(input0(), bbox, requestChannels, count));
+    requests.push_back(RequestData(input0(), paddedInputBox(bbox), requestChannels, count));
 
     if (_doSideMask)
         _maskOp->request(bbox, _sideMaskChannel, count);
 }
 
+/*
+The input box an engine for box fetches: box itself, grown on each side by
+inputPadding() as far as the input has anything to offer.
+*/
+Box DeepCWrapper::paddedInputBox(const Box& box) const
+{
+    const int padding = inputPadding();
+    if (padding <= 0 || !input0())
+        return box;
+
+    const Box& inBox = input0()->deepInfo().box();
+    return Box(
+        MIN(box.x(), MAX(box.x() - padding, inBox.x())),
+        MIN(box.y(), MAX(box.y() - padding, inBox.y())),
+        MAX(box.r(), MIN(box.r() + padding, inBox.r())),
+        MAX(box.t(), MIN(box.t() + padding, inBox.t()))
+        );
+}
+
 /*
 Do per-sample, channel-agnostic processing. Used for things like generating P
 mattes and so on.
@@ -107,6 +140,125 @@ void DeepCWrapper::wrappedPerChannel(
 }
 
 
+/*
+Process a whole row's worth of samples at once. Subclasses should override
+this with tight loops over the batch's arrays; the result will be masked and
+mixed appropriately. The default implementation falls back to calling
+wrappedPerSample and wrappedPerChannel for every sample, so subclasses which
+only implement those keep working unchanged.
+*/
+void DeepCWrapper::wrappedPerBatch(DeepCSampleBatch& batch)
+{
+    const float* alpha = batch.alpha();
+    const int lanes = batch.lanes();
+
+    for (size_t i = 0; i < batch.size(); i++)
+    {
+        float perSampleData = 1.0f;
+        Vector3 sampleColor(0.0f, 0.0f, 0.0f);
+        wrappedPerSample(
+            batch.position(i),
+            batch.sampleNo(i),
+            alpha[i],
+            batch.pixel(i),
+            perSampleData,
+            sampleColor
+            );
+
+        for (int lane = 0; lane < lanes; lane++)
+        {
+            wrappedPerChannel(
+                batch.in(lane)[i],
+                perSampleData,
+                batch.channel(lane),
+                batch.out(lane)[i],
+                sampleColor
+                );
+        }
+    }
+}
+
+
+void DeepCSampleBatch::clear()
+{
+    _alpha.clear();
+    _mask.clear();
+    _pixelIndex.clear();
+    _sampleNo.clear();
+    _positions.clear();
+    _pixels.clear();
+    _sourceChannels.clear();
+}
+
+
+/*
+Extra channels are only gathered when a kernel asks for them, so nodes that
+only look at their own lanes don't pay for channels they never read.
+*/
+const float* DeepCSampleBatch::source(Channel z)
+{
+    if (!_available.contains(z))
+        return NULL;
+
+    for (size_t i = 0; i < _sourceChannels.size(); i++)
+    {
+        if (_sourceChannels[i] == z)
+            return _sourceData[i].data();
+    }
+
+    const size_t slot = _sourceChannels.size();
+    _sourceChannels.push_back(z);
+    if (_sourceData.size() <= slot)
+        _sourceData.resize(slot + 1);
+
+    std::vector<float>& data = _sourceData[slot];
+    data.resize(size());
+    for (size_t i = 0; i < size(); i++)
+        data[i] = _pixels[_pixelIndex[i]].getUnorderedSample(_sampleNo[i], z);
+    return data.data();
+}
+
+
+/*
+Output for a box nothing in which is processed. The input plane is handed
+straight on when it has every requested channel; otherwise it is copied
+with the missing channels (output channels added in _validate, say) filled
+with 0.
+*/
+bool DeepCWrapper::passThrough(
+    const Box& box,
+    const DD::Image::ChannelSet& requestedChannels,
+    DeepOutputPlane& deepOutPlane
+    )
+{
+    if (input0()->deepInfo().channels().contains(requestedChannels))
+        return input0()->deepEngine(box, requestedChannels, deepOutPlane);
+
+    DeepPlane deepInPlane;
+    if (!input0()->deepEngine(box, requestedChannels, deepInPlane))
+        return false;
+
+    DeepInPlaceOutputPlane inPlaceOutPlane(requestedChannels, box);
+    inPlaceOutPlane.reserveSamples(deepInPlane.getTotalSampleCount());
+
+    static thread_local deepc::DeepChannelPlan plan;
+    plan.reset(deepInPlane.channels(), requestedChannels);
+
+    for (Box::iterator it = box.begin(); it != box.end(); ++it)
+    {
+        DeepPixel deepInPixel = deepInPlane.getPixel(it);
+        inPlaceOutPlane.setSampleCount(it, deepInPixel.getSampleCount());
+        DeepOutputPixel outPixel = inPlaceOutPlane.getPixel(it);
+        plan.copyPixel(deepInPixel, outPixel);
+    }
+
+    inPlaceOutPlane.reviseSamples();
+    mFnAssert(inPlaceOutPlane.isComplete());
+    deepOutPlane = inPlaceOutPlane;
+    return true;
+}
+
+
 bool DeepCWrapper::doDeepEngine(
     Box bbox,
     const DD::Image::ChannelSet& requestedChannels,
@@ -116,157 +268,225 @@ bool DeepCWrapper::doDeepEngine(
     if (!input0())
         return true;
 
+    // The thread_local state below is shared by every instance of this
+    // plugin on the thread, and the upstream engines called here may be
+    // instances too, so it is only touched once nothing more is fetched.
+    // Until then only locals are used; the side mask is one of them.
+    ChannelSet laneChannels;
+    foreach(z, requestedChannels)
+    {
+        if (
+               z == Chan_Alpha
+            || z == Chan_Z
+            || z == Chan_DeepFront
+            || z == Chan_DeepBack
+            || !_allProcessChannels.contains(z)
+            )
+            continue;
+        laneChannels += z;
+    }
+
+    // nothing in the box can change
+    if (laneChannels.empty() || _mix == 0.0f)
+        return passThrough(bbox, requestedChannels, deepOutPlane);
+
+    // mask input stuff - the whole box is fetched up front
+    float sideMaskVal;
+    deepc::SideMask sideMask;
+    if (_doSideMask)
+    {
+        if (!sideMask.fetch(*_maskOp, _sideMaskChannel, bbox, _invertSideMask))
+            return false;
+        if (sideMask.allZero())
+            return passThrough(bbox, requestedChannels, deepOutPlane);
+    }
+
     DD::Image::ChannelSet getChannels = requestedChannels;
     getChannels += _allNeededDeepChannels;
 
+    // only bbox is written; any padding is there for batch.plane()
     DeepPlane deepInPlane;
-    if (!input0()->deepEngine(bbox, getChannels, deepInPlane))
+    if (!input0()->deepEngine(paddedInputBox(bbox), getChannels, deepInPlane))
         return false;
 
+    // samples are gathered a row at a time and handed to wrappedPerBatch
+    static thread_local DeepCSampleBatch batch;
+    static thread_local std::vector<DeepOutputPixel> outPixels;
+
+    // the channels we process - everything else we know we should pass through
+    batch._laneChannels.clear();
+    batch._laneColourIndex.clear();
+    foreach(z, laneChannels)
+    {
+        batch._laneChannels.push_back(z);
+        batch._laneColourIndex.push_back(colourIndex(z));
+    }
+    const int lanes = batch.lanes();
+
     ChannelSet available;
     available = deepInPlane.channels();
 
     DeepInPlaceOutputPlane inPlaceOutPlane(requestedChannels, bbox);
     inPlaceOutPlane.reserveSamples(deepInPlane.getTotalSampleCount());
-    const DD::Image::ChannelSet inputChannels = input0()->deepInfo().channels();
 
-    const int nOutputChans = requestedChannels.size();
+    batch._available = available;
+    batch._plane = &deepInPlane;
 
-    // mask input stuff
-    float sideMaskVal;
-    int currentYRow;
-    Row maskRow(bbox.x(), bbox.r());
+    // every sample is copied through first; processed lanes are overwritten
+    // once the batch has run
+    static thread_local deepc::DeepChannelPlan plan;
+    plan.reset(deepInPlane.channels(), requestedChannels);
 
-    if (_doSideMask)
-    {
-        _maskOp->get(bbox.y(), bbox.x(), bbox.r(), _sideMaskChannel, maskRow);
-        currentYRow = bbox.y();
-    }
+    const bool useAlpha = available.contains(Chan_Alpha)
+                          && (_unpremult || _unpremultDeepMask);
+    const bool useDeepMask = _doDeepMask && available.contains(_deepMaskChannel);
 
-    for (Box::iterator it = bbox.begin(); it != bbox.end(); ++it)
+    Box::iterator it = bbox.begin();
+    while (it != bbox.end())
     {
         if (Op::aborted())
             return false; // bail fast on user-interrupt
 
-        // Get the deep pixel from the input plane:
-        DeepPixel deepInPixel = deepInPlane.getPixel(it);
-        size_t inPixelSamples = deepInPixel.getSampleCount();
+        const int currentYRow = it.y;
 
-        inPlaceOutPlane.setSampleCount(it, deepInPixel.getSampleCount());
-        DeepOutputPixel outPixel = inPlaceOutPlane.getPixel(it);
-
-        // flat masking
-        sideMaskVal = 1.0f;
-        if (_doSideMask)
+        // nothing in this row gets processed, so pass it straight through
+        if (_doSideMask && sideMask.rowAllZero(currentYRow))
         {
-            if (currentYRow != it.y)
-            {
-                // we have not already gotten this row, get it now
-                _maskOp->get(it.y, bbox.x(), bbox.r(), _sideMaskChannel, maskRow);
-                sideMaskVal = maskRow[_sideMaskChannel][it.x];
-                sideMaskVal = clamp(sideMaskVal);
-                currentYRow = it.y;
-            } else
+            for (; it != bbox.end() && it.y == currentYRow; ++it)
             {
-                // we've already got this row, just get the value
-                sideMaskVal = maskRow[_sideMaskChannel][it.x];
-                sideMaskVal = clamp(sideMaskVal);
+                DeepPixel deepInPixel = deepInPlane.getPixel(it);
+                inPlaceOutPlane.setSampleCount(it, deepInPixel.getSampleCount());
+                DeepOutputPixel outPixel = inPlaceOutPlane.getPixel(it);
+                plan.copyPixel(deepInPixel, outPixel);
             }
-            if (_invertSideMask)
-                sideMaskVal = 1.0f - sideMaskVal;
+            continue;
         }
 
-        // for each sample
-        for (size_t sampleNo = 0; sampleNo < inPixelSamples; sampleNo++)
-        {
+        batch.clear();
+        outPixels.clear();
 
-            // alpha
-            float alpha;
-            alpha = 1.0f;
-            if (
-                available.contains(Chan_Alpha)
-                && (_unpremult || _unpremultDeepMask)
-                )
+        // gather the samples of this row which need processing, copying the
+        // rest straight through
+        for (; it != bbox.end() && it.y == currentYRow; ++it)
+        {
+            // Get the deep pixel from the input plane:
+            DeepPixel deepInPixel = deepInPlane.getPixel(it);
+            size_t inPixelSamples = deepInPixel.getSampleCount();
+
+            // output pixels stay valid for the whole row, as we reserved
+            // all of the plane's samples up front
+            inPlaceOutPlane.setSampleCount(it, inPixelSamples);
+            outPixels.push_back(inPlaceOutPlane.getPixel(it));
+            DeepOutputPixel& outPixel = outPixels.back();
+
+            const int pixelIndex = static_cast<int>(batch._pixels.size());
+            batch._positions.push_back(it);
+            batch._pixels.push_back(deepInPixel);
+
+            // flat masking
+            sideMaskVal = 1.0f;
+            if (_doSideMask)
             {
-                alpha = deepInPixel.getUnorderedSample(sampleNo, Chan_Alpha);
+                sideMaskVal = sideMask.value(it.x, currentYRow);
+                if (sideMaskVal == 0.0f)
+                {
+                    plan.copyPixel(deepInPixel, outPixel);
+                    continue;
+                }
             }
 
-            // deep masking
-            float deepMaskVal;
-            deepMaskVal = 1.0f;
-            if (_doDeepMask)
+            // for each sample
+            for (size_t sampleNo = 0; sampleNo < inPixelSamples; sampleNo++)
             {
-                if (available.contains(_deepMaskChannel))
+                // alpha
+                float alpha = 1.0f;
+                if (useAlpha)
+                    alpha = deepInPixel.getUnorderedSample(sampleNo, Chan_Alpha);
+
+                // deep masking
+                float deepMaskVal = 1.0f;
+                if (_doDeepMask)
                 {
-                    deepMaskVal = deepInPixel.getUnorderedSample(sampleNo, _deepMaskChannel);
-                    if (_unpremultDeepMask)
+                    if (useDeepMask)
                     {
-                        if (alpha != 0.0f)
-                        {
-                            deepMaskVal /= alpha;
-                        } else
+                        deepMaskVal = deepInPixel.getUnorderedSample(sampleNo, _deepMaskChannel);
+                        if (_unpremultDeepMask)
                         {
-                            deepMaskVal = 0.0f;
+                            if (alpha != 0.0f)
+                            {
+                                deepMaskVal /= alpha;
+                            } else
+                            {
+                                deepMaskVal = 0.0f;
+                            }
                         }
+                        if (_invertDeepMask)
+                            deepMaskVal = 1.0f - deepMaskVal;
+                    } else
+                    {
+                        deepMaskVal = 0.0f;
                     }
-                    if (_invertDeepMask)
-                        deepMaskVal = 1.0f - deepMaskVal;
-                } else
-                {
-                    deepMaskVal = 0.0f;
                 }
-            }
 
-            float perSampleData;
-            Vector3 sampleColor;
-            wrappedPerSample(it, sampleNo, alpha, deepInPixel, perSampleData, sampleColor);
-
-            // process the sample
-            float inputVal;
-            int cIndex;
-            // for each channel
-            ChannelSet inPixelChannels;
-            inPixelChannels = deepInPixel.channels();
-            foreach(z, requestedChannels)
-            {
-                cIndex = colourIndex(z);
-
-
-                const float& inData = inPixelChannels.contains(z)
-                                      ? deepInPixel.getUnorderedSample(sampleNo, z)
-                                      : 0.0f;
-                float& outData = outPixel.getWritableUnorderedSample(sampleNo, z);
-
-                // channels we know we should pass through
-                if (
-                       z == Chan_Alpha
-                    || z == Chan_Z
-                    || z == Chan_DeepFront
-                    || z == Chan_DeepBack
-                    || _mix == 0.0f
-                    || (_doDeepMask && deepMaskVal == 0.0f)
-                    || (_doSideMask && sideMaskVal == 0.0f)
-                    || !_processChannelSet.contains(z)
-                    )
-                {
-                    outData = inData;
+                const float mask = _mix * sideMaskVal * deepMaskVal;
+                const bool process = lanes > 0 && mask != 0.0f;
+
+                plan.copySample(
+                    deepInPixel.getUnorderedSample(sampleNo),
+                    outPixel.getWritableUnorderedSample(sampleNo)
+                    );
+
+                if (!process)
                     continue;
-                }
 
-                inputVal = inData;
-                if (_unpremult)
-                    inputVal /= alpha;
+                batch._alpha.push_back(alpha);
+                batch._mask.push_back(mask);
+                batch._pixelIndex.push_back(pixelIndex);
+                batch._sampleNo.push_back(static_cast<int>(sampleNo));
+            }
+        }
 
-                wrappedPerChannel(inputVal, perSampleData, z, outData, sampleColor);
+        const size_t batchSize = batch.size();
+        if (batchSize == 0)
+            continue;
 
-                float mask = _mix;
-                mask *= sideMaskVal;
-                mask *= deepMaskVal;
+        // lay the processed channels out one contiguous block per lane
+        batch._in.resize(lanes * batchSize);
+        batch._out.resize(lanes * batchSize);
+        for (int lane = 0; lane < lanes; lane++)
+        {
+            const Channel z = batch.channel(lane);
+            float* inData = batch._in.data() + lane * batchSize;
+            if (!available.contains(z))
+            {
+                std::fill(inData, inData + batchSize, 0.0f);
+            } else
+            {
+                for (size_t i = 0; i < batchSize; i++)
+                    inData[i] = batch.pixel(i).getUnorderedSample(batch._sampleNo[i], z);
+            }
+            if (_unpremult)
+            {
+                for (size_t i = 0; i < batchSize; i++)
+                    inData[i] /= batch._alpha[i];
+            }
+        }
 
-                outData = outData * mask + inputVal * (1.0f - mask);
+        wrappedPerBatch(batch);
 
+        // mask, mix and premult the results back into the output
+        for (int lane = 0; lane < lanes; lane++)
+        {
+            const Channel z = batch.channel(lane);
+            const float* inData = batch.in(lane);
+            const float* outData = batch.out(lane);
+            for (size_t i = 0; i < batchSize; i++)
+            {
+                const float mask = batch._mask[i];
+                float result = outData[i] * mask + inData[i] * (1.0f - mask);
                 if (_unpremult)
-                    outData *= alpha;
+                    result *= batch._alpha[i];
+                outPixels[batch._pixelIndex[i]].getWritableUnorderedSample(batch._sampleNo[i], z) = result;
             }
         }
     }
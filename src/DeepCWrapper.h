@@ -7,9 +7,78 @@
 #include "DDImage/Black.h"
 
 #include <stdio.h>
+#include <vector>
 
 using namespace DD::Image;
 
+/*
+A structure-of-arrays view of the samples of one output row that the wrapper
+actually needs to process. Samples which the mix, side mask or deep mask leave
+untouched are copied straight through by the wrapper and never appear here.
+
+Each processed channel is a "lane": in(lane) holds the (unpremultiplied, if
+requested) input values and the kernel writes its result to out(lane). The
+result is then masked, mixed and premultiplied by the wrapper, exactly like
+the result of wrappedPerChannel. All arrays are contiguous and size() long.
+*/
+class DeepCSampleBatch
+{
+    friend class DeepCWrapper;
+
+    // per sample
+    std::vector<float> _alpha;
+    std::vector<float> _mask;
+    std::vector<int> _pixelIndex;
+    std::vector<int> _sampleNo;
+
+    // per lane, one contiguous block of size() floats each
+    std::vector<Channel> _laneChannels;
+    std::vector<int> _laneColourIndex;
+    std::vector<float> _in;
+    std::vector<float> _out;
+
+    // the row the samples came from, for source() and the per-sample fallback
+    std::vector<Box::iterator> _positions;
+    std::vector<DeepPixel> _pixels;
+    ChannelSet _available;
+    const DeepPlane* _plane;
+
+    // extra input channels gathered on demand by source()
+    std::vector<Channel> _sourceChannels;
+    std::vector<std::vector<float> > _sourceData;
+
+    void clear();
+
+    public:
+
+        size_t size() const { return _alpha.size(); }
+        int lanes() const { return static_cast<int>(_laneChannels.size()); }
+        Channel channel(int lane) const { return _laneChannels[lane]; }
+        int colourIndex(int lane) const { return _laneColourIndex[lane]; }
+
+        // alpha of each sample, 1.0 if the wrapper is not using alpha
+        const float* alpha() const { return _alpha.data(); }
+        // combined mix * side mask * deep mask of each sample, never 0
+        const float* mask() const { return _mask.data(); }
+
+        const float* in(int lane) const { return _in.data() + lane * size(); }
+        float* out(int lane) { return _out.data() + lane * size(); }
+
+        // raw (as stored, premultiplied) values of any input channel, or
+        // NULL if the channel is not in the input
+        const float* source(Channel z);
+
+        // where a sample came from, for kernels that need the deep pixel
+        const Box::iterator& position(size_t i) const { return _positions[_pixelIndex[i]]; }
+        const DeepPixel& pixel(size_t i) const { return _pixels[_pixelIndex[i]]; }
+        size_t sampleNo(size_t i) const { return _sampleNo[i]; }
+
+        // the whole input plane, for kernels that look at neighbouring
+        // pixels; it covers the output box grown by inputPadding(), and
+        // pixels outside plane().box() were not fetched
+        const DeepPlane& plane() const { return *_plane; }
+};
+
 class DeepCWrapper : public DeepFilterOp
 {
     protected:
@@ -34,6 +103,15 @@ class DeepCWrapper : public DeepFilterOp
         float _gain;
 
         ChannelSet _allNeededDeepChannels;
+        // every channel processed as a lane, set in _validate
+        ChannelSet _allProcessChannels;
+
+        // pixels of input fetched on each side of the output box, for
+        // kernels that look at neighbouring pixels through
+        // DeepCSampleBatch::plane(); 0 by default
+        virtual int inputPadding() const { return 0; }
+        // box grown by inputPadding(), but not beyond the input's bbox
+        Box paddedInputBox(const Box& box) const;
 
     public:
 
@@ -49,11 +127,15 @@ class DeepCWrapper : public DeepFilterOp
             _doSideMask(false),
             _invertSideMask(false),
             _mix(1.0f),
-            _allNeededDeepChannels(Chan_Black)
+            _allNeededDeepChannels(Chan_Black),
+            _allProcessChannels(Chan_Black)
         {
             _gain = 1.0f;
         }
 
+        virtual void findProcessChannels(
+            ChannelSet& processChannels
+            );
         virtual void findNeededDeepChannels(
             ChannelSet& neededDeepChannels
             );
@@ -80,12 +162,18 @@ class DeepCWrapper : public DeepFilterOp
             float& outData,
             Vector3 &sampleColor
             );
+        virtual void wrappedPerBatch(DeepCSampleBatch& batch);
 
         bool doDeepEngine(
             DD::Image::Box box,
             const ChannelSet &channels,
             DeepOutputPlane &plane
             );
+        bool passThrough(
+            const Box& box,
+            const ChannelSet &channels,
+            DeepOutputPlane &plane
+            );
         virtual void top_knobs(Knob_Callback f);
         virtual void custom_knobs(Knob_Callback f);
         virtual void bottom_knobs(Knob_Callback f);
@@ -0,0 +1,221 @@
+// SPDX-License-Identifier: MIT
+//
+// ============================================================================
+//
+//  DeepChannelPlan — precomputed channel routing for deep engines
+//
+//  getUnorderedSample(sample, z) looks the channel's offset up on every call,
+//  so engines that copy or shuffle channels with foreach(z, channels) per
+//  sample spend most of their time on lookups. A DeepChannelPlan is built
+//  once per engine call from the input plane's channel map and the output
+//  channel set. Each output slot then reads an input float offset, a
+//  constant, or zero, and whole samples are copied with raw float pointers
+//  through a compiled GatherTable (DeepGatherTable.h).
+//
+//  A DeepChannelRouting lists which output channels read another channel or
+//  a constant instead of themselves, indexed by channel number. Nodes that
+//  route many channels resolve their knobs into one in _validate and build
+//  each engine's plan from it in a single pass.
+//
+// ============================================================================
+
+#ifndef DEEPC_DEEP_CHANNEL_PLAN_H
+#define DEEPC_DEEP_CHANNEL_PLAN_H
+
+#include "DDImage/ChannelSet.h"
+#include "DDImage/DeepPixel.h"
+#include "DDImage/DeepPlane.h"
+
+#include "DeepGatherTable.h"
+
+#include <vector>
+
+namespace deepc {
+
+class DeepChannelRouting
+{
+    public:
+        DeepChannelRouting() : _outputs(DD::Image::Chan_Black), _inputs(DD::Image::Chan_Black) {}
+
+        void clear()
+        {
+            _sources.clear();
+            _outputs = DD::Image::Chan_Black;
+            _inputs = DD::Image::Chan_Black;
+        }
+
+        // Output channel out reads input channel in. Returns false, and
+        // changes nothing, if out is already routed.
+        bool route(DD::Image::Channel out, DD::Image::Channel in)
+        {
+            if (!add(out))
+                return false;
+            _sources[out].in = in;
+            if (in != DD::Image::Chan_Black)
+                _inputs += in;
+            return true;
+        }
+
+        // Output channel out is set to value. Returns false, and changes
+        // nothing, if out is already routed.
+        bool constant(DD::Image::Channel out, float value)
+        {
+            if (!add(out))
+                return false;
+            _sources[out].value = value;
+            return true;
+        }
+
+        // the routed output channels
+        const DD::Image::ChannelSet& outputs() const { return _outputs; }
+        // the input channels they read
+        const DD::Image::ChannelSet& inputs() const { return _inputs; }
+
+        bool routed(DD::Image::Channel out) const
+        {
+            return static_cast<size_t>(out) < _sources.size() && _sources[out].routed;
+        }
+        // for a routed channel: the input channel read, Chan_Black for a
+        // constant
+        DD::Image::Channel input(DD::Image::Channel out) const { return _sources[out].in; }
+        float value(DD::Image::Channel out) const { return _sources[out].value; }
+
+    private:
+        struct Source
+        {
+            bool routed;
+            DD::Image::Channel in;
+            float value;
+        };
+
+        bool add(DD::Image::Channel out)
+        {
+            if (out == DD::Image::Chan_Black || routed(out))
+                return false;
+            if (static_cast<size_t>(out) >= _sources.size())
+            {
+                Source unrouted = { false, DD::Image::Chan_Black, 0.0f };
+                _sources.resize(static_cast<size_t>(out) + 1, unrouted);
+            }
+            Source source = { true, DD::Image::Chan_Black, 0.0f };
+            _sources[out] = source;
+            _outputs += out;
+            return true;
+        }
+
+        // by output channel number
+        std::vector<Source> _sources;
+        DD::Image::ChannelSet _outputs;
+        DD::Image::ChannelSet _inputs;
+};
+
+class DeepChannelPlan
+{
+    public:
+        // Every output channel copies the same channel from the input, or
+        // is zero if the input doesn't have it.
+        void reset(const DD::Image::ChannelMap& in, const DD::Image::ChannelSet& out)
+        {
+            start(in, out);
+            foreach(z, out)
+                read(_out.chanNo(z), z);
+            _table.compile();
+        }
+
+        // As above, except that the output channels in routing read their
+        // source from it.
+        void reset(const DD::Image::ChannelMap& in, const DD::Image::ChannelSet& out,
+                   const DeepChannelRouting& routing)
+        {
+            start(in, out);
+            foreach(z, out)
+            {
+                const int slot = _out.chanNo(z);
+                if (!routing.routed(z))
+                    read(slot, z);
+                else if (routing.input(z) != DD::Image::Chan_Black)
+                    read(slot, routing.input(z));
+                else
+                    _table.constant(slot, routing.value(z));
+            }
+            _table.compile();
+        }
+
+        // Output channel out reads input channel in instead (zero if the
+        // input doesn't have it). Ignored if out isn't an output channel.
+        void route(DD::Image::Channel out, DD::Image::Channel in)
+        {
+            const int slot = slotOf(out);
+            if (slot < 0)
+                return;
+            read(slot, in);
+            _table.compile();
+        }
+
+        // Output channel out is set to value.
+        void constant(DD::Image::Channel out, float value)
+        {
+            const int slot = slotOf(out);
+            if (slot < 0)
+                return;
+            _table.constant(slot, value);
+            _table.compile();
+        }
+
+        // floats per output sample
+        size_t size() const { return _table.size(); }
+
+        // output slot of channel z, or -1
+        int slotOf(DD::Image::Channel z) const
+        {
+            return z != DD::Image::Chan_Black && _out.contains(z) ? _out.chanNo(z) : -1;
+        }
+
+        // input offset read by an output slot, or -1 for a constant
+        int offset(int slot) const { return _table.offset(slot); }
+
+        // true when every sample can be copied verbatim
+        bool identity() const { return _table.identity(); }
+
+        // out[slot] for one sample; in and out must not overlap
+        void copySample(const float* in, float* out) const
+        {
+            _table.copySample(in, out);
+        }
+
+        // copy every sample of in to out, which must already hold as many
+        // samples; a pixel's samples are stored back to back, so they are
+        // copied as one block
+        void copyPixel(const DD::Image::DeepPixel& in, DD::Image::DeepOutputPixel& out) const
+        {
+            const size_t samples = in.getSampleCount();
+            if (samples)
+                _table.copySamples(in.getUnorderedSample(0), out.getWritableUnorderedSample(0), samples);
+        }
+
+    private:
+        void start(const DD::Image::ChannelMap& in, const DD::Image::ChannelSet& out)
+        {
+            _in = in;
+            _out = out;
+            _table.reset(_out.size(), _in.size());
+        }
+
+        // slot reads input channel in, or is zero if the input doesn't
+        // have it
+        void read(int slot, DD::Image::Channel in)
+        {
+            if (in != DD::Image::Chan_Black && _in.contains(in))
+                _table.read(slot, _in.chanNo(in));
+            else
+                _table.constant(slot, 0.0f);
+        }
+
+        DD::Image::ChannelMap _in;
+        DD::Image::ChannelMap _out;
+        GatherTable _table;
+};
+
+} // namespace deepc
+
+#endif // DEEPC_DEEP_CHANNEL_PLAN_H
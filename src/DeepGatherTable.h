@@ -0,0 +1,173 @@
+// SPDX-License-Identifier: MIT
+//
+// ============================================================================
+//
+//  DeepGatherTable — table-driven copy of one deep sample layout to another
+//
+//  Every output float ("slot") of a sample either reads an input float at a
+//  fixed offset or is set to a constant. compile() turns that description
+//  into three flat lists: runs of at least kMinRun slots reading consecutive
+//  input floats, copied with memcpy; the remaining reads, gathered one float
+//  at a time; and the constants. Copying a sample is then a walk over those
+//  lists, with no per-channel lookups or branches on the kind of source,
+//  however many slots there are. A table that maps the input straight onto
+//  the output copies whole blocks of samples at once.
+//
+//  DeepChannelPlan builds these from Nuke channel maps.
+//
+//  Zero Nuke SDK dependencies — only standard library headers.
+//
+// ============================================================================
+
+#ifndef DEEPC_DEEP_GATHER_TABLE_H
+#define DEEPC_DEEP_GATHER_TABLE_H
+
+#include <cstddef>
+#include <cstring>
+#include <vector>
+
+namespace deepc {
+
+class GatherTable
+{
+    public:
+        // shortest run of consecutive reads worth a memcpy
+        enum { kMinRun = 4 };
+
+        GatherTable() : _inSize(0), _identity(false) {}
+
+        // outSize slots, all 0, reading samples of inSize floats
+        void reset(size_t outSize, size_t inSize)
+        {
+            _offset.assign(outSize, -1);
+            _constant.assign(outSize, 0.0f);
+            _inSize = inSize;
+        }
+
+        // slot reads input float offset
+        void read(int slot, int offset)
+        {
+            _offset[slot] = offset;
+            _constant[slot] = 0.0f;
+        }
+
+        // slot is set to value
+        void constant(int slot, float value)
+        {
+            _offset[slot] = -1;
+            _constant[slot] = value;
+        }
+
+        // must be called after read() and constant(), before copying
+        void compile()
+        {
+            _runs.clear();
+            _gatherOut.clear();
+            _gatherIn.clear();
+            _constantOut.clear();
+            _constantValue.clear();
+
+            const int n = static_cast<int>(_offset.size());
+            int slot = 0;
+            while (slot < n)
+            {
+                if (_offset[slot] < 0)
+                {
+                    _constantOut.push_back(slot);
+                    _constantValue.push_back(_constant[slot]);
+                    slot++;
+                    continue;
+                }
+                int length = 1;
+                while (slot + length < n && _offset[slot + length] == _offset[slot] + length)
+                    length++;
+                if (length >= kMinRun)
+                {
+                    Run run = { slot, _offset[slot], length };
+                    _runs.push_back(run);
+                } else
+                {
+                    for (int i = 0; i < length; i++)
+                    {
+                        _gatherOut.push_back(slot + i);
+                        _gatherIn.push_back(_offset[slot + i]);
+                    }
+                }
+                slot += length;
+            }
+            _identity = static_cast<int>(_inSize) == n;
+            for (int i = 0; i < n && _identity; i++)
+                _identity = _offset[i] == i;
+        }
+
+        // floats per output sample
+        size_t size() const { return _offset.size(); }
+
+        // input offset read by a slot, or -1 for a constant
+        int offset(int slot) const { return _offset[slot]; }
+
+        // true when every sample can be copied verbatim
+        bool identity() const { return _identity; }
+
+        // out[slot] for one sample; in and out must not overlap
+        void copySample(const float* in, float* out) const
+        {
+            if (_identity)
+            {
+                memcpy(out, in, _offset.size() * sizeof(float));
+                return;
+            }
+            for (size_t i = 0; i < _runs.size(); i++)
+            {
+                const Run& run = _runs[i];
+                memcpy(out + run.out, in + run.in, run.length * sizeof(float));
+            }
+            const int* gatherOut = _gatherOut.data();
+            const int* gatherIn = _gatherIn.data();
+            for (size_t i = 0, count = _gatherOut.size(); i < count; i++)
+                out[gatherOut[i]] = in[gatherIn[i]];
+            const int* constantOut = _constantOut.data();
+            const float* constantValue = _constantValue.data();
+            for (size_t i = 0, count = _constantOut.size(); i < count; i++)
+                out[constantOut[i]] = constantValue[i];
+        }
+
+        // samples consecutive samples, stored back to back in both in and
+        // out
+        void copySamples(const float* in, float* out, size_t samples) const
+        {
+            if (_identity)
+            {
+                memcpy(out, in, samples * _offset.size() * sizeof(float));
+                return;
+            }
+            const size_t outSize = _offset.size();
+            for (size_t sample = 0; sample < samples; sample++)
+                copySample(in + sample * _inSize, out + sample * outSize);
+        }
+
+    private:
+        // output slots [out, out + length) read input floats [in, in + length)
+        struct Run
+        {
+            int out;
+            int in;
+            int length;
+        };
+
+        std::vector<int> _offset;
+        std::vector<float> _constant;
+        size_t _inSize;
+
+        // compiled
+        std::vector<Run> _runs;
+        std::vector<int> _gatherOut;
+        std::vector<int> _gatherIn;
+        std::vector<int> _constantOut;
+        std::vector<float> _constantValue;
+        bool _identity;
+};
+
+} // namespace deepc
+
+#endif // DEEPC_DEEP_GATHER_TABLE_H
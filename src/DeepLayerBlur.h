@@ -0,0 +1,522 @@
+// SPDX-License-Identifier: MIT
+//
+// ============================================================================
+//
+//  DeepLayerBlur — Header-only depth-layered blur utility
+//
+//  Flattens the deep samples of a region into a small stack of dense depth
+//  layers, blurs every layer as an ordinary flat image and reads one deep
+//  sample per non-empty layer back out. Blur cost no longer depends on how
+//  many samples the neighbourhood holds, and with the recursive Gaussian
+//  below it does not depend on the blur radius either.
+//
+//  Layers are placed from a depth histogram so each holds a similar share
+//  of the samples.
+//
+//  Zero Nuke SDK dependencies — only standard library headers.
+//
+// ============================================================================
+
+#ifndef DEEPC_DEEP_LAYER_BLUR_H
+#define DEEPC_DEEP_LAYER_BLUR_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <vector>
+
+#include "DeepSampleOptimizer.h"
+
+namespace deepc {
+
+// ---------------------------------------------------------------------------
+// RecursiveGaussian — Young / van Vliet third-order IIR Gaussian
+//
+// I.T. Young, L.J. van Vliet, "Recursive implementation of the Gaussian
+// filter", Signal Processing 44 (1995). A causal and an anti-causal pass of
+// three feedback taps each; cost per element is constant for any sigma.
+//
+// The paper's q(sigma) fit gives a response whose standard deviation is
+// about 22% wider than sigma at sigma 1 and about 10% wider from 3 to 10, so
+// q is instead solved for so the impulse response has a variance of exactly
+// sigma^2. Measured, its standard deviation is within 0.01% of sigma from
+// 0.5 to 10 and 0.2% up to 40; beyond that single precision rounding in the
+// recursion brings errors of a few percent. The shape is still only close
+// to a Gaussian — a taller peak and longer tails, off by up to 25% of the
+// peak value at sigma 1 and about 10% from sigma 5 up. Smaller sigmas are
+// clamped to 0.5.
+//
+// Samples outside the filtered range are taken as zero. The causal response
+// is carried on into a zero tail before the anti-causal pass so the far end
+// of the range gets no truncation error.
+// ---------------------------------------------------------------------------
+class RecursiveGaussian {
+public:
+    explicit RecursiveGaussian(float sigma)
+    {
+        const double s = std::max(0.5, static_cast<double>(sigma));
+
+        // the variance grows with q; bisect for the q giving s^2
+        double lo = 0.0;
+        double hi = s + 4.0;
+        for (int i = 0; i < 50; ++i) {
+            const double mid = 0.5 * (lo + hi);
+            if (variance(mid) < s * s)
+                lo = mid;
+            else
+                hi = mid;
+        }
+
+        double b0, b1, b2, b3;
+        coefficients(0.5 * (lo + hi), b0, b1, b2, b3);
+        _a1 = static_cast<float>(b1 / b0);
+        _a2 = static_cast<float>(b2 / b0);
+        _a3 = static_cast<float>(b3 / b0);
+        _gain = static_cast<float>(1.0 - (b1 + b2 + b3) / b0);
+        _tail = static_cast<int>(std::ceil(4.0 * s)) + 3;
+    }
+
+    // Filter n elements in place. Element i is `lanes` contiguous floats at
+    // data + i * stride, so a row is (n = width, stride = 1, lanes = 1) and
+    // all columns at once are (n = height, stride = width, lanes = width).
+    void apply(float* data, int n, size_t stride, int lanes,
+               std::vector<float>& scratch) const
+    {
+        if (n <= 0 || lanes <= 0)
+            return;
+
+        // scratch: one zero element, then the tail
+        scratch.assign(static_cast<size_t>(_tail + 1) * lanes, 0.0f);
+        const float* zero = scratch.data();
+        float* tail = scratch.data() + lanes;
+        const int total = n + _tail;
+
+        auto at = [&](int i) -> float* {
+            if (i < 0 || i >= total)
+                return const_cast<float*>(zero);
+            if (i < n)
+                return data + static_cast<size_t>(i) * stride;
+            return tail + static_cast<size_t>(i - n) * lanes;
+        };
+
+        // Causal pass; the tail has zero input
+        for (int i = 0; i < total; ++i) {
+            float* w = at(i);
+            const float* w1 = at(i - 1);
+            const float* w2 = at(i - 2);
+            const float* w3 = at(i - 3);
+            const float g = i < n ? _gain : 0.0f;
+            for (int l = 0; l < lanes; ++l)
+                w[l] = g * w[l] + _a1 * w1[l] + _a2 * w2[l] + _a3 * w3[l];
+        }
+
+        // Anti-causal pass, from the end of the tail back to the start
+        for (int i = total - 1; i >= 0; --i) {
+            float* y = at(i);
+            const float* y1 = at(i + 1);
+            const float* y2 = at(i + 2);
+            const float* y3 = at(i + 3);
+            for (int l = 0; l < lanes; ++l)
+                y[l] = _gain * y[l] + _a1 * y1[l] + _a2 * y2[l] + _a3 * y3[l];
+        }
+    }
+
+private:
+    // the paper's filter coefficients for a given q
+    static void coefficients(double q, double& b0, double& b1, double& b2, double& b3)
+    {
+        const double q2 = q * q;
+        const double q3 = q2 * q;
+        b0 = 1.57825 + 2.44413 * q + 1.4281 * q2 + 0.422205 * q3;
+        b1 = 2.44413 * q + 2.85619 * q2 + 1.26661 * q3;
+        b2 = -(1.4281 * q2 + 1.26661 * q3);
+        b3 = 0.422205 * q3;
+    }
+
+    // Variance of the two-pass impulse response for a given q. One pass is
+    // 1 / D(z) with D(z) = 1 - sum a_k z^-k, whose variance is the second
+    // cumulant sum(k^2 a_k) / D(1) + (sum(k a_k) / D(1))^2; the anti-causal
+    // pass mirrors it and adds the same again.
+    static double variance(double q)
+    {
+        double b0, b1, b2, b3;
+        coefficients(q, b0, b1, b2, b3);
+        const double a1 = b1 / b0;
+        const double a2 = b2 / b0;
+        const double a3 = b3 / b0;
+        const double d = 1.0 - a1 - a2 - a3;
+        const double m1 = (a1 + 2.0 * a2 + 3.0 * a3) / d;
+        const double m2 = (a1 + 4.0 * a2 + 9.0 * a3) / d;
+        return 2.0 * (m2 + m1 * m1);
+    }
+
+    float _gain;
+    float _a1, _a2, _a3;
+    int   _tail;
+};
+
+// ---------------------------------------------------------------------------
+// adaptiveDepthEdges — n layers holding roughly equal numbers of samples
+//
+// Builds a histogram of the given depths and places the n - 1 interior
+// boundaries at its quantiles, interpolating linearly inside a bin. Depth
+// ranges with no samples get no layers; boundaries that would coincide are
+// dropped, so fewer than n layers may result.
+// ---------------------------------------------------------------------------
+inline std::vector<float> adaptiveDepthEdges(const std::vector<float>& depths, int n)
+{
+    std::vector<float> edges;
+    if (n <= 1 || depths.empty())
+        return edges;
+
+    const auto range = std::minmax_element(depths.begin(), depths.end());
+    const float zMin = *range.first;
+    const float zMax = *range.second;
+    if (!(zMax > zMin))
+        return edges;
+
+    const int bins = std::max(256, 8 * n);
+    const float scale = static_cast<float>(bins) / (zMax - zMin);
+    std::vector<size_t> histogram(bins, 0);
+    for (float z : depths) {
+        const int b = static_cast<int>((z - zMin) * scale);
+        ++histogram[std::min(std::max(b, 0), bins - 1)];
+    }
+
+    edges.reserve(n - 1);
+    const double perLayer = static_cast<double>(depths.size()) / n;
+    double target = perLayer;
+    size_t below = 0;
+    for (int b = 0; b < bins && static_cast<int>(edges.size()) < n - 1; ++b) {
+        const size_t count = histogram[b];
+        while (count > 0 && below + count >= target &&
+               static_cast<int>(edges.size()) < n - 1) {
+            const double t = (target - below) / count;
+            const float edge = zMin + (static_cast<float>(b) + static_cast<float>(t)) / scale;
+            if (edges.empty() || edge > edges.back())
+                edges.push_back(edge);
+            target += perLayer;
+        }
+        below += count;
+    }
+    return edges;
+}
+
+// ---------------------------------------------------------------------------
+// DepthLayerStack — dense per-layer planes for one region
+//
+// Every layer holds channelCount() + 4 planes of width × height floats: the
+// caller's channels (premultiplied), then alpha, a depth weight and the
+// weighted zFront / zBack sums. All are linear in the samples, so blurring
+// each plane and dividing the depth sums by the weight afterwards gives the
+// coverage-weighted depth of the blurred layer.
+//
+// Within a pixel, samples must be composited front to back (ascending
+// zFront); samples sharing a layer are combined with "over".
+// ---------------------------------------------------------------------------
+class DepthLayerStack {
+public:
+    DepthLayerStack() : _width(0), _height(0), _nChans(0) {}
+
+    void reset(int width, int height, int nChans, const std::vector<float>& edges)
+    {
+        _width = width;
+        _height = height;
+        _nChans = nChans;
+        _edges = edges;
+        _used.assign(_edges.size() + 1, false);
+        _data.assign(planeSize() * slotCount() * layerCount(), 0.0f);
+    }
+
+    int width() const { return _width; }
+    int height() const { return _height; }
+    int layerCount() const { return static_cast<int>(_edges.size()) + 1; }
+    int channelCount() const { return _nChans; }
+    int slotCount() const { return _nChans + 4; }
+    bool used(int layer) const { return _used[layer]; }
+
+    int layerOf(float z) const
+    {
+        return static_cast<int>(std::upper_bound(_edges.begin(), _edges.end(), z)
+                                - _edges.begin());
+    }
+
+    float* plane(int layer, int slot)
+    {
+        return _data.data() + (static_cast<size_t>(layer) * slotCount() + slot) * planeSize();
+    }
+    const float* plane(int layer, int slot) const
+    {
+        return _data.data() + (static_cast<size_t>(layer) * slotCount() + slot) * planeSize();
+    }
+
+    // Composite one sample under what its layer already holds at (x, y)
+    void composite(int x, int y, float zFront, float zBack, float alpha,
+                   const float* channels)
+    {
+        const int layer = layerOf(zFront);
+        _used[layer] = true;
+        const size_t p = static_cast<size_t>(y) * _width + x;
+
+        float& layerAlpha = plane(layer, alphaSlot())[p];
+        const float transmit = std::max(0.0f, 1.0f - layerAlpha);
+        for (int c = 0; c < _nChans; ++c)
+            plane(layer, c)[p] += channels[c] * transmit;
+        layerAlpha += alpha * transmit;
+
+        // Fully transparent samples still carry a little depth weight so a
+        // layer of them has a defined depth
+        const float w = alpha * transmit + kDepthEpsilon;
+        plane(layer, weightSlot())[p] += w;
+        plane(layer, zFrontSlot())[p] += zFront * w;
+        plane(layer, zBackSlot())[p]  += zBack * w;
+    }
+
+    // Composite all samples of one pixel, sorting them front to back first
+    void compositePixel(int x, int y, SamplePool& samples)
+    {
+        std::vector<SampleHeader>& headers = samples.headers();
+        std::sort(headers.begin(), headers.end(),
+                  [](const SampleHeader& a, const SampleHeader& b) {
+                      return a.zFront < b.zFront ||
+                             (a.zFront == b.zFront && a.row < b.row);
+                  });
+        for (size_t i = 0; i < headers.size(); ++i)
+            composite(x, y, headers[i].zFront, headers[i].zBack, headers[i].alpha,
+                      samples.channels(i));
+    }
+
+    // Blur every plane of every used layer with symmetric half-kernels
+    // (index 0 is the centre), horizontally then vertically. The vertical
+    // pass accumulates whole rows, so both passes walk memory linearly. A
+    // null kernel leaves that axis unblurred.
+    void blur(const std::vector<float>* kernelX, const std::vector<float>* kernelY,
+              std::vector<float>& scratch)
+    {
+        for (int layer = 0; layer < layerCount(); ++layer) {
+            if (!_used[layer])
+                continue;
+            for (int slot = 0; slot < slotCount(); ++slot) {
+                float* data = plane(layer, slot);
+                if (kernelX)
+                    convolveRows(data, *kernelX, scratch);
+                if (kernelY)
+                    convolveColumns(data, *kernelY, scratch);
+            }
+        }
+    }
+
+    // Blur every plane of every used layer, horizontally then vertically.
+    // A null filter leaves that axis unblurred.
+    void blur(const RecursiveGaussian* gx, const RecursiveGaussian* gy,
+              std::vector<float>& scratch)
+    {
+        for (int layer = 0; layer < layerCount(); ++layer) {
+            if (!_used[layer])
+                continue;
+            for (int slot = 0; slot < slotCount(); ++slot) {
+                float* data = plane(layer, slot);
+                if (gx) {
+                    for (int y = 0; y < _height; ++y)
+                        gx->apply(data + static_cast<size_t>(y) * _width, _width, 1, 1, scratch);
+                }
+                if (gy)
+                    gy->apply(data, _height, _width, _width, scratch);
+            }
+        }
+    }
+
+    // Append one sample per non-empty layer at (x, y) to samples. Layers
+    // holding (next to) nothing there are skipped.
+    void readPixel(int x, int y, SamplePool& samples) const
+    {
+        const size_t p = static_cast<size_t>(y) * _width + x;
+        for (int layer = 0; layer < layerCount(); ++layer) {
+            if (!_used[layer])
+                continue;
+            const float w = plane(layer, weightSlot())[p];
+            if (!(w > kMinWeight))
+                continue;
+
+            const float inv = 1.0f / w;
+            const float zFront = plane(layer, zFrontSlot())[p] * inv;
+            const float zBack  = std::max(zFront, plane(layer, zBackSlot())[p] * inv);
+            float* rec = samples.add(zFront, zBack, plane(layer, alphaSlot())[p]);
+            for (int c = 0; c < _nChans; ++c)
+                rec[c] = plane(layer, c)[p];
+        }
+    }
+
+    size_t memoryBytes() const { return _data.capacity() * sizeof(float); }
+
+private:
+    static constexpr float kDepthEpsilon = 1e-4f;
+    static constexpr float kMinWeight = 1e-6f;
+
+    size_t planeSize() const { return static_cast<size_t>(_width) * _height; }
+    int alphaSlot() const { return _nChans; }
+    int weightSlot() const { return _nChans + 1; }
+    int zFrontSlot() const { return _nChans + 2; }
+    int zBackSlot() const { return _nChans + 3; }
+
+    void convolveRows(float* data, const std::vector<float>& kernel,
+                      std::vector<float>& scratch) const
+    {
+        const int radius = static_cast<int>(kernel.size()) - 1;
+        scratch.resize(_width);
+        for (int y = 0; y < _height; ++y) {
+            float* row = data + static_cast<size_t>(y) * _width;
+            std::copy(row, row + _width, scratch.begin());
+            for (int x = 0; x < _width; ++x) {
+                const int lo = std::max(-radius, -x);
+                const int hi = std::min(radius, _width - 1 - x);
+                float sum = 0.0f;
+                for (int d = lo; d <= hi; ++d)
+                    sum += kernel[std::abs(d)] * scratch[x + d];
+                row[x] = sum;
+            }
+        }
+    }
+
+    void convolveColumns(float* data, const std::vector<float>& kernel,
+                         std::vector<float>& scratch) const
+    {
+        const int radius = static_cast<int>(kernel.size()) - 1;
+        scratch.assign(planeSize(), 0.0f);
+        for (int y = 0; y < _height; ++y) {
+            float* out = scratch.data() + static_cast<size_t>(y) * _width;
+            const int lo = std::max(-radius, -y);
+            const int hi = std::min(radius, _height - 1 - y);
+            for (int d = lo; d <= hi; ++d) {
+                const float k = kernel[std::abs(d)];
+                const float* in = data + static_cast<size_t>(y + d) * _width;
+                for (int x = 0; x < _width; ++x)
+                    out[x] += k * in[x];
+            }
+        }
+        std::copy(scratch.begin(), scratch.end(), data);
+    }
+
+    int                _width;
+    int                _height;
+    int                _nChans;
+    std::vector<float> _edges;
+    std::vector<bool>  _used;
+    std::vector<float> _data;
+};
+
+// ---------------------------------------------------------------------------
+// LayeredBlur — flatten a deep region into layers and read it back
+//
+// Everything in a depth-layered blur except the filter: the depth histogram
+// of the region, the placement of its layers and the front-to-back
+// compositing of every pixel into them. The caller blurs the layers with
+// its own filter in between and turns what readPixel() returns into output.
+//
+// Input is read through a deep plane type with box() and getPixel(y, x),
+// whose pixels have getSampleCount() and getUnorderedSample(s, channel), so
+// no particular deep image library is needed here.
+// ---------------------------------------------------------------------------
+class LayeredBlur {
+public:
+    LayeredBlur() : _x(0), _y(0) {}
+
+    // Flatten the samples of plane over the region [x, r) × [y, t) into at
+    // most maxLayers layers. Channel c of each layer holds channels[c].
+    // Pixels outside plane.box() are empty. Returns false if aborted()
+    // became true part way.
+    template <class Plane, class Channel, class Aborted>
+    bool flatten(const Plane& plane, int x, int y, int r, int t,
+                 Channel front, Channel back, Channel alpha,
+                 const std::vector<Channel>& channels, int maxLayers,
+                 Aborted aborted)
+    {
+        const int nChans = static_cast<int>(channels.size());
+        const int x0 = std::max(x, plane.box().x());
+        const int y0 = std::max(y, plane.box().y());
+        const int x1 = std::min(r, plane.box().r());
+        const int y1 = std::min(t, plane.box().t());
+        _x = x;
+        _y = y;
+
+        // depth histogram of the region → layer boundaries
+        _depths.clear();
+        for (int py = y0; py < y1; ++py) {
+            for (int px = x0; px < x1; ++px) {
+                const auto pixel = plane.getPixel(py, px);
+                const int n = static_cast<int>(pixel.getSampleCount());
+                for (int s = 0; s < n; ++s)
+                    _depths.push_back(pixel.getUnorderedSample(s, front));
+            }
+        }
+
+        if (_depths.empty()) {
+            _layers.reset(0, 0, nChans, std::vector<float>());
+            return true;
+        }
+
+        _layers.reset(r - x, t - y, nChans,
+                      adaptiveDepthEdges(_depths, std::max(1, maxLayers)));
+
+        // each pixel front to back into its layers
+        for (int py = y0; py < y1; ++py) {
+            if (aborted())
+                return false;
+
+            for (int px = x0; px < x1; ++px) {
+                const auto pixel = plane.getPixel(py, px);
+                const int n = static_cast<int>(pixel.getSampleCount());
+                if (n == 0)
+                    continue;
+
+                _pixel.reset(nChans);
+                for (int s = 0; s < n; ++s) {
+                    float* rec = _pixel.add(pixel.getUnorderedSample(s, front),
+                                            pixel.getUnorderedSample(s, back),
+                                            pixel.getUnorderedSample(s, alpha));
+                    for (int c = 0; c < nChans; ++c)
+                        rec[c] = pixel.getUnorderedSample(s, channels[c]);
+                }
+                _layers.compositePixel(px - x, py - y, _pixel);
+            }
+        }
+        return true;
+    }
+
+    // true if the region held no samples; every pixel reads back empty
+    bool empty() const { return _depths.empty(); }
+
+    // samples flattened by the last flatten()
+    size_t sampleCount() const { return _depths.size(); }
+
+    // Blur the layers; see DepthLayerStack::blur
+    void blur(const std::vector<float>* kernelX, const std::vector<float>* kernelY)
+    {
+        _layers.blur(kernelX, kernelY, _line);
+    }
+    void blur(const RecursiveGaussian* gx, const RecursiveGaussian* gy)
+    {
+        _layers.blur(gx, gy, _line);
+    }
+
+    // Append the samples of region pixel (x, y), in plane coordinates
+    void readPixel(int x, int y, SamplePool& samples) const
+    {
+        if (!empty())
+            _layers.readPixel(x - _x, y - _y, samples);
+    }
+
+    size_t memoryBytes() const { return _layers.memoryBytes(); }
+
+private:
+    int                _x;
+    int                _y;
+    DepthLayerStack    _layers;
+    std::vector<float> _depths;
+    std::vector<float> _line;
+    SamplePool         _pixel;
+};
+
+} // namespace deepc
+
+#endif // DEEPC_DEEP_LAYER_BLUR_H
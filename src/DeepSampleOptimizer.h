@@ -9,6 +9,10 @@
 //  Extracted from DeepThinner v2.0 Pass 6 (Smart Merge) and Pass 7 (Max
 //  Samples) and generalized to arbitrary channel sets.
 //
+//  Samples are held in a SamplePool (one flat channel buffer per pixel plus a
+//  header array); the original std::vector<SampleRecord> API is kept as a
+//  thin wrapper around it.
+//
 //  Zero Nuke SDK dependencies — only standard library headers. Designed to be
 //  testable in isolation with a trivial harness.
 //
@@ -33,6 +37,99 @@ struct SampleRecord {
     std::vector<float> channels; // arbitrary channel values (caller decides order)
 };
 
+// ---------------------------------------------------------------------------
+// SamplePool — flat, pooled storage for the samples of one pixel
+//
+// Channel values live in one contiguous float buffer with a stride of
+// channelCount(); a small header array holds depth, alpha and the index of
+// each sample's channel row. Reordering, splitting and merging only touch
+// the headers (new rows are appended for split and merged samples), so a
+// pixel costs no per-sample allocations, and reset() keeps the memory for
+// the next pixel.
+// ---------------------------------------------------------------------------
+struct SampleHeader {
+    float    zFront;            // depth front
+    float    zBack;             // depth back
+    float    alpha;             // sample alpha
+    unsigned row;               // channel row of this sample in the pool
+};
+
+class SamplePool {
+public:
+    SamplePool() : _nChans(0) {}
+
+    // Empty the pool for a new pixel, keeping its memory
+    void reset(int nChans)
+    {
+        _nChans = nChans;
+        _headers.clear();
+        _data.clear();
+    }
+
+    size_t size() const { return _headers.size(); }
+    bool   empty() const { return _headers.empty(); }
+    int    channelCount() const { return _nChans; }
+
+    SampleHeader&       header(size_t i)       { return _headers[i]; }
+    const SampleHeader& header(size_t i) const { return _headers[i]; }
+    std::vector<SampleHeader>&       headers()       { return _headers; }
+    const std::vector<SampleHeader>& headers() const { return _headers; }
+
+    float*       channels(size_t i)       { return row(_headers[i].row); }
+    const float* channels(size_t i) const { return row(_headers[i].row); }
+
+    float*       row(unsigned r)       { return _data.data() + static_cast<size_t>(r) * _nChans; }
+    const float* row(unsigned r) const { return _data.data() + static_cast<size_t>(r) * _nChans; }
+
+    // Append a zero-filled channel row no header points at yet. Invalidates
+    // pointers returned by row() / channels().
+    unsigned newRow()
+    {
+        const unsigned r = _nChans ? static_cast<unsigned>(_data.size() / _nChans) : 0;
+        _data.resize(_data.size() + _nChans, 0.0f);
+        return r;
+    }
+
+    // Append a sample and return its (zero-filled) channel row, valid until
+    // the next add / newRow
+    float* add(float zFront, float zBack, float alpha)
+    {
+        SampleHeader h;
+        h.zFront = zFront;
+        h.zBack  = zBack;
+        h.alpha  = alpha;
+        h.row    = newRow();
+        _headers.push_back(h);
+        return row(h.row);
+    }
+
+    // Replace the contents with other's samples, rows renumbered in header
+    // order. Rows no header points at (left behind by splits and merges)
+    // are dropped, so the copy holds only live data.
+    void compactFrom(const SamplePool& other)
+    {
+        _nChans = other._nChans;
+        _headers.assign(other._headers.begin(), other._headers.end());
+        _data.resize(_headers.size() * _nChans);
+        for (size_t i = 0; i < _headers.size(); ++i) {
+            std::copy_n(other.row(_headers[i].row), _nChans, row(static_cast<unsigned>(i)));
+            _headers[i].row = static_cast<unsigned>(i);
+        }
+    }
+
+    // Heap memory held, including spare capacity
+    size_t memoryBytes() const
+    {
+        return _headers.capacity() * sizeof(SampleHeader)
+             + _data.capacity() * sizeof(float);
+    }
+
+private:
+    int                       _nChans;
+    std::vector<SampleHeader> _headers;
+    std::vector<float>        _data;
+};
+
 // ---------------------------------------------------------------------------
 // colorDistance — max absolute difference across first min(3, N) channels
 //
@@ -40,147 +137,181 @@ struct SampleRecord {
 // before computing the max-abs-diff.  Near-zero alpha (< 1e-6) is treated
 // as transparent / always-matching → returns 0.
 // ---------------------------------------------------------------------------
-inline float colorDistance(const std::vector<float>& a, float alphaA,
-                           const std::vector<float>& b, float alphaB)
+inline float colorDistance(const float* a, float alphaA,
+                           const float* b, float alphaB, size_t nChans)
 {
     if (alphaA < 1e-6f || alphaB < 1e-6f)
         return 0.0f;
 
     const float invA = 1.0f / alphaA;
     const float invB = 1.0f / alphaB;
-    const size_t n = std::min<size_t>(3, std::min(a.size(), b.size()));
+    const size_t n = std::min<size_t>(3, nChans);
     float d = 0.0f;
     for (size_t i = 0; i < n; ++i)
         d = std::max(d, std::fabs(a[i] * invA - b[i] * invB));
     return d;
 }
 
+inline float colorDistance(const std::vector<float>& a, float alphaA,
+                           const std::vector<float>& b, float alphaB)
+{
+    return colorDistance(a.data(), alphaA, b.data(), alphaB,
+                         std::min(a.size(), b.size()));
+}
+
 // ---------------------------------------------------------------------------
-// tidyOverlapping — split overlapping depth intervals and over-merge
+// splitSample — cut a volumetric sample in two at depth z
 //
-// Walks a depth-sorted sample list.  When sample[i].zBack > sample[i+1].zFront
-// (overlap), the earlier volumetric sample is split at the overlap boundary.
-// After all splits, samples at identical [zFront,zBack] are over-composited.
+// Alpha is subdivided so the two halves composite back to the original:
+//   alpha_front = 1 - (1 - alpha)^ratio,  alpha_back = 1 - (1 - alpha)^(1-ratio)
+// and premultiplied channels scale proportionally with alpha. cur becomes the
+// front half; the back half gets a new row in the pool.
 // ---------------------------------------------------------------------------
-inline void tidyOverlapping(std::vector<SampleRecord>& samples)
+inline void splitSample(SamplePool& pool, SampleHeader& cur, float z,
+                        SampleHeader& back)
 {
-    if (samples.size() < 2)
-        return;
+    float totalRange = cur.zBack - cur.zFront;
+    float frontRange = z - cur.zFront;
+    float ratio      = frontRange / totalRange;
+
+    float oneMinusA = 1.0f - cur.alpha;
+    float alphaFront = (oneMinusA <= 0.0f) ? cur.alpha
+                     : 1.0f - std::pow(oneMinusA, ratio);
+    float alphaBack  = (oneMinusA <= 0.0f) ? cur.alpha
+                     : 1.0f - std::pow(oneMinusA, 1.0f - ratio);
+
+    back.zFront = z;
+    back.zBack  = cur.zBack;
+    back.alpha  = alphaBack;
+    back.row    = pool.newRow();
+
+    float scaleFront = (cur.alpha > 1e-6f) ? alphaFront / cur.alpha : 0.0f;
+    float scaleBack  = (cur.alpha > 1e-6f) ? alphaBack  / cur.alpha : 0.0f;
+
+    float* curChannels  = pool.row(cur.row);
+    float* backChannels = pool.row(back.row);
+    for (int c = 0; c < pool.channelCount(); ++c) {
+        backChannels[c] = curChannels[c] * scaleBack;
+        curChannels[c]  = curChannels[c] * scaleFront;
+    }
 
-    // --- Split pass: iterate until no overlaps remain ---
-    bool changed = true;
-    while (changed) {
-        changed = false;
-        // Sort by zFront, then by zBack ascending
-        std::sort(samples.begin(), samples.end(),
-            [](const SampleRecord& a, const SampleRecord& b) {
-                return (a.zFront != b.zFront) ? a.zFront < b.zFront
-                                              : a.zBack < b.zBack;
-            });
-
-        for (size_t i = 0; i + 1 < samples.size(); ++i) {
-            SampleRecord& cur  = samples[i];
-            const SampleRecord& nxt = samples[i + 1];
-
-            // No overlap?
-            if (cur.zBack <= nxt.zFront)
-                continue;
-
-            // Point sample — cannot be split; skip
-            if (cur.zFront == cur.zBack)
-                continue;
-
-            // Split cur at z = nxt.zFront
-            float z = nxt.zFront;
-            float totalRange = cur.zBack - cur.zFront;
-            float frontRange = z - cur.zFront;
-            float ratio      = frontRange / totalRange;
-
-            // Subdivide alpha: alpha_front = 1 - (1 - alpha)^ratio
-            float oneMinusA = 1.0f - cur.alpha;
-            float alphaFront = (oneMinusA <= 0.0f) ? cur.alpha
-                             : 1.0f - std::pow(oneMinusA, ratio);
-            float alphaBack  = (oneMinusA <= 0.0f) ? cur.alpha
-                             : 1.0f - std::pow(oneMinusA, 1.0f - ratio);
-
-            // Build back portion first (we'll overwrite cur for the front)
-            SampleRecord back;
-            back.zFront = z;
-            back.zBack  = cur.zBack;
-            back.alpha  = alphaBack;
-            back.channels.resize(cur.channels.size());
-
-            // Premultiplied channels scale proportionally with alpha
-            float scaleFront = (cur.alpha > 1e-6f) ? alphaFront / cur.alpha : 0.0f;
-            float scaleBack  = (cur.alpha > 1e-6f) ? alphaBack  / cur.alpha : 0.0f;
-
-            for (size_t c = 0; c < cur.channels.size(); ++c) {
-                back.channels[c] = cur.channels[c] * scaleBack;
-                cur.channels[c]  = cur.channels[c] * scaleFront;
-            }
+    cur.zBack  = z;
+    cur.alpha  = alphaFront;
+}
 
-            cur.zBack  = z;
-            cur.alpha  = alphaFront;
+// ---------------------------------------------------------------------------
+// tidyOverlapping — split overlapping depth intervals and over-merge
+//
+// Single sweep: every zFront/zBack in the pixel is collected into one sorted
+// boundary list, and each volumetric sample is cut, front to back, at the
+// boundaries strictly inside it. Samples then line up on shared intervals,
+// and samples at identical [zFront,zBack] are over-composited.
+//
+// O(n log n) in the number of input samples, plus the size of the output.
+// Cuts are applied to the remaining back piece in depth order, so the split
+// arithmetic matches the original restart-scan implementation exactly.
+// ---------------------------------------------------------------------------
+inline void tidyOverlapping(SamplePool& pool)
+{
+    std::vector<SampleHeader>& headers = pool.headers();
+    if (headers.size() < 2)
+        return;
 
-            samples.insert(samples.begin() + static_cast<long>(i + 1), std::move(back));
-            changed = true;
-            break;  // restart scan after structural change
+    auto byInterval = [](const SampleHeader& a, const SampleHeader& b) {
+        return (a.zFront != b.zFront) ? a.zFront < b.zFront
+                                      : a.zBack < b.zBack;
+    };
+
+    // --- Boundary pass: every depth any sample starts or ends at ---
+    static thread_local std::vector<float> bounds;
+    bounds.clear();
+    for (const SampleHeader& h : headers) {
+        bounds.push_back(h.zFront);
+        bounds.push_back(h.zBack);
+    }
+    std::sort(bounds.begin(), bounds.end());
+    bounds.erase(std::unique(bounds.begin(), bounds.end()), bounds.end());
+
+    auto firstCut = [](const SampleHeader& h) {
+        return std::upper_bound(bounds.cbegin(), bounds.cend(), h.zFront);
+    };
+
+    // --- Split pass: cut each volumetric sample at the boundaries inside it ---
+    bool needsSplit = false;
+    for (const SampleHeader& h : headers) {
+        std::vector<float>::const_iterator cut = firstCut(h);
+        if (cut != bounds.cend() && *cut < h.zBack) {
+            needsSplit = true;
+            break;
         }
     }
 
-    // --- Over-merge pass: collapse samples at identical [zFront, zBack] ---
-    std::sort(samples.begin(), samples.end(),
-        [](const SampleRecord& a, const SampleRecord& b) {
-            return (a.zFront != b.zFront) ? a.zFront < b.zFront
-                                          : a.zBack < b.zBack;
-        });
+    if (needsSplit) {
+        static thread_local std::vector<SampleHeader> pieces;
+        pieces.clear();
+        for (SampleHeader h : headers) {
+            std::vector<float>::const_iterator cut = firstCut(h);
+            while (cut != bounds.cend() && *cut < h.zBack) {
+                SampleHeader back;
+                splitSample(pool, h, *cut, back);
+                pieces.push_back(h);
+                h = back;
+                ++cut;
+            }
+            pieces.push_back(h);
+        }
+        headers.swap(pieces);
+    }
 
-    std::vector<SampleRecord> result;
-    result.reserve(samples.size());
+    // stable, so coincident samples composite in input order
+    if (!std::is_sorted(headers.begin(), headers.end(), byInterval))
+        std::stable_sort(headers.begin(), headers.end(), byInterval);
 
+    // --- Over-merge pass: collapse samples at identical [zFront, zBack] ---
+    const int nChan = pool.channelCount();
+    size_t out = 0;
     size_t i = 0;
-    while (i < samples.size()) {
+    while (i < headers.size()) {
         size_t j = i + 1;
-        while (j < samples.size() &&
-               samples[j].zFront == samples[i].zFront &&
-               samples[j].zBack  == samples[i].zBack)
+        while (j < headers.size() &&
+               headers[j].zFront == headers[i].zFront &&
+               headers[j].zBack  == headers[i].zBack)
         {
             ++j;
         }
 
         if (j - i == 1) {
-            result.push_back(std::move(samples[i]));
+            headers[out] = headers[i];
         } else {
             // Over-composite the group front-to-back
-            const size_t nChan = samples[i].channels.size();
-            SampleRecord merged;
-            merged.zFront = samples[i].zFront;
-            merged.zBack  = samples[i].zBack;
-            merged.alpha  = 0.0f;
-            merged.channels.resize(nChan, 0.0f);
+            SampleHeader merged;
+            merged.zFront = headers[i].zFront;
+            merged.zBack  = headers[i].zBack;
+            merged.row    = pool.newRow();
 
+            float* acc = pool.row(merged.row);
             float alphaAcc = 0.0f;
             for (size_t s = i; s < j; ++s) {
                 float w = 1.0f - alphaAcc;
                 if (w <= 0.0f) break;
-                const size_t nc = std::min(nChan, samples[s].channels.size());
-                for (size_t c = 0; c < nc; ++c)
-                    merged.channels[c] += samples[s].channels[c] * w;
-                alphaAcc += samples[s].alpha * w;
+                const float* src = pool.row(headers[s].row);
+                for (int c = 0; c < nChan; ++c)
+                    acc[c] += src[c] * w;
+                alphaAcc += headers[s].alpha * w;
             }
             merged.alpha = alphaAcc;
-            result.push_back(std::move(merged));
+            headers[out] = merged;
         }
+        ++out;
         i = j;
     }
-
-    samples = std::move(result);
+    headers.resize(out);
 }
 
 // ---------------------------------------------------------------------------
 // optimizeSamples — merge nearby-depth samples and cap total count
 //
-//   samples         : in/out vector of SampleRecords (modified in place)
+//   pool            : in/out samples of one pixel (modified in place)
 //   mergeTolerance  : max Z-front distance for grouping (0 = no merge)
 //   colorTolerance  : max channel-value distance for grouping (0 = Z-only)
 //   maxSamples      : hard cap on output count (0 = unlimited)
@@ -191,46 +322,49 @@ inline void tidyOverlapping(std::vector<SampleRecord>& samples)
 //
 // After merge, samples exceeding maxSamples are truncated (frontmost kept).
 // ---------------------------------------------------------------------------
-inline void optimizeSamples(std::vector<SampleRecord>& samples,
+inline void optimizeSamples(SamplePool& pool,
                             float mergeTolerance,
                             float colorTolerance,
                             int   maxSamples)
 {
-    if (samples.empty())
+    std::vector<SampleHeader>& headers = pool.headers();
+    if (headers.empty())
         return;
 
     // --- Overlap tidy pre-pass: split and merge overlapping intervals ---
-    if (samples.size() > 1)
-        tidyOverlapping(samples);
+    if (headers.size() > 1)
+        tidyOverlapping(pool);
 
     // --- Sort by zFront ascending ---
-    std::sort(samples.begin(), samples.end(),
-        [](const SampleRecord& a, const SampleRecord& b) {
+    std::sort(headers.begin(), headers.end(),
+        [](const SampleHeader& a, const SampleHeader& b) {
             return a.zFront < b.zFront;
         });
 
-    const int count = static_cast<int>(samples.size());
+    const int count = static_cast<int>(headers.size());
+    const int nChan = pool.channelCount();
 
     // --- Merge pass ---
     // Form groups of consecutive samples where Z-distance and color-distance
     // are within tolerance, then merge each group via over-compositing.
+    // Groups are written back in place; a group never ends before the slot
+    // it is written to.
     if (mergeTolerance > 0.0f) {
-        std::vector<SampleRecord> merged;
-        merged.reserve(count);
-
+        int out = 0;
         int groupStart = 0;
         while (groupStart < count) {
             int groupEnd = groupStart + 1;
 
             // Extend group while next sample is within tolerance of group start
             while (groupEnd < count) {
-                bool zClose = (samples[groupEnd].zFront -
-                               samples[groupStart].zFront) <= mergeTolerance;
+                bool zClose = (headers[groupEnd].zFront -
+                               headers[groupStart].zFront) <= mergeTolerance;
                 bool cClose = (colorTolerance <= 0.0f) ||
-                    (colorDistance(samples[groupEnd].channels,
-                                  samples[groupEnd].alpha,
-                                  samples[groupStart].channels,
-                                  samples[groupStart].alpha) <= colorTolerance);
+                    (colorDistance(pool.channels(groupEnd),
+                                   headers[groupEnd].alpha,
+                                   pool.channels(groupStart),
+                                   headers[groupStart].alpha,
+                                   nChan) <= colorTolerance);
                 if (zClose && cClose)
                     ++groupEnd;
                 else
@@ -239,20 +373,19 @@ inline void optimizeSamples(std::vector<SampleRecord>& samples,
 
             if (groupEnd - groupStart == 1) {
                 // Single-sample group — pass through unchanged
-                merged.push_back(std::move(samples[groupStart]));
+                headers[out] = headers[groupStart];
             } else {
                 // Multi-sample group — merge via front-to-back over-compositing
-                const size_t nChan = samples[groupStart].channels.size();
-                SampleRecord result;
+                SampleHeader result;
                 result.zFront =  1e30f;
                 result.zBack  = -1e30f;
-                result.alpha  = 0.0f;
-                result.channels.resize(nChan, 0.0f);
+                result.row    = pool.newRow();
 
+                float* acc = pool.row(result.row);
                 float alphaAcc = 0.0f;
 
                 for (int s = groupStart; s < groupEnd; ++s) {
-                    const SampleRecord& sr = samples[s];
+                    const SampleHeader& sr = headers[s];
                     const float w = 1.0f - alphaAcc;
                     if (w <= 0.0f)
                         break;
@@ -261,26 +394,85 @@ inline void optimizeSamples(std::vector<SampleRecord>& samples,
                     result.zBack  = std::max(result.zBack,  sr.zBack);
 
                     // Accumulate channels weighted by remaining coverage
-                    const size_t nc = std::min(nChan, sr.channels.size());
-                    for (size_t c = 0; c < nc; ++c)
-                        result.channels[c] += sr.channels[c] * w;
+                    const float* src = pool.row(sr.row);
+                    for (int c = 0; c < nChan; ++c)
+                        acc[c] += src[c] * w;
 
                     alphaAcc += sr.alpha * w;
                 }
 
                 result.alpha = alphaAcc;
-                merged.push_back(std::move(result));
+                headers[out] = result;
             }
 
+            ++out;
             groupStart = groupEnd;
         }
 
-        samples = std::move(merged);
+        headers.resize(out);
     }
 
     // --- Cap pass ---
-    if (maxSamples > 0 && static_cast<int>(samples.size()) > maxSamples)
-        samples.resize(maxSamples);
+    if (maxSamples > 0 && static_cast<int>(headers.size()) > maxSamples)
+        headers.resize(maxSamples);
+}
+
+// ---------------------------------------------------------------------------
+// Vector API — SampleRecord compatibility wrappers
+//
+// Copy into a thread-local pool, run the pooled implementation and copy back.
+// Records with fewer channels than the widest one are zero-padded.
+// ---------------------------------------------------------------------------
+inline void toPool(const std::vector<SampleRecord>& samples, SamplePool& pool)
+{
+    size_t nChans = 0;
+    for (const SampleRecord& s : samples)
+        nChans = std::max(nChans, s.channels.size());
+
+    pool.reset(static_cast<int>(nChans));
+    for (const SampleRecord& s : samples) {
+        float* row = pool.add(s.zFront, s.zBack, s.alpha);
+        std::copy(s.channels.begin(), s.channels.end(), row);
+    }
+}
+
+inline void fromPool(const SamplePool& pool, std::vector<SampleRecord>& samples)
+{
+    const int nChans = pool.channelCount();
+    samples.resize(pool.size());
+    for (size_t i = 0; i < pool.size(); ++i) {
+        const SampleHeader& h = pool.header(i);
+        SampleRecord& s = samples[i];
+        s.zFront = h.zFront;
+        s.zBack  = h.zBack;
+        s.alpha  = h.alpha;
+        s.channels.assign(pool.channels(i), pool.channels(i) + nChans);
+    }
+}
+
+inline void tidyOverlapping(std::vector<SampleRecord>& samples)
+{
+    if (samples.size() < 2)
+        return;
+
+    static thread_local SamplePool pool;
+    toPool(samples, pool);
+    tidyOverlapping(pool);
+    fromPool(pool, samples);
+}
+
+inline void optimizeSamples(std::vector<SampleRecord>& samples,
+                            float mergeTolerance,
+                            float colorTolerance,
+                            int   maxSamples)
+{
+    if (samples.empty())
+        return;
+
+    static thread_local SamplePool pool;
+    toPool(samples, pool);
+    optimizeSamples(pool, mergeTolerance, colorTolerance, maxSamples);
+    fromPool(pool, samples);
 }
 
 } // namespace deepc
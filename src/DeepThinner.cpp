@@ -18,6 +18,8 @@
 #include "DDImage/DeepPlane.h"
 #include "DDImage/Knobs.h"
 
+#include "DeepChannelPlan.h"
+
 #include <algorithm>
 #include <atomic>
 #include <cmath>
@@ -444,7 +446,15 @@ public:
         const bool hasChanR     = chanMap.contains(Chan_Red);
         const bool hasChanG     = chanMap.contains(Chan_Green);
         const bool hasChanB     = chanMap.contains(Chan_Blue);
-        const int  nChans       = (int)chanMap.size();
+
+        // output slot -> input offset, so the emit pass reads samples as raw
+        // floats rather than looking every channel up
+        static thread_local deepc::DeepChannelPlan plan;
+        plan.reset(chanMap, channels);
+        const int nChans    = (int)plan.size();
+        const int frontSlot = plan.slotOf(Chan_DeepFront);
+        const int backSlot  = plan.slotOf(Chan_DeepBack);
+        const int alphaSlot = plan.slotOf(Chan_Alpha);
 
         int64_t localIn  = 0;
         int64_t localOut = 0;
@@ -636,8 +646,9 @@ public:
                 if (aliveCount == 1) {
                     const float* src = inPixel.getUnorderedSample(
                         scratch.sorted[firstAlive].originalIndex);
+                    plan.copySample(src, scratch.mergedChannels.data());
                     for (int ci = 0; ci < nChans; ++ci)
-                        outPixel.push_back(src[ci]);
+                        outPixel.push_back(scratch.mergedChannels[ci]);
                 } else {
                     float accAlpha  = 0.0f;
                     float zFrontMin =  1e30f;
@@ -656,31 +667,24 @@ public:
                         zFrontMin = std::min(zFrontMin, sr.zFront);
                         zBackMax  = std::max(zBackMax,  sr.zBack);
 
-                        int ci = 0;
-                        foreach(z, channels) {
-                            if (z == Chan_DeepFront || z == Chan_DeepBack) {
-                                ci++;
+                        const float* src = inPixel.getUnorderedSample(idx);
+                        for (int ci = 0; ci < nChans; ++ci) {
+                            if (ci == frontSlot || ci == backSlot)
                                 continue;
-                            }
-                            const float val =
-                                inPixel.getUnorderedSample(idx, z);
-                            if (z == Chan_Alpha)
+                            const int offset = plan.offset(ci);
+                            const float val = offset < 0 ? 0.0f : src[offset];
+                            if (ci == alphaSlot)
                                 scratch.mergedChannels[ci] += a * w;
                             else
                                 scratch.mergedChannels[ci] += val * w;
-                            ci++;
                         }
                         accAlpha += a * w;
                     }
 
-                    int ci = 0;
-                    foreach(z, channels) {
-                        if (z == Chan_DeepFront)
-                            scratch.mergedChannels[ci] = zFrontMin;
-                        else if (z == Chan_DeepBack)
-                            scratch.mergedChannels[ci] = zBackMax;
-                        ci++;
-                    }
+                    if (frontSlot >= 0)
+                        scratch.mergedChannels[frontSlot] = zFrontMin;
+                    if (backSlot >= 0)
+                        scratch.mergedChannels[backSlot] = zBackMax;
 
                     for (int ci = 0; ci < nChans; ++ci)
                         outPixel.push_back(scratch.mergedChannels[ci]);
@@ -257,10 +257,7 @@ void ShuffleMatrixWidget::buildLayout()
     {
         DD::Image::Channel ch;
         foreach(ch, out1Set)
-        {
-            if (out1Rows.size() >= 8) break;
             out1Rows.push_back(DD::Image::getName(ch));
-        }
     }
 
     // When out2 is set to none (Chan_Black) we still want to render the out2 rows
@@ -269,10 +266,7 @@ void ShuffleMatrixWidget::buildLayout()
     {
         DD::Image::Channel ch;
         foreach(ch, out2Set)
-        {
-            if (out2Rows.size() >= 8) break;
             out2Rows.push_back(DD::Image::getName(ch));
-        }
     }
     if (out2Disabled && out2Rows.empty())
     {